@@ -7792,6 +7792,12 @@ int main(int argc, const char **argv) {
                       CHAZ_CLI_ARG_REQUIRED);
     chaz_CLI_register(cli, "disable-threads", "whether to disable threads",
                       CHAZ_CLI_NO_ARG);
+    chaz_CLI_register(cli, "enable-atomic-refcount",
+                      "whether to update all refcounts atomically",
+                      CHAZ_CLI_NO_ARG);
+    chaz_CLI_register(cli, "disable-obj-slabs",
+                      "whether to allocate every object with calloc",
+                      CHAZ_CLI_NO_ARG);
     chaz_CLI_set_usage(cli, "Usage: charmonizer [OPTIONS] [-- [CFLAGS]]");
     {
         int result = chaz_Probe_parse_cli_args(argc, argv, cli);
@@ -549,6 +549,7 @@ CFCBindClass_spec_def(CFCBindClass *self) {
         "        &%s, /* class */\n"
         "        %s, /* parent */\n"
         "        \"%s\", /* name */\n"
+        "        %d, /* name_len */\n"
         "        %s, /* ivars_size */\n"
         "        &%s, /* ivars_offset_ptr */\n"
         "        %d, /* num_novel */\n"
@@ -560,6 +561,7 @@ CFCBindClass_spec_def(CFCBindClass *self) {
         "    }";
     char *code
         = CFCUtil_sprintf(pattern, class_var, parent_ref, class_name,
+                          (int)strlen(class_name),
                           ivars_size, ivars_offset_name, num_novel,
                           num_overridden, num_inherited, novel_ms_var,
                           overridden_ms_var, inherited_ms_var);
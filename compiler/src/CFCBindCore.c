@@ -325,6 +325,7 @@ S_write_parcel_h(CFCBindCore *self, CFCParcel *parcel) {
         "    cfish_Class **klass;\n"
         "    cfish_Class **parent;\n"
         "    const char   *name;\n"
+        "    size_t        name_len;\n"
         "    size_t        ivars_size;\n"
         "    size_t       *ivars_offset_ptr;\n"
         "    uint32_t      num_novel_meths;\n"
@@ -0,0 +1,112 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/* Measure a request-style workload: a Hash of Strings, a VArray of numbers
+ * and a CharBuf report are built, then thrown away.
+ *
+ * "heap" allocates from the heap and releases everything with DECREF.
+ * "arena+DECREF" runs the same code inside an arena scope.  "arena" skips
+ * the DECREFs and leaves the cleanup to Memory_pop_scope.
+ *
+ * Usage: ./arena [num_requests]
+ */
+
+#define CFISH_USE_SHORT_NAMES
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include "charmony.h"
+#include "Clownfish/CharBuf.h"
+#include "Clownfish/Hash.h"
+#include "Clownfish/Num.h"
+#include "Clownfish/String.h"
+#include "Clownfish/VArray.h"
+#include "Clownfish/Util/Memory.h"
+
+#define NUM_ENTRIES  200
+
+static double
+S_now(void) {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+static void
+S_request(bool release) {
+    Hash    *fields = Hash_new(0);
+    VArray  *scores = VA_new(0);
+    CharBuf *report = CB_new(0);
+
+    for (int32_t i = 0; i < NUM_ENTRIES; i++) {
+        String *key   = Str_newf("field%i32", i);
+        String *value = Str_newf("value of field %i32", i);
+        Hash_Store(fields, key, (Obj*)value);
+        VA_Push(scores, (Obj*)Float64_new(i * 0.5));
+        CB_catf(report, "%o=%o;", key, value);
+        DECREF(key);
+    }
+    String *result = CB_Yield_String(report);
+
+    if (release) {
+        DECREF(result);
+        DECREF(report);
+        DECREF(scores);
+        DECREF(fields);
+    }
+}
+
+int
+main(int argc, char **argv) {
+    int num_requests = argc > 1 ? atoi(argv[1]) : 2000;
+    if (num_requests < 1) { num_requests = 1; }
+
+    cfish_bootstrap_parcel();
+
+    double start = S_now();
+    for (int i = 0; i < num_requests; i++) {
+        S_request(true);
+    }
+    double heap = S_now() - start;
+
+    start = S_now();
+    for (int i = 0; i < num_requests; i++) {
+        Memory_push_arena();
+        S_request(true);
+        Memory_pop_scope();
+    }
+    double arena_decref = S_now() - start;
+
+    start = S_now();
+    for (int i = 0; i < num_requests; i++) {
+        Memory_push_arena();
+        S_request(false);
+        Memory_pop_scope();
+    }
+    double arena = S_now() - start;
+
+    printf("time per request\n");
+    printf("%-16s %8.2f us\n", "heap", heap * 1e6 / num_requests);
+    printf("%-16s %8.2f us\n", "arena+DECREF",
+           arena_decref * 1e6 / num_requests);
+    printf("%-16s %8.2f us\n", "arena", arena * 1e6 / num_requests);
+
+    return 0;
+}
@@ -0,0 +1,100 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* Measure object construction by class name, the way host bindings do it:
+ * wrap the name in a StackString, look up the Class, and make an object.
+ *
+ * A few thousand subclasses are registered first, so that the registry is
+ * about as full as in a large application.  The Class is looked up either
+ * with Class_singleton, which goes through the class cache, or directly in
+ * the registry.
+ *
+ * Usage: ./construct [num_classes]
+ */
+
+#define CFISH_USE_SHORT_NAMES
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include "charmony.h"
+#include "Clownfish/Class.h"
+#include "Clownfish/LockFreeRegistry.h"
+#include "Clownfish/Obj.h"
+#include "Clownfish/String.h"
+
+#define ITERATIONS  10000000
+
+static double
+S_now(void) {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+/* SSTR_WRAP_UTF8 allocates on the stack, so wrap the name in a separate
+ * function to release that memory on every iteration.
+ */
+static __attribute__((noinline)) void
+S_make_obj(const char *name, size_t len, bool cached) {
+    StackString *class_name = SSTR_WRAP_UTF8(name, len);
+    Class *klass = cached
+                   ? Class_singleton((String*)class_name, NULL)
+                   : (Class*)LFReg_Fetch(Class_registry, (String*)class_name);
+    Obj *obj = Class_Make_Obj(klass);
+    DECREF(obj);
+}
+
+static double
+S_construct(const char *name, bool cached) {
+    size_t len = strlen(name);
+
+    double start = S_now();
+    for (int i = 0; i < ITERATIONS; i++) {
+        S_make_obj(name, len, cached);
+    }
+    return (S_now() - start) * 1e9 / ITERATIONS;
+}
+
+int
+main(int argc, char **argv) {
+    int num_classes = argc > 1 ? atoi(argv[1]) : 5000;
+
+    cfish_bootstrap_parcel();
+    for (int i = 0; i < num_classes; i++) {
+        String *name = Str_newf("MyApp::Class%i32", (int32_t)i);
+        Class_singleton(name, OBJ);
+        DECREF(name);
+    }
+
+    char last[64];
+    sprintf(last, "MyApp::Class%d", num_classes - 1);
+    const char *names[] = {
+        "Clownfish::Obj",
+        num_classes > 0 ? last : NULL,
+        NULL
+    };
+    printf("%-20s %12s %12s\n", "class", "registry", "cached");
+    for (int i = 0; names[i]; i++) {
+        printf("%-20s %9.2f ns %9.2f ns\n", names[i],
+               S_construct(names[i], false), S_construct(names[i], true));
+    }
+
+    return 0;
+}
+
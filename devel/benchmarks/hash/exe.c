@@ -0,0 +1,411 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/* Compare string hash functions on several key sets.
+ *
+ * For each key set, report the throughput of each hash function, the
+ * number of full 32-bit collisions, and the mean probe length of a linear
+ * probing table at a 2/3 load factor (the layout used by Clownfish::Hash
+ * at the time of writing).  Then time Store and Fetch on a real
+ * Clownfish::Hash.  Finally, compare the worst-case latency of a single
+ * Store with and without incremental rehashing, and random lookups in a
+ * large Hash with Fetch and Fetch_Many.
+ *
+ * Usage: ./exe [num_keys]
+ */
+
+#define CFISH_USE_SHORT_NAMES
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include "charmony.h"
+#include "Clownfish/String.h"
+#include "Clownfish/Hash.h"
+#include "Clownfish/Num.h"
+#include "Clownfish/Util/HashUtils.h"
+#include "Clownfish/Util/StringHelper.h"
+
+typedef uint32_t (*hash_func_t)(const char *ptr, size_t size);
+
+// Keeps the compiler from optimizing away the timed loops.
+volatile uint32_t sink;
+
+typedef struct {
+    char   **keys;
+    size_t  *sizes;
+    size_t   num_keys;
+    size_t   total_bytes;
+} KeySet;
+
+/* The hash function used by String before HashUtils: djb2 (xor variant)
+ * over decoded code points. */
+static uint32_t
+S_djb_code_points(const char *ptr, size_t size) {
+    uint32_t hash = 5381;
+    const uint8_t *p   = (const uint8_t*)ptr;
+    const uint8_t *end = p + size;
+    while (p < end) {
+        uint32_t count = StrHelp_UTF8_COUNT[*p];
+        int32_t  code_point;
+        switch (count) {
+            case 1:
+                code_point = p[0];
+                break;
+            case 2:
+                code_point = ((p[0] & 0x1F) << 6) | (p[1] & 0x3F);
+                break;
+            case 3:
+                code_point = ((p[0] & 0x0F) << 12) | ((p[1] & 0x3F) << 6)
+                             | (p[2] & 0x3F);
+                break;
+            default:
+                code_point = ((p[0] & 0x07) << 18) | ((p[1] & 0x3F) << 12)
+                             | ((p[2] & 0x3F) << 6) | (p[3] & 0x3F);
+                count = 4;
+                break;
+        }
+        hash = ((hash << 5) + hash) ^ code_point;
+        p += count;
+    }
+    return hash;
+}
+
+/* The hash function used by ByteBuf before HashUtils. */
+static uint32_t
+S_djb_bytes(const char *ptr, size_t size) {
+    uint32_t hash = 5381;
+    for (size_t i = 0; i < size; i++) {
+        hash = ((hash << 5) + hash) ^ (uint8_t)ptr[i];
+    }
+    return hash;
+}
+
+static uint32_t
+S_hash_util(const char *ptr, size_t size) {
+    return (uint32_t)HashUtil_hash_sum(ptr, size);
+}
+
+static double
+S_now(void) {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+static void
+S_add_key(KeySet *set, char *key) {
+    set->keys[set->num_keys]  = key;
+    set->sizes[set->num_keys] = strlen(key);
+    set->total_bytes += set->sizes[set->num_keys];
+    set->num_keys++;
+}
+
+static KeySet*
+S_new_key_set(size_t capacity) {
+    KeySet *set = (KeySet*)calloc(1, sizeof(KeySet));
+    set->keys  = (char**)calloc(capacity, sizeof(char*));
+    set->sizes = (size_t*)calloc(capacity, sizeof(size_t));
+    return set;
+}
+
+static void
+S_destroy_key_set(KeySet *set) {
+    for (size_t i = 0; i < set->num_keys; i++) { free(set->keys[i]); }
+    free(set->keys);
+    free(set->sizes);
+    free(set);
+}
+
+static KeySet*
+S_integer_keys(size_t num_keys) {
+    KeySet *set = S_new_key_set(num_keys);
+    for (size_t i = 0; i < num_keys; i++) {
+        char *key = (char*)malloc(24);
+        sprintf(key, "%lu", (unsigned long)i);
+        S_add_key(set, key);
+    }
+    return set;
+}
+
+static KeySet*
+S_field_name_keys(size_t num_keys) {
+    static const char *prefixes[] = {
+        "title", "content", "author", "category", "url", "date", "body_text"
+    };
+    KeySet *set = S_new_key_set(num_keys);
+    for (size_t i = 0; i < num_keys; i++) {
+        char *key = (char*)malloc(48);
+        sprintf(key, "%s_%lu", prefixes[i % 7], (unsigned long)(i / 7));
+        S_add_key(set, key);
+    }
+    return set;
+}
+
+static KeySet*
+S_class_name_keys(size_t num_keys) {
+    KeySet *set = S_new_key_set(num_keys);
+    for (size_t i = 0; i < num_keys; i++) {
+        char *key = (char*)malloc(80);
+        sprintf(key, "Lucy::Index::Posting::Module%lu::Sub%lu",
+                (unsigned long)(i % 97), (unsigned long)(i / 97));
+        S_add_key(set, key);
+    }
+    return set;
+}
+
+static KeySet*
+S_random_keys(size_t num_keys, size_t min_size, size_t max_size) {
+    static const char alphabet[]
+        = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789";
+    KeySet *set = S_new_key_set(num_keys);
+    srand(42);
+    for (size_t i = 0; i < num_keys; i++) {
+        size_t size = min_size + rand() % (max_size - min_size + 1);
+        char *key = (char*)malloc(size + 1);
+        for (size_t j = 0; j < size; j++) {
+            key[j] = alphabet[rand() % (sizeof(alphabet) - 1)];
+        }
+        key[size] = '\0';
+        S_add_key(set, key);
+    }
+    return set;
+}
+
+static int
+S_compare_u32(const void *va, const void *vb) {
+    uint32_t a = *(const uint32_t*)va;
+    uint32_t b = *(const uint32_t*)vb;
+    return a < b ? -1 : a > b ? 1 : 0;
+}
+
+static void
+S_bench_func(KeySet *set, hash_func_t func, const char *name) {
+    size_t    num_keys = set->num_keys;
+    uint32_t *hashes   = (uint32_t*)malloc(num_keys * sizeof(uint32_t));
+
+    // Throughput.
+    size_t   rounds = 1 + 20000000 / (set->total_bytes + 1);
+    uint32_t acc    = 0;
+    double   start  = S_now();
+    for (size_t r = 0; r < rounds; r++) {
+        for (size_t i = 0; i < num_keys; i++) {
+            acc ^= func(set->keys[i], set->sizes[i]);
+        }
+    }
+    sink = acc;
+    double elapsed = S_now() - start;
+    double mb_per_sec = (double)set->total_bytes * rounds
+                        / (elapsed * 1024 * 1024);
+    double ns_per_key = elapsed * 1e9 / ((double)num_keys * rounds);
+
+    // Full 32-bit collisions.
+    for (size_t i = 0; i < num_keys; i++) {
+        hashes[i] = func(set->keys[i], set->sizes[i]);
+    }
+    uint32_t *sorted = (uint32_t*)malloc(num_keys * sizeof(uint32_t));
+    memcpy(sorted, hashes, num_keys * sizeof(uint32_t));
+    qsort(sorted, num_keys, sizeof(uint32_t), S_compare_u32);
+    size_t collisions = 0;
+    for (size_t i = 1; i < num_keys; i++) {
+        if (sorted[i] == sorted[i - 1]) { collisions++; }
+    }
+    free(sorted);
+
+    // Mean probe length of successful lookups in a linear probing table
+    // at a load factor of 2/3.
+    size_t capacity = 16;
+    while ((capacity / 3) * 2 <= num_keys) { capacity *= 2; }
+    uint8_t *occupied = (uint8_t*)calloc(capacity, 1);
+    uint64_t total_probes = 0;
+    size_t   max_probes   = 0;
+    for (size_t i = 0; i < num_keys; i++) {
+        size_t tick   = hashes[i] & (capacity - 1);
+        size_t probes = 1;
+        while (occupied[tick]) {
+            tick = (tick + 1) & (capacity - 1);
+            probes++;
+        }
+        occupied[tick] = 1;
+        total_probes += probes;
+        if (probes > max_probes) { max_probes = probes; }
+    }
+    free(occupied);
+
+    printf("  %-16s %9.1f MB/s %7.1f ns/key %6lu collisions"
+           "  probes mean %5.2f max %5lu\n",
+           name, mb_per_sec, ns_per_key, (unsigned long)collisions,
+           (double)total_probes / num_keys, (unsigned long)max_probes);
+
+    free(hashes);
+}
+
+static void
+S_bench_hash(KeySet *set) {
+    String **keys = (String**)malloc(set->num_keys * sizeof(String*));
+    for (size_t i = 0; i < set->num_keys; i++) {
+        keys[i] = Str_new_from_trusted_utf8(set->keys[i], set->sizes[i]);
+    }
+
+    Hash *hash = Hash_new(0);
+    double start = S_now();
+    for (size_t i = 0; i < set->num_keys; i++) {
+        Hash_Store(hash, keys[i], (Obj*)CFISH_TRUE);
+    }
+    double store_elapsed = S_now() - start;
+
+    size_t rounds = 1 + 5000000 / set->num_keys;
+    size_t found  = 0;
+    start = S_now();
+    for (size_t r = 0; r < rounds; r++) {
+        for (size_t i = 0; i < set->num_keys; i++) {
+            if (Hash_Fetch(hash, keys[i])) { found++; }
+        }
+    }
+    double fetch_elapsed = S_now() - start;
+
+    printf("  %-16s store %7.1f ns/key, fetch %7.1f ns/key%s\n",
+           "Clownfish::Hash",
+           store_elapsed * 1e9 / set->num_keys,
+           fetch_elapsed * 1e9 / ((double)set->num_keys * rounds),
+           found == rounds * set->num_keys ? "" : " (MISSING KEYS)");
+
+    DECREF(hash);
+    for (size_t i = 0; i < set->num_keys; i++) { DECREF(keys[i]); }
+    free(keys);
+}
+
+static void
+S_bench_store_latency(KeySet *set, bool incremental) {
+    String **keys = (String**)malloc(set->num_keys * sizeof(String*));
+    for (size_t i = 0; i < set->num_keys; i++) {
+        keys[i] = Str_new_from_trusted_utf8(set->keys[i], set->sizes[i]);
+    }
+
+    Hash *hash = Hash_new(0);
+    Hash_Set_Incremental_Rehash(hash, incremental);
+    double max_elapsed = 0.0;
+    double start       = S_now();
+    for (size_t i = 0; i < set->num_keys; i++) {
+        double store_start = S_now();
+        Hash_Store(hash, keys[i], (Obj*)CFISH_TRUE);
+        double elapsed = S_now() - store_start;
+        if (elapsed > max_elapsed) { max_elapsed = elapsed; }
+    }
+    double total_elapsed = S_now() - start;
+
+    printf("  %-16s %9.1f ns/key, max single Store %9.1f us\n",
+           incremental ? "incremental" : "stop-the-world",
+           total_elapsed * 1e9 / set->num_keys, max_elapsed * 1e6);
+
+    DECREF(hash);
+    for (size_t i = 0; i < set->num_keys; i++) { DECREF(keys[i]); }
+    free(keys);
+}
+
+static void
+S_bench_fetch_many(KeySet *set) {
+    size_t   num_keys = set->num_keys;
+    String **keys     = (String**)malloc(num_keys * sizeof(String*));
+    Obj    **values   = (Obj**)malloc(num_keys * sizeof(Obj*));
+    Hash    *hash     = Hash_new(0);
+    for (size_t i = 0; i < num_keys; i++) {
+        keys[i] = Str_new_from_trusted_utf8(set->keys[i], set->sizes[i]);
+        Hash_Store(hash, keys[i], (Obj*)CFISH_TRUE);
+    }
+
+    // Look keys up in random order, so that consecutive lookups don't share
+    // cache lines.
+    String **lookups = (String**)malloc(num_keys * sizeof(String*));
+    srand(42);
+    for (size_t i = 0; i < num_keys; i++) {
+        lookups[i] = keys[((size_t)rand() * RAND_MAX + rand()) % num_keys];
+    }
+
+    size_t found = 0;
+    double start = S_now();
+    for (size_t i = 0; i < num_keys; i++) {
+        if (Hash_Fetch(hash, lookups[i])) { found++; }
+    }
+    double fetch_elapsed = S_now() - start;
+
+    start = S_now();
+    for (size_t i = 0; i < num_keys; i += 256) {
+        size_t batch_size = num_keys - i < 256 ? num_keys - i : 256;
+        Hash_Fetch_Many(hash, lookups + i, values + i, batch_size);
+    }
+    double fetch_many_elapsed = S_now() - start;
+    for (size_t i = 0; i < num_keys; i++) {
+        if (values[i]) { found++; }
+    }
+
+    printf("  %-16s %9.1f ns/key\n", "Fetch",
+           fetch_elapsed * 1e9 / num_keys);
+    printf("  %-16s %9.1f ns/key%s\n", "Fetch_Many",
+           fetch_many_elapsed * 1e9 / num_keys,
+           found == 2 * num_keys ? "" : " (MISSING KEYS)");
+
+    DECREF(hash);
+    for (size_t i = 0; i < num_keys; i++) { DECREF(keys[i]); }
+    free(keys);
+    free(lookups);
+    free(values);
+}
+
+static void
+S_bench_key_set(KeySet *set, const char *description) {
+    printf("%s (%lu keys, mean size %.1f bytes)\n", description,
+           (unsigned long)set->num_keys,
+           (double)set->total_bytes / set->num_keys);
+    S_bench_func(set, S_djb_code_points, "djb code points");
+    S_bench_func(set, S_djb_bytes, "djb bytes");
+    S_bench_func(set, S_hash_util, "HashUtils");
+    S_bench_hash(set);
+    printf("\n");
+    S_destroy_key_set(set);
+}
+
+int
+main(int argc, char **argv) {
+    size_t num_keys = argc > 1 ? strtoul(argv[1], NULL, 10) : 100000;
+
+    cfish_bootstrap_parcel();
+    printf("hash seed: 0x%" PRIx64 "\n\n", HashUtil_get_seed());
+
+    S_bench_key_set(S_integer_keys(num_keys), "decimal integers");
+    S_bench_key_set(S_field_name_keys(num_keys), "field names");
+    S_bench_key_set(S_class_name_keys(num_keys), "class names");
+    S_bench_key_set(S_random_keys(num_keys, 4, 16), "random, 4-16 bytes");
+    S_bench_key_set(S_random_keys(num_keys, 100, 300),
+                    "random, 100-300 bytes");
+
+    KeySet *set = S_integer_keys(num_keys * 10);
+    printf("Store latency, %lu decimal integers\n",
+           (unsigned long)set->num_keys);
+    S_bench_store_latency(set, false);
+    S_bench_store_latency(set, true);
+    printf("\nRandom lookups, %lu decimal integers\n",
+           (unsigned long)set->num_keys);
+    S_bench_fetch_many(set);
+    S_destroy_key_set(set);
+
+    return 0;
+}
+
@@ -0,0 +1,212 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* Compare the throughput of concurrent lookups.
+ *
+ * Reader threads fetch random keys from a shared table while a writer
+ * thread replaces a value every so often.  The table is either a
+ * Clownfish::ConcurrentHash, or a Clownfish::Hash guarded by a
+ * read-write lock or a mutex.  Report the total number of lookups per
+ * second for increasing numbers of readers.
+ *
+ * Usage: ./threads [num_keys] [max_threads]
+ */
+
+#define CFISH_USE_SHORT_NAMES
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include "charmony.h"
+#include "Clownfish/ConcurrentHash.h"
+#include "Clownfish/Hash.h"
+#include "Clownfish/String.h"
+
+#define FETCHES_PER_THREAD  2000000
+#define WRITE_INTERVAL_US   100
+
+typedef enum {
+    MODE_CONCURRENT,
+    MODE_RWLOCK,
+    MODE_MUTEX
+} Mode;
+
+typedef struct {
+    Mode              mode;
+    ConcurrentHash   *chash;
+    Hash             *hash;
+    pthread_rwlock_t  rwlock;
+    pthread_mutex_t   mutex;
+    String          **keys;
+    size_t            num_keys;
+    volatile bool     done;
+} Shared;
+
+typedef struct {
+    Shared   *shared;
+    uint32_t  seed;
+    uint64_t  found;
+} Reader;
+
+static double
+S_now(void) {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+static CFISH_INLINE uint32_t
+SI_next_random(uint32_t *seed) {
+    *seed = *seed * 1103515245 + 12345;
+    return *seed >> 8;
+}
+
+static void*
+S_read(void *arg) {
+    Reader *reader = (Reader*)arg;
+    Shared *shared = reader->shared;
+
+    for (int i = 0; i < FETCHES_PER_THREAD; i++) {
+        String *key = shared->keys[SI_next_random(&reader->seed)
+                                   % shared->num_keys];
+        Obj *value;
+        switch (shared->mode) {
+            case MODE_CONCURRENT:
+                value = CHash_Fetch(shared->chash, key);
+                break;
+            case MODE_RWLOCK:
+                pthread_rwlock_rdlock(&shared->rwlock);
+                value = Hash_Fetch(shared->hash, key);
+                pthread_rwlock_unlock(&shared->rwlock);
+                break;
+            default:
+                pthread_mutex_lock(&shared->mutex);
+                value = Hash_Fetch(shared->hash, key);
+                pthread_mutex_unlock(&shared->mutex);
+                break;
+        }
+        if (value) { reader->found++; }
+    }
+    return NULL;
+}
+
+static void*
+S_write(void *arg) {
+    Shared   *shared = (Shared*)arg;
+    uint32_t  seed   = 42;
+    while (!shared->done) {
+        String *key   = shared->keys[SI_next_random(&seed) % shared->num_keys];
+        Obj    *value = (Obj*)Str_Clone(key);
+        switch (shared->mode) {
+            case MODE_CONCURRENT:
+                CHash_Store(shared->chash, key, value);
+                break;
+            case MODE_RWLOCK:
+                pthread_rwlock_wrlock(&shared->rwlock);
+                Hash_Store(shared->hash, key, value);
+                pthread_rwlock_unlock(&shared->rwlock);
+                break;
+            default:
+                pthread_mutex_lock(&shared->mutex);
+                Hash_Store(shared->hash, key, value);
+                pthread_mutex_unlock(&shared->mutex);
+                break;
+        }
+        usleep(WRITE_INTERVAL_US);
+    }
+    return NULL;
+}
+
+static void
+S_bench(Shared *shared, Mode mode, int num_threads, const char *name) {
+    pthread_t  writer;
+    pthread_t *threads = (pthread_t*)malloc(num_threads * sizeof(pthread_t));
+    Reader    *readers = (Reader*)malloc(num_threads * sizeof(Reader));
+
+    shared->mode = mode;
+    shared->done = false;
+    pthread_create(&writer, NULL, S_write, shared);
+
+    double start = S_now();
+    for (int i = 0; i < num_threads; i++) {
+        readers[i].shared = shared;
+        readers[i].seed   = (uint32_t)i + 1;
+        readers[i].found  = 0;
+        pthread_create(&threads[i], NULL, S_read, &readers[i]);
+    }
+    for (int i = 0; i < num_threads; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    double elapsed = S_now() - start;
+
+    shared->done = true;
+    pthread_join(writer, NULL);
+    if (mode == MODE_CONCURRENT) {
+        // All readers are done, so retired values can go.
+        CHash_Reclaim(shared->chash);
+    }
+
+    double total = (double)num_threads * FETCHES_PER_THREAD;
+    printf("  %-16s %2d threads: %8.2f M lookups/s\n", name, num_threads,
+           total / elapsed / 1e6);
+
+    free(readers);
+    free(threads);
+}
+
+int
+main(int argc, char **argv) {
+    size_t num_keys    = argc > 1 ? strtoul(argv[1], NULL, 10) : 100000;
+    int    max_threads = argc > 2 ? atoi(argv[2]) : 8;
+
+    cfish_bootstrap_parcel();
+
+    Shared shared;
+    shared.chash    = CHash_new((uint32_t)num_keys);
+    shared.hash     = Hash_new((uint32_t)num_keys);
+    shared.num_keys = num_keys;
+    shared.keys     = (String**)malloc(num_keys * sizeof(String*));
+    pthread_rwlock_init(&shared.rwlock, NULL);
+    pthread_mutex_init(&shared.mutex, NULL);
+    for (size_t i = 0; i < num_keys; i++) {
+        shared.keys[i] = Str_newf("%u64", (uint64_t)i);
+        CHash_Store(shared.chash, shared.keys[i],
+                    (Obj*)Str_Clone(shared.keys[i]));
+        Hash_Store(shared.hash, shared.keys[i],
+                   (Obj*)Str_Clone(shared.keys[i]));
+    }
+
+    printf("Concurrent lookups, %lu keys, one write every %d us\n",
+           (unsigned long)num_keys, WRITE_INTERVAL_US);
+    for (int num_threads = 1; num_threads <= max_threads; num_threads *= 2) {
+        S_bench(&shared, MODE_CONCURRENT, num_threads, "ConcurrentHash");
+        S_bench(&shared, MODE_RWLOCK, num_threads, "Hash + rwlock");
+        S_bench(&shared, MODE_MUTEX, num_threads, "Hash + mutex");
+    }
+
+    for (size_t i = 0; i < num_keys; i++) { DECREF(shared.keys[i]); }
+    free(shared.keys);
+    DECREF(shared.hash);
+    DECREF(shared.chash);
+    pthread_rwlock_destroy(&shared.rwlock);
+    pthread_mutex_destroy(&shared.mutex);
+
+    return 0;
+}
+
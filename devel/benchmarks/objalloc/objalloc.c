@@ -0,0 +1,136 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/* Measure allocation-heavy workloads: short-lived numbers and strings made
+ * and destroyed one at a time, and batches of objects which are kept in an
+ * array before they are destroyed together.
+ *
+ * Objects come from the per-thread slabs unless the runtime was configured
+ * with --disable-obj-slabs, in which case every object is calloc'd and
+ * freed.  Rebuild the runtime with and without that option to compare.
+ * With more than one thread, every thread runs the workloads at once.
+ *
+ * Usage: ./objalloc [num_threads]
+ */
+
+#define CFISH_USE_SHORT_NAMES
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sys/time.h>
+
+#include "charmony.h"
+#include "Clownfish/Num.h"
+#include "Clownfish/Obj.h"
+#include "Clownfish/String.h"
+#include "Clownfish/VArray.h"
+
+#define ITERATIONS  5000000
+#define BATCH_SIZE  1000
+
+static double
+S_now(void) {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+static void
+S_numbers(void) {
+    for (int i = 0; i < ITERATIONS; i++) {
+        Obj *num = (i & 1)
+                   ? (Obj*)Int64_new(i)
+                   : (Obj*)Float64_new((double)i);
+        DECREF(num);
+    }
+}
+
+static void
+S_strings(void) {
+    const char *text = "a short-lived string";
+    size_t      size = strlen(text);
+    for (int i = 0; i < ITERATIONS; i++) {
+        String *string = Str_new_from_trusted_utf8(text, size);
+        DECREF(string);
+    }
+}
+
+static void
+S_batches(void) {
+    VArray *array = VA_new(BATCH_SIZE);
+    for (int i = 0; i < ITERATIONS / BATCH_SIZE; i++) {
+        for (int j = 0; j < BATCH_SIZE; j++) {
+            VA_Push(array, (Obj*)Int64_new(j));
+        }
+        VA_Clear(array);
+    }
+    DECREF(array);
+}
+
+typedef struct {
+    const char *name;
+    void      (*func)(void);
+} Workload;
+
+static void*
+S_run_workload(void *arg) {
+    Workload *workload = (Workload*)arg;
+    workload->func();
+    return NULL;
+}
+
+// Return nanoseconds per object.
+static double
+S_time_workload(Workload *workload, int num_threads) {
+    pthread_t *threads = (pthread_t*)malloc(num_threads * sizeof(pthread_t));
+    double start = S_now();
+    for (int i = 0; i < num_threads; i++) {
+        pthread_create(&threads[i], NULL, S_run_workload, workload);
+    }
+    for (int i = 0; i < num_threads; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    double elapsed = S_now() - start;
+    free(threads);
+    return elapsed * 1e9 / ITERATIONS;
+}
+
+int
+main(int argc, char **argv) {
+    int num_threads = argc > 1 ? atoi(argv[1]) : 1;
+    if (num_threads < 1) { num_threads = 1; }
+
+    Workload workloads[] = {
+        { "Int64/Float64", S_numbers },
+        { "String",        S_strings },
+        { "Int64 batches", S_batches },
+        { NULL,            NULL }
+    };
+
+    cfish_bootstrap_parcel();
+
+    printf("%d thread(s), wall time per object in each thread\n",
+           num_threads);
+    for (int i = 0; workloads[i].name; i++) {
+        printf("%-16s %8.2f ns\n", workloads[i].name,
+               S_time_workload(&workloads[i], num_threads));
+    }
+
+    return 0;
+}
@@ -0,0 +1,144 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* Measure the cost of atomic refcounts.
+ *
+ * First, time INCREF/DECREF pairs on a String through the Clownfish
+ * runtime, which uses whichever kind of refcount it was configured with.
+ * Rebuild the runtime with and without --enable-atomic-refcount to compare.
+ *
+ * Then compare a plain counter with Atomic_fetch_add_size directly: in
+ * one thread, in several threads each with a counter of its own, and in
+ * several threads sharing one counter, which is what happens to the
+ * refcount of an object shared between threads.
+ *
+ * Usage: ./refcount [max_threads]
+ */
+
+#define CFISH_USE_SHORT_NAMES
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <sys/time.h>
+
+#include "charmony.h"
+#include "Clownfish/Obj.h"
+#include "Clownfish/String.h"
+#include "Clownfish/Util/Atomic.h"
+
+#define ITERATIONS  20000000
+
+typedef enum {
+    MODE_PLAIN,
+    MODE_ATOMIC
+} Mode;
+
+// Keep private counters on separate cache lines.
+typedef struct {
+    volatile size_t count;
+    char            padding[64 - sizeof(size_t)];
+} Counter;
+
+typedef struct {
+    Mode     mode;
+    Counter *counter;
+} Worker;
+
+static double
+S_now(void) {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+static void*
+S_count(void *arg) {
+    Worker *worker = (Worker*)arg;
+    volatile size_t *count = &worker->counter->count;
+    if (worker->mode == MODE_PLAIN) {
+        for (int i = 0; i < ITERATIONS; i++) {
+            *count += 1;
+            *count -= 1;
+        }
+    }
+    else {
+        for (int i = 0; i < ITERATIONS; i++) {
+            Atomic_fetch_add_size(count, 1);
+            Atomic_fetch_add_size(count, (size_t)-1);
+        }
+    }
+    return NULL;
+}
+
+// Return nanoseconds per increment/decrement pair.
+static double
+S_run(Mode mode, int num_threads, bool shared) {
+    Counter   *counters = (Counter*)calloc(num_threads, sizeof(Counter));
+    Worker    *workers  = (Worker*)malloc(num_threads * sizeof(Worker));
+    pthread_t *threads  = (pthread_t*)malloc(num_threads * sizeof(pthread_t));
+
+    double start = S_now();
+    for (int i = 0; i < num_threads; i++) {
+        workers[i].mode    = mode;
+        workers[i].counter = shared ? &counters[0] : &counters[i];
+        pthread_create(&threads[i], NULL, S_count, &workers[i]);
+    }
+    for (int i = 0; i < num_threads; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    double elapsed = S_now() - start;
+
+    free(threads);
+    free(workers);
+    free(counters);
+    return elapsed * 1e9 / ITERATIONS;
+}
+
+static void
+S_bench_runtime(void) {
+    String *string = Str_newf("refcount");
+
+    double start = S_now();
+    for (int i = 0; i < ITERATIONS; i++) {
+        INCREF(string);
+        DECREF(string);
+    }
+    double elapsed = S_now() - start;
+
+    printf("runtime INCREF/DECREF: %6.2f ns\n", elapsed * 1e9 / ITERATIONS);
+    DECREF(string);
+}
+
+int
+main(int argc, char **argv) {
+    int max_threads = argc > 1 ? atoi(argv[1]) : 4;
+
+    cfish_bootstrap_parcel();
+    S_bench_runtime();
+
+    printf("\n%-8s %12s %12s %12s\n", "threads", "plain", "atomic",
+           "shared");
+    for (int num_threads = 1; num_threads <= max_threads; num_threads *= 2) {
+        printf("%-8d %9.2f ns %9.2f ns %9.2f ns\n", num_threads,
+               S_run(MODE_PLAIN, num_threads, false),
+               S_run(MODE_ATOMIC, num_threads, false),
+               S_run(MODE_ATOMIC, num_threads, true));
+    }
+
+    return 0;
+}
+
@@ -0,0 +1,104 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/* Measure the time it takes to bootstrap the Clownfish parcels, which is
+ * paid by every process before it can make its first object.
+ *
+ * Bootstrapping can only happen once per process, so every run forks a
+ * child which bootstraps and reports the elapsed time through a pipe.
+ *
+ * Usage: ./startup [runs]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include "charmony.h"
+#include "Clownfish/Class.h"
+#include "Clownfish/LockFreeRegistry.h"
+
+void
+testcfish_bootstrap_parcel(void);
+
+static double
+S_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static double
+S_run(void) {
+    int fds[2];
+    if (pipe(fds) != 0) {
+        perror("pipe");
+        exit(1);
+    }
+
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("fork");
+        exit(1);
+    }
+    if (pid == 0) {
+        double start = S_now();
+        testcfish_bootstrap_parcel();
+        double elapsed = S_now() - start;
+        if (write(fds[1], &elapsed, sizeof(elapsed)) != sizeof(elapsed)) {
+            _exit(1);
+        }
+        _exit(0);
+    }
+
+    double elapsed = 0.0;
+    if (read(fds[0], &elapsed, sizeof(elapsed)) != sizeof(elapsed)) {
+        fprintf(stderr, "child failed\n");
+        exit(1);
+    }
+    waitpid(pid, NULL, 0);
+    close(fds[0]);
+    close(fds[1]);
+    return elapsed;
+}
+
+static int
+S_compare_doubles(const void *va, const void *vb) {
+    double a = *(const double*)va;
+    double b = *(const double*)vb;
+    return a < b ? -1 : a > b ? 1 : 0;
+}
+
+int
+main(int argc, char **argv) {
+    int runs = argc > 1 ? atoi(argv[1]) : 200;
+    if (runs < 1) { runs = 1; }
+
+    double *times = (double*)malloc(runs * sizeof(double));
+    for (int i = 0; i < runs; i++) {
+        times[i] = S_run();
+    }
+    qsort(times, runs, sizeof(double), S_compare_doubles);
+
+    printf("bootstrap over %d runs: min %.1f us, median %.1f us\n",
+           runs, times[0] / 1000.0, times[runs / 2] / 1000.0);
+
+    free(times);
+    return 0;
+}
@@ -0,0 +1,97 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* Measure how long it takes to create and destroy Strings of various sizes,
+ * either by copying UTF-8, with Str_newf, or as a substring.  Short Strings
+ * store their characters inline and take a single allocation.
+ *
+ * Usage: ./strings
+ */
+
+#define CFISH_USE_SHORT_NAMES
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include "charmony.h"
+#include "Clownfish/Obj.h"
+#include "Clownfish/String.h"
+
+#define ITERATIONS  10000000
+
+static double
+S_now(void) {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+static double
+S_new_from_utf8(const char *chars, size_t size) {
+    double start = S_now();
+    for (int i = 0; i < ITERATIONS; i++) {
+        String *string = Str_new_from_utf8(chars, size);
+        DECREF(string);
+    }
+    return (S_now() - start) * 1e9 / ITERATIONS;
+}
+
+static double
+S_newf(const char *chars) {
+    double start = S_now();
+    for (int i = 0; i < ITERATIONS; i++) {
+        String *string = Str_newf("%s", chars);
+        DECREF(string);
+    }
+    return (S_now() - start) * 1e9 / ITERATIONS;
+}
+
+static double
+S_substring(const char *chars, size_t size) {
+    String *source = Str_new_from_utf8(chars, size);
+    double start = S_now();
+    for (int i = 0; i < ITERATIONS; i++) {
+        String *string = Str_SubString(source, 1, size - 1);
+        DECREF(string);
+    }
+    double elapsed = S_now() - start;
+    DECREF(source);
+    return elapsed * 1e9 / ITERATIONS;
+}
+
+int
+main() {
+    static const size_t sizes[] = { 8, 24, 60, 100 };
+    char chars[101];
+    memset(chars, 'x', sizeof(chars));
+
+    cfish_bootstrap_parcel();
+
+    printf("%6s %14s %12s %12s\n", "size", "new_from_utf8", "newf",
+           "SubString");
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        size_t size = sizes[i];
+        chars[size] = '\0';
+        printf("%6d %11.2f ns %9.2f ns %9.2f ns\n", (int)size,
+               S_new_from_utf8(chars, size), S_newf(chars),
+               S_substring(chars, size));
+        chars[size] = 'x';
+    }
+
+    return 0;
+}
@@ -28,9 +28,10 @@
 
 Obj*
 Class_Make_Obj_IMP(Class *self) {
-    Obj *obj = (Obj*)Memory_wrapped_calloc(self->obj_alloc_size, 1);
+    Obj *obj = (Obj*)Memory_obj_alloc(self->obj_alloc_size);
     obj->klass = self;
     obj->refcount = 1;
+    if (Class_census_enabled) { Class_census_add(obj); }
     return obj;
 }
 
@@ -70,7 +70,8 @@ S_get_globals() {
         = (cfish_ErrGlobals*)TlsGetValue(err_globals_tls_index);
 
     if (!globals) {
-        globals = (cfish_ErrGlobals*)CALLOCATE(1, sizeof(cfish_ErrGlobals));
+        globals = (cfish_ErrGlobals*)Memory_tagged_calloc(
+                      MEMORY_ERR, 1, sizeof(cfish_ErrGlobals));
         if (!TlsSetValue(err_globals_tls_index, globals)) {
             fprintf(stderr, "TlsSetValue failed: %d\n", GetLastError());
             abort();
@@ -88,7 +89,8 @@ DllMain(HINSTANCE dll, DWORD reason, LPVOID reserved) {
 
         if (globals) {
             DECREF(globals->current_error);
-            FREEMEM(globals);
+            Memory_tagged_free(MEMORY_ERR, globals,
+                               sizeof(cfish_ErrGlobals));
         }
     }
 
@@ -120,7 +122,8 @@ S_get_globals() {
         = (cfish_ErrGlobals*)pthread_getspecific(err_globals_key);
 
     if (!globals) {
-        globals = (cfish_ErrGlobals*)CALLOCATE(1, sizeof(cfish_ErrGlobals));
+        globals = (cfish_ErrGlobals*)Memory_tagged_calloc(
+                      MEMORY_ERR, 1, sizeof(cfish_ErrGlobals));
         int error = pthread_setspecific(err_globals_key, globals);
         if (error) {
             fprintf(stderr, "pthread_setspecific failed: %d\n", error);
@@ -135,7 +138,7 @@ static void
 S_destroy_globals(void *arg) {
     cfish_ErrGlobals *globals = (cfish_ErrGlobals*)arg;
     DECREF(globals->current_error);
-    FREEMEM(globals);
+    Memory_tagged_free(MEMORY_ERR, globals, sizeof(cfish_ErrGlobals));
 }
 
 /****************** No support for thread-local storage ********************/
@@ -201,7 +204,8 @@ Err_warn_mess(String *message) {
 
 Err*
 Err_trap(Err_Attempt_t routine, void *context) {
-    cfish_ErrGlobals *globals = S_get_globals();
+    // Volatile, because the pointer is used again after longjmp.
+    cfish_ErrGlobals *volatile globals = S_get_globals();
 
     jmp_buf  env;
     jmp_buf *prev_env = globals->current_env;
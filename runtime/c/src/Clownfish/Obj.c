@@ -24,6 +24,7 @@
 #include "Clownfish/Class.h"
 #include "Clownfish/Err.h"
 #include "Clownfish/String.h"
+#include "Clownfish/Util/Atomic.h"
 
 static CFISH_INLINE bool
 SI_immortal(cfish_Class *klass) {
@@ -52,6 +53,22 @@ SI_threadsafe_but_not_immortal(cfish_Class *klass) {
     return false;
 }
 
+// Only the thread which drops the last reference sees an old refcount of
+// 1, so it may destroy the object without further synchronization.
+static uint32_t
+S_dec_refcount_atomic(cfish_Obj *self) {
+    size_t old_refcount = Atomic_fetch_add_size(&self->refcount, (size_t)-1);
+    if (old_refcount == 0) {
+        Atomic_fetch_add_size(&self->refcount, 1);
+        THROW(ERR, "Illegal refcount of 0");
+    }
+    else if (old_refcount == 1) {
+        Atomic_fence();
+        Obj_Destroy(self);
+    }
+    return (uint32_t)(old_refcount - 1);
+}
+
 uint32_t
 cfish_get_refcount(void *vself) {
     cfish_Obj *self = (cfish_Obj*)vself;
@@ -78,11 +95,16 @@ cfish_inc_refcount(void *vself) {
             return self;
         }
         else if (SI_threadsafe_but_not_immortal(klass)) {
-            // TODO: use atomic operation
+            Atomic_fetch_add_size(&self->refcount, 1);
+            return self;
         }
     }
 
+#ifdef CFISH_ATOMIC_REFCOUNT
+    Atomic_fetch_add_size(&self->refcount, 1);
+#else
     self->refcount++;
+#endif
     return self;
 }
 
@@ -95,10 +117,13 @@ cfish_dec_refcount(void *vself) {
             return self->refcount;
         }
         else if (SI_threadsafe_but_not_immortal(klass)) {
-            // TODO: use atomic operation
+            return S_dec_refcount_atomic(self);
         }
     }
 
+#ifdef CFISH_ATOMIC_REFCOUNT
+    return S_dec_refcount_atomic(self);
+#else
     uint32_t modified_refcount = INT32_MAX;
     switch (self->refcount) {
         case 0:
@@ -113,6 +138,7 @@ cfish_dec_refcount(void *vself) {
             break;
     }
     return modified_refcount;
+#endif
 }
 
 void*
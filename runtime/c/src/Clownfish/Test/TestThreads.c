@@ -21,9 +21,23 @@
 
 #include "Clownfish/Test/TestThreads.h"
 
+#include "Clownfish/CharBuf.h"
+#include "Clownfish/Class.h"
+#include "Clownfish/ConcurrentHash.h"
 #include "Clownfish/Err.h"
+#include "Clownfish/LockFreeRegistry.h"
+#include "Clownfish/Method.h"
+#include "Clownfish/PersistentHash.h"
 #include "Clownfish/String.h"
 #include "Clownfish/TestHarness/TestBatchRunner.h"
+#include "Clownfish/Util/Atomic.h"
+#include "Clownfish/Util/Memory.h"
+#include "Clownfish/VArray.h"
+
+typedef struct {
+    void (*func)(void *arg);
+    void  *arg;
+} ThreadTask;
 
 /**************************** No thread support ****************************/
 #ifdef CFISH_NOTHREADS
@@ -33,6 +47,46 @@ test_threads(TestBatchRunner *runner) {
     SKIP(runner, 4, "no thread support");
 }
 
+static void
+test_concurrent_hash(TestBatchRunner *runner) {
+    SKIP(runner, 2, "no thread support");
+}
+
+static void
+test_lock_free_registry(TestBatchRunner *runner) {
+    SKIP(runner, 5, "no thread support");
+}
+
+static void
+test_lock_free_registry_delete(TestBatchRunner *runner) {
+    SKIP(runner, 2, "no thread support");
+}
+
+static void
+test_atomic_refcount(TestBatchRunner *runner) {
+    SKIP(runner, 4, "no thread support");
+}
+
+static void
+test_lazy_methods(TestBatchRunner *runner) {
+    SKIP(runner, 2, "no thread support");
+}
+
+static void
+test_obj_slabs(TestBatchRunner *runner) {
+    SKIP(runner, 2, "no thread support");
+}
+
+static void
+test_census(TestBatchRunner *runner) {
+    SKIP(runner, 3, "no thread support");
+}
+
+static void
+test_persistent_hash(TestBatchRunner *runner) {
+    SKIP(runner, 2, "no thread support");
+}
+
 /********************************** Windows ********************************/
 #elif defined(CHY_HAS_WINDOWS_H)
 
@@ -65,6 +119,27 @@ test_threads(TestBatchRunner *runner) {
               "thread doesn't clobber global error");
 }
 
+typedef HANDLE thread_t;
+
+static DWORD
+S_thread_main(void *arg) {
+    ThreadTask *task = (ThreadTask*)arg;
+    task->func(task->arg);
+    return 0;
+}
+
+static bool
+S_spawn(thread_t *thread, ThreadTask *task) {
+    *thread = CreateThread(NULL, 0, S_thread_main, task, 0, NULL);
+    return *thread != NULL;
+}
+
+static void
+S_join(thread_t thread) {
+    WaitForSingleObject(thread, INFINITE);
+    CloseHandle(thread);
+}
+
 /******************************** pthreads *********************************/
 #elif defined(CHY_HAS_PTHREAD_H)
 
@@ -98,6 +173,25 @@ test_threads(TestBatchRunner *runner) {
               "thread doesn't clobber global error");
 }
 
+typedef pthread_t thread_t;
+
+static void*
+S_thread_main(void *arg) {
+    ThreadTask *task = (ThreadTask*)arg;
+    task->func(task->arg);
+    return NULL;
+}
+
+static bool
+S_spawn(thread_t *thread, ThreadTask *task) {
+    return pthread_create(thread, NULL, S_thread_main, task) == 0;
+}
+
+static void
+S_join(thread_t thread) {
+    pthread_join(thread, NULL);
+}
+
 /****************** No support for thread-local storage ********************/
 #else
 
@@ -105,9 +199,680 @@ test_threads(TestBatchRunner *runner) {
 
 #endif
 
+/*************************** Thread-agnostic tests **************************/
+#ifndef CFISH_NOTHREADS
+
+#define NUM_READERS  4
+#define NUM_KEYS     1000
+
+#define NUM_ROUNDS   20
+
+typedef struct {
+    ConcurrentHash   *hash;
+    LockFreeRegistry *registry;
+    String           *keys[NUM_KEYS];
+    volatile bool     done;
+} ReadContext;
+
+typedef struct {
+    ReadContext *context;
+    uint64_t     num_reads;
+    uint64_t     num_errors;
+} ReaderState;
+
+// Fetch keys until the writer is done.  Every value must start with its
+// key.
+static void
+S_read_concurrently(void *arg) {
+    ReaderState *state   = (ReaderState*)arg;
+    ReadContext *context = state->context;
+    uint32_t     tick    = 0;
+    while (!context->done) {
+        String *key   = context->keys[tick];
+        Obj    *value = CHash_Fetch(context->hash, key);
+        if (value && !Str_Starts_With((String*)value, key)) {
+            state->num_errors++;
+        }
+        state->num_reads++;
+        tick = (tick + 7) % NUM_KEYS;
+    }
+}
+
+static void
+test_concurrent_hash(TestBatchRunner *runner) {
+    ReadContext context;
+    ReaderState states[NUM_READERS];
+    ThreadTask  tasks[NUM_READERS];
+    thread_t    threads[NUM_READERS];
+    int         num_threads = 0;
+
+    context.hash     = CHash_new(0);
+    context.registry = NULL;
+    context.done     = false;
+    for (uint32_t i = 0; i < NUM_KEYS; i++) {
+        // The readers share the keys, so cache their hash sums up front.
+        context.keys[i] = Str_newf("%u32:", i);
+        Str_Hash_Sum(context.keys[i]);
+    }
+
+    for (int i = 0; i < NUM_READERS; i++) {
+        states[i].context    = &context;
+        states[i].num_reads  = 0;
+        states[i].num_errors = 0;
+        tasks[i].func        = S_read_concurrently;
+        tasks[i].arg         = &states[i];
+        if (S_spawn(&threads[i], &tasks[i])) { num_threads++; }
+    }
+
+    // Insert, replace and delete while the readers run, forcing rebuilds
+    // along the way.  Retired values must outlive the readers.
+    for (uint32_t round = 0; round < NUM_ROUNDS; round++) {
+        for (uint32_t i = 0; i < NUM_KEYS; i++) {
+            String *key = context.keys[i];
+            if ((i + round) % 5 == 0) {
+                CHash_Delete(context.hash, key);
+            }
+            else {
+                String *value = Str_newf("%o%u32", key, round);
+                CHash_Store(context.hash, key, (Obj*)value);
+            }
+        }
+    }
+
+    context.done = true;
+    uint64_t num_errors = 0;
+    for (int i = 0; i < num_threads; i++) {
+        S_join(threads[i]);
+        num_errors += states[i].num_errors;
+    }
+    TEST_INT_EQ(runner, num_threads, NUM_READERS, "spawn reader threads");
+    TEST_TRUE(runner, num_errors == 0,
+              "concurrent readers see consistent values");
+
+    CHash_Reclaim(context.hash);
+    for (uint32_t i = 0; i < NUM_KEYS; i++) {
+        DECREF(context.keys[i]);
+    }
+    DECREF(context.hash);
+}
+
+// Like S_read_concurrently, but against a LockFreeRegistry.
+static void
+S_fetch_concurrently(void *arg) {
+    ReaderState *state   = (ReaderState*)arg;
+    ReadContext *context = state->context;
+    uint32_t     tick    = 0;
+    while (!context->done) {
+        String *key   = context->keys[tick];
+        Obj    *value = LFReg_Fetch(context->registry, key);
+        if (value && !Str_Starts_With((String*)value, key)) {
+            state->num_errors++;
+        }
+        state->num_reads++;
+        tick = (tick + 7) % NUM_KEYS;
+    }
+}
+
+static void
+test_lock_free_registry_delete(TestBatchRunner *runner) {
+    ReadContext context;
+    ReaderState states[NUM_READERS];
+    ThreadTask  tasks[NUM_READERS];
+    thread_t    threads[NUM_READERS];
+    int         num_threads = 0;
+
+    // Entries are freed as soon as the readers are done with them, which
+    // is what this test is about.  Fetch only borrows values, though, so
+    // the test keeps its own reference to every value.
+    String **values
+        = (String**)MALLOCATE(NUM_KEYS * NUM_ROUNDS * sizeof(String*));
+    context.hash     = NULL;
+    context.registry = LFReg_new(16);
+    context.done     = false;
+    for (uint32_t i = 0; i < NUM_KEYS; i++) {
+        // The readers share the keys, so cache their hash sums up front.
+        context.keys[i] = Str_newf("%u32:", i);
+        Str_Hash_Sum(context.keys[i]);
+        for (uint32_t round = 0; round < NUM_ROUNDS; round++) {
+            values[i * NUM_ROUNDS + round]
+                = Str_newf("%o%u32", context.keys[i], round);
+        }
+    }
+
+    for (int i = 0; i < NUM_READERS; i++) {
+        states[i].context    = &context;
+        states[i].num_reads  = 0;
+        states[i].num_errors = 0;
+        tasks[i].func        = S_fetch_concurrently;
+        tasks[i].arg         = &states[i];
+        if (S_spawn(&threads[i], &tasks[i])) { num_threads++; }
+    }
+
+    for (uint32_t round = 0; round < NUM_ROUNDS; round++) {
+        for (uint32_t i = 0; i < NUM_KEYS; i++) {
+            String *key = context.keys[i];
+            if ((i + round) % 5 == 0) {
+                LFReg_Delete(context.registry, key);
+            }
+            else {
+                Obj *value = (Obj*)values[i * NUM_ROUNDS + round];
+                LFReg_Store(context.registry, key, value);
+            }
+        }
+    }
+
+    context.done = true;
+    uint64_t num_errors = 0;
+    for (int i = 0; i < num_threads; i++) {
+        S_join(threads[i]);
+        num_errors += states[i].num_errors;
+    }
+    TEST_INT_EQ(runner, num_threads, NUM_READERS, "spawn reader threads");
+    TEST_TRUE(runner, num_errors == 0,
+              "Fetch is consistent during concurrent Store and Delete");
+
+    DECREF(context.registry);
+    for (uint32_t i = 0; i < NUM_KEYS; i++) {
+        DECREF(context.keys[i]);
+        for (uint32_t round = 0; round < NUM_ROUNDS; round++) {
+            DECREF(values[i * NUM_ROUNDS + round]);
+        }
+    }
+    FREEMEM(values);
+}
+
+#define NUM_WRITERS      4
+#define KEYS_PER_WRITER  2000
+#define NUM_SHARED_KEYS  500
+
+typedef struct {
+    LockFreeRegistry *registry;
+    uint32_t          id;
+    uint64_t          num_shared;
+    uint64_t          num_errors;
+} WriterState;
+
+// Register keys private to this thread, racing the other threads for the
+// shared keys, and check that everything registered so far is visible.
+static void
+S_register_concurrently(void *arg) {
+    WriterState      *state    = (WriterState*)arg;
+    LockFreeRegistry *registry = state->registry;
+
+    for (uint32_t i = 0; i < KEYS_PER_WRITER; i++) {
+        String *key = Str_newf("%u32:%u32", state->id, i);
+        if (!LFReg_Register(registry, key, (Obj*)key)) {
+            state->num_errors++;
+        }
+        DECREF(key);
+
+        if (i < NUM_SHARED_KEYS) {
+            String *shared = Str_newf("shared %u32", i);
+            if (LFReg_Register(registry, shared, (Obj*)shared)) {
+                state->num_shared++;
+            }
+            Obj *value = LFReg_Fetch(registry, shared);
+            if (!value || !Str_Equals(shared, value)) {
+                state->num_errors++;
+            }
+            DECREF(shared);
+        }
+
+        String *earlier = Str_newf("%u32:%u32", state->id, i / 2);
+        Obj    *value   = LFReg_Fetch(registry, earlier);
+        if (!value || !Str_Equals(earlier, value)) {
+            state->num_errors++;
+        }
+        DECREF(earlier);
+    }
+}
+
+static void
+test_lock_free_registry(TestBatchRunner *runner) {
+    WriterState states[NUM_WRITERS];
+    ThreadTask  tasks[NUM_WRITERS];
+    thread_t    threads[NUM_WRITERS];
+    int         num_threads = 0;
+
+    // Start with a single bucket so that the writers race to grow it.
+    LockFreeRegistry *registry = LFReg_new(1);
+
+    for (int i = 0; i < NUM_WRITERS; i++) {
+        states[i].registry   = registry;
+        states[i].id         = (uint32_t)i;
+        states[i].num_shared = 0;
+        states[i].num_errors = 0;
+        tasks[i].func        = S_register_concurrently;
+        tasks[i].arg         = &states[i];
+        if (S_spawn(&threads[i], &tasks[i])) { num_threads++; }
+    }
+
+    uint64_t num_shared = 0;
+    uint64_t num_errors = 0;
+    for (int i = 0; i < num_threads; i++) {
+        S_join(threads[i]);
+        num_shared += states[i].num_shared;
+        num_errors += states[i].num_errors;
+    }
+    TEST_INT_EQ(runner, num_threads, NUM_WRITERS, "spawn writer threads");
+    TEST_TRUE(runner, num_errors == 0,
+              "concurrent Register and Fetch are consistent");
+    TEST_TRUE(runner, num_shared == NUM_SHARED_KEYS,
+              "each contended key registered exactly once");
+    TEST_INT_EQ(runner, LFReg_Get_Size(registry),
+                NUM_WRITERS * KEYS_PER_WRITER + NUM_SHARED_KEYS,
+                "Get_Size after concurrent Register");
+
+    bool found = true;
+    for (uint32_t id = 0; id < NUM_WRITERS; id++) {
+        for (uint32_t i = 0; i < KEYS_PER_WRITER; i++) {
+            String *key = Str_newf("%u32:%u32", id, i);
+            if (!LFReg_Fetch(registry, key)) { found = false; }
+            DECREF(key);
+        }
+    }
+    TEST_TRUE(runner, found, "every key found after concurrent Register");
+
+    DECREF(registry);
+}
+
+#define NUM_SHARERS    4
+#define NUM_INCREFS    100000
+
+typedef struct {
+    Obj    *registry;
+    Obj    *string;
+    size_t *counter;
+} ShareState;
+
+static void
+S_share_concurrently(void *arg) {
+    ShareState *state = (ShareState*)arg;
+    for (uint32_t i = 0; i < NUM_INCREFS; i++) {
+        Atomic_fetch_add_size(state->counter, 1);
+        INCREF(state->registry);
+        DECREF(state->registry);
+#ifdef CFISH_ATOMIC_REFCOUNT
+        INCREF(state->string);
+        DECREF(state->string);
+#endif
+    }
+}
+
+static void
+test_atomic_refcount(TestBatchRunner *runner) {
+    ShareState state;
+    ThreadTask tasks[NUM_SHARERS];
+    thread_t   threads[NUM_SHARERS];
+    int        num_threads = 0;
+    size_t     counter     = 0;
+
+    state.registry = (Obj*)LFReg_new(1);
+    state.string   = (Obj*)Str_newf("shared");
+    state.counter  = &counter;
+    for (int i = 0; i < NUM_SHARERS; i++) {
+        tasks[i].func = S_share_concurrently;
+        tasks[i].arg  = &state;
+        if (S_spawn(&threads[i], &tasks[i])) { num_threads++; }
+    }
+    for (int i = 0; i < num_threads; i++) {
+        S_join(threads[i]);
+    }
+
+    TEST_INT_EQ(runner, num_threads, NUM_SHARERS, "spawn sharer threads");
+    TEST_TRUE(runner, counter == (size_t)NUM_SHARERS * NUM_INCREFS,
+              "fetch_add_size from many threads");
+    TEST_INT_EQ(runner, REFCOUNT_NN(state.registry), 1,
+                "refcount of thread-safe class survives sharing");
+#ifdef CFISH_ATOMIC_REFCOUNT
+    TEST_INT_EQ(runner, REFCOUNT_NN(state.string), 1,
+                "refcount of any object survives sharing");
+#else
+    SKIP(runner, 1, "atomic refcounts not enabled");
+#endif
+
+    DECREF(state.string);
+    DECREF(state.registry);
+}
+
+#define NUM_INTROSPECTORS 4
+
+typedef struct {
+    size_t *ready;
+    Obj    *first_method;
+} IntrospectState;
+
+static void
+S_introspect_concurrently(void *arg) {
+    IntrospectState *state = (IntrospectState*)arg;
+
+    // Line up all threads so that they race to create the Methods.
+    Atomic_fetch_add_size(state->ready, 1);
+    while (Atomic_load_acquire_size(state->ready) < NUM_INTROSPECTORS) {}
+
+    VArray *methods = Class_Get_Methods(CHARBUF);
+    state->first_method = VA_Fetch(methods, 0);
+    DECREF(methods);
+}
+
+static void
+test_lazy_methods(TestBatchRunner *runner) {
+    thread_t        threads[NUM_INTROSPECTORS];
+    ThreadTask      tasks[NUM_INTROSPECTORS];
+    IntrospectState states[NUM_INTROSPECTORS];
+    int             num_threads = 0;
+    size_t          ready       = 0;
+
+    for (int i = 0; i < NUM_INTROSPECTORS; i++) {
+        states[i].ready        = &ready;
+        states[i].first_method = NULL;
+        tasks[i].func = S_introspect_concurrently;
+        tasks[i].arg  = &states[i];
+        if (S_spawn(&threads[i], &tasks[i])) { num_threads++; }
+    }
+    for (int i = 0; i < num_threads; i++) {
+        S_join(threads[i]);
+    }
+
+    TEST_INT_EQ(runner, num_threads, NUM_INTROSPECTORS,
+                "spawn introspector threads");
+    bool same = states[0].first_method != NULL;
+    for (int i = 1; i < num_threads; i++) {
+        if (states[i].first_method != states[0].first_method) {
+            same = false;
+        }
+    }
+    TEST_TRUE(runner, same,
+              "concurrent Get_Methods publishes a single set of Methods");
+}
+
+#define NUM_SLAB_THREADS   4
+#define BLOCKS_PER_THREAD  5000
+#define SLAB_BLOCK_SIZE    32
+
+typedef struct {
+    uint32_t thread_num;
+    uint32_t block_num;
+} SlabStamp;
+
+typedef struct {
+    void     **blocks;
+    uint32_t   thread_num;
+} SlabState;
+
+static void
+S_free_blocks(void *arg) {
+    SlabState *state = (SlabState*)arg;
+    for (uint32_t i = 0; i < BLOCKS_PER_THREAD; i++) {
+        Memory_obj_free(state->blocks[i], SLAB_BLOCK_SIZE);
+    }
+}
+
+static void
+S_alloc_blocks(void *arg) {
+    SlabState *state = (SlabState*)arg;
+    for (uint32_t i = 0; i < BLOCKS_PER_THREAD; i++) {
+        SlabStamp *stamp = (SlabStamp*)Memory_obj_alloc(SLAB_BLOCK_SIZE);
+        stamp->thread_num = state->thread_num;
+        stamp->block_num  = i;
+        state->blocks[i] = stamp;
+    }
+}
+
+static int
+S_run_slab_threads(void (*func)(void*), SlabState *states) {
+    thread_t   threads[NUM_SLAB_THREADS];
+    ThreadTask tasks[NUM_SLAB_THREADS];
+    int        num_threads = 0;
+
+    for (int i = 0; i < NUM_SLAB_THREADS; i++) {
+        tasks[i].func = func;
+        tasks[i].arg  = &states[i];
+        if (S_spawn(&threads[i], &tasks[i])) { num_threads++; }
+    }
+    for (int i = 0; i < num_threads; i++) {
+        S_join(threads[i]);
+    }
+
+    return num_threads;
+}
+
+static void
+test_obj_slabs(TestBatchRunner *runner) {
+    SlabState states[NUM_SLAB_THREADS];
+    int       num_threads = 0;
+
+    // Blocks allocated here are freed by other threads, which hand them on
+    // through the depot when their free lists overflow or they exit.
+    for (uint32_t i = 0; i < NUM_SLAB_THREADS; i++) {
+        states[i].blocks
+            = (void**)MALLOCATE(BLOCKS_PER_THREAD * sizeof(void*));
+        states[i].thread_num = i;
+        for (uint32_t j = 0; j < BLOCKS_PER_THREAD; j++) {
+            states[i].blocks[j] = Memory_obj_alloc(SLAB_BLOCK_SIZE);
+        }
+    }
+    num_threads += S_run_slab_threads(S_free_blocks, states);
+    num_threads += S_run_slab_threads(S_alloc_blocks, states);
+    TEST_INT_EQ(runner, num_threads, 2 * NUM_SLAB_THREADS,
+                "spawn slab threads");
+
+    // A block handed out twice would carry the wrong stamp.
+    bool intact = true;
+    for (uint32_t i = 0; i < NUM_SLAB_THREADS; i++) {
+        for (uint32_t j = 0; j < BLOCKS_PER_THREAD; j++) {
+            SlabStamp *stamp = (SlabStamp*)states[i].blocks[j];
+            if (stamp->thread_num != i || stamp->block_num != j) {
+                intact = false;
+            }
+            Memory_obj_free(stamp, SLAB_BLOCK_SIZE);
+        }
+        FREEMEM(states[i].blocks);
+    }
+    TEST_TRUE(runner, intact,
+              "blocks freed on other threads are handed out once");
+}
+
+#define NUM_CENSUS_THREADS  4
+#define OBJS_PER_THREAD     1000
+
+typedef struct {
+    Class  *klass;
+    Obj   **objs;
+} CensusState;
+
+static void
+S_destroy_objs(void *arg) {
+    CensusState *state = (CensusState*)arg;
+    for (uint32_t i = 0; i < OBJS_PER_THREAD; i++) {
+        DECREF(state->objs[i]);
+    }
+}
+
+static void
+S_make_objs(void *arg) {
+    CensusState *state = (CensusState*)arg;
+    for (uint32_t i = 0; i < OBJS_PER_THREAD; i++) {
+        state->objs[i] = Class_Make_Obj(state->klass);
+    }
+}
+
+static int
+S_run_census_threads(void (*func)(void*), CensusState *states) {
+    thread_t   threads[NUM_CENSUS_THREADS];
+    ThreadTask tasks[NUM_CENSUS_THREADS];
+    int        num_threads = 0;
+
+    for (int i = 0; i < NUM_CENSUS_THREADS; i++) {
+        tasks[i].func = func;
+        tasks[i].arg  = &states[i];
+        if (S_spawn(&threads[i], &tasks[i])) { num_threads++; }
+        else { func(&states[i]); }
+    }
+    for (int i = 0; i < num_threads; i++) {
+        S_join(threads[i]);
+    }
+
+    return num_threads;
+}
+
+static void
+test_census(TestBatchRunner *runner) {
+    if (!Class_census_enabled) {
+        SKIP(runner, 3, "census disabled");
+        return;
+    }
+
+    String      *name        = Str_newf("TestThreads::Census");
+    Class       *klass       = Class_singleton(name, OBJ);
+    CensusState  states[NUM_CENSUS_THREADS];
+    int          num_threads = 0;
+
+    // Objects made by worker threads are destroyed by the main thread and
+    // vice versa, after the workers have exited.
+    for (int i = 0; i < NUM_CENSUS_THREADS; i++) {
+        states[i].klass = klass;
+        states[i].objs  = (Obj**)MALLOCATE(OBJS_PER_THREAD * sizeof(Obj*));
+    }
+    num_threads += S_run_census_threads(S_make_objs, states);
+    TEST_TRUE(runner, Class_Get_Live_Count(klass)
+                      == NUM_CENSUS_THREADS * OBJS_PER_THREAD,
+              "census merges counts of exited threads");
+
+    S_destroy_objs(&states[0]);
+    S_make_objs(&states[0]);
+    num_threads += S_run_census_threads(S_destroy_objs, states);
+    TEST_INT_EQ(runner, num_threads, 2 * NUM_CENSUS_THREADS,
+                "spawn census threads");
+    TEST_TRUE(runner, Class_Get_Live_Count(klass) == 0
+                      && Class_Get_Live_Bytes(klass) == 0,
+              "census balances objects destroyed on other threads");
+
+    for (int i = 0; i < NUM_CENSUS_THREADS; i++) {
+        FREEMEM(states[i].objs);
+    }
+    DECREF(name);
+}
+
+#ifdef CFISH_ATOMIC_REFCOUNT
+
+#define NUM_DERIVERS     4
+#define NUM_DERIVATIONS  10000
+#define NUM_BASE_KEYS    256
+
+typedef struct {
+    PersistentHash  *base;
+    String         **keys;
+    uint32_t         offset;
+    uint32_t         num_errors;
+} DeriveState;
+
+// Derive versions from a shared base and release them right away, while
+// other threads do the same.  All versions share nodes with the base.
+static void
+S_derive_concurrently(void *arg) {
+    DeriveState *state = (DeriveState*)arg;
+    for (uint32_t i = 0; i < NUM_DERIVATIONS; i++) {
+        String *key   = state->keys[(state->offset + i) % NUM_BASE_KEYS];
+        String *extra = Str_newf("extra %u32 %u32", state->offset, i);
+
+        PersistentHash *stored  = PHash_Store(state->base, extra,
+                                              INCREF(extra));
+        PersistentHash *deleted = PHash_Delete(stored, key);
+        PersistentHash *same    = PHash_Delete(deleted, key);
+        if (PHash_Get_Size(same) != NUM_BASE_KEYS
+            || PHash_Fetch(same, key)
+            || PHash_Fetch(same, extra) != (Obj*)extra
+           ) {
+            state->num_errors++;
+        }
+
+        DECREF(stored);
+        DECREF(deleted);
+        DECREF(same);
+        DECREF(extra);
+    }
+}
+
+static void
+test_persistent_hash(TestBatchRunner *runner) {
+    String         *keys[NUM_BASE_KEYS];
+    DeriveState     states[NUM_DERIVERS];
+    ThreadTask      tasks[NUM_DERIVERS];
+    thread_t        threads[NUM_DERIVERS];
+    int             num_threads = 0;
+    bool            was_enabled = Memory_stats_enabled();
+    PersistentHash *base        = PHash_new();
+    MemoryStats     before, after;
+
+    for (uint32_t i = 0; i < NUM_BASE_KEYS; i++) {
+        keys[i] = Str_newf("%u32", i);
+        PersistentHash *next = PHash_Store(base, keys[i], INCREF(keys[i]));
+        DECREF(base);
+        base = next;
+    }
+
+    // A lost update of a node's refcount either leaks the node or frees it
+    // too early, so count the live nodes.
+    Memory_enable_stats(true);
+    Memory_get_stats(MEMORY_HASH, &before);
+    for (int i = 0; i < NUM_DERIVERS; i++) {
+        states[i].base       = base;
+        states[i].keys       = keys;
+        states[i].offset     = (uint32_t)i * (NUM_BASE_KEYS / NUM_DERIVERS);
+        states[i].num_errors = 0;
+        tasks[i].func = S_derive_concurrently;
+        tasks[i].arg  = &states[i];
+        if (S_spawn(&threads[i], &tasks[i])) { num_threads++; }
+    }
+    for (int i = 0; i < num_threads; i++) {
+        S_join(threads[i]);
+    }
+    Memory_get_stats(MEMORY_HASH, &after);
+    Memory_enable_stats(was_enabled);
+    TEST_INT_EQ(runner, num_threads, NUM_DERIVERS, "spawn deriver threads");
+
+    bool intact = PHash_Get_Size(base) == NUM_BASE_KEYS
+                  && after.num_allocs - before.num_allocs
+                     == after.num_frees - before.num_frees;
+    for (int i = 0; i < NUM_DERIVERS; i++) {
+        if (states[i].num_errors) { intact = false; }
+    }
+    for (uint32_t i = 0; i < NUM_BASE_KEYS; i++) {
+        if (PHash_Fetch(base, keys[i]) != (Obj*)keys[i]) { intact = false; }
+    }
+    TEST_TRUE(runner, intact,
+              "PersistentHash versions sharing nodes released while"
+              " deriving on other threads");
+
+    DECREF(base);
+    for (uint32_t i = 0; i < NUM_BASE_KEYS; i++) {
+        DECREF(keys[i]);
+    }
+}
+
+#else /* CFISH_ATOMIC_REFCOUNT */
+
+static void
+test_persistent_hash(TestBatchRunner *runner) {
+    SKIP(runner, 2, "atomic refcounts not enabled");
+}
+
+#endif /* CFISH_ATOMIC_REFCOUNT */
+
+#endif /* CFISH_NOTHREADS */
+
 void
 TestThreads_Run_IMP(TestThreads *self, TestBatchRunner *runner) {
-    TestBatchRunner_Plan(runner, (TestBatch*)self, 4);
+    TestBatchRunner_Plan(runner, (TestBatch*)self, 26);
     test_threads(runner);
+    test_concurrent_hash(runner);
+    test_lock_free_registry(runner);
+    test_lock_free_registry_delete(runner);
+    test_atomic_refcount(runner);
+    test_lazy_methods(runner);
+    test_obj_slabs(runner);
+    test_census(runner);
+    test_persistent_hash(runner);
 }
 
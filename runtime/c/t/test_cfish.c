@@ -16,6 +16,7 @@
 
 #include <stdlib.h>
 
+#include "Clownfish/Class.h"
 #include "Clownfish/TestHarness/TestFormatter.h"
 #include "Clownfish/TestHarness/TestSuite.h"
 #include "Clownfish/Test.h"
@@ -26,6 +27,9 @@ main() {
     cfish_TestSuite     *suite;
     bool success;
 
+    // The census can only be enabled before bootstrapping.  Enable it for
+    // the tests which check it.
+    cfish_Class_enable_census(true);
     testcfish_bootstrap_parcel();
 
     formatter = (cfish_TestFormatter*)cfish_TestFormatterCF_new();
@@ -7847,6 +7847,12 @@ int main(int argc, const char **argv) {
                       CHAZ_CLI_ARG_REQUIRED);
     chaz_CLI_register(cli, "disable-threads", "whether to disable threads",
                       CHAZ_CLI_NO_ARG);
+    chaz_CLI_register(cli, "enable-atomic-refcount",
+                      "whether to update all refcounts atomically",
+                      CHAZ_CLI_NO_ARG);
+    chaz_CLI_register(cli, "disable-obj-slabs",
+                      "whether to allocate every object with calloc",
+                      CHAZ_CLI_NO_ARG);
     chaz_CLI_set_usage(cli, "Usage: charmonizer [OPTIONS] [-- [CFLAGS]]");
     if (!chaz_Probe_parse_cli_args(argc, argv, cli)) {
         chaz_Probe_die_usage();
@@ -7884,6 +7890,15 @@ int main(int argc, const char **argv) {
         chaz_ConfWriter_append_conf(
             "#define CHY_HAS___SYNC_BOOL_COMPARE_AND_SWAP\n\n");
     }
+    if (chaz_CC_test_compile("static __thread int x;\n"
+                             "int main(void) { return x; }\n")) {
+        chaz_ConfWriter_append_conf("#define CHY_HAS___THREAD\n\n");
+    }
+    else if (chaz_CC_test_compile("static __declspec(thread) int x;\n"
+                                  "int main(void) { return x; }\n")) {
+        chaz_ConfWriter_append_conf(
+            "#define CHY_HAS___DECLSPEC_THREAD\n\n");
+    }
     chaz_ConfWriter_append_conf(
         "#ifdef CHY_HAS_SYS_TYPES_H\n"
         "  #include <sys/types.h>\n"
@@ -7973,6 +7988,12 @@ S_add_compiler_flags(struct chaz_CLI *cli) {
     if (chaz_CLI_defined(cli, "disable-threads")) {
         chaz_CFlags_append(extra_cflags, "-DCFISH_NOTHREADS");
     }
+    else if (chaz_CLI_defined(cli, "enable-atomic-refcount")) {
+        chaz_CFlags_append(extra_cflags, "-DCFISH_ATOMIC_REFCOUNT");
+    }
+    if (chaz_CLI_defined(cli, "disable-obj-slabs")) {
+        chaz_CFlags_append(extra_cflags, "-DCFISH_NO_OBJ_SLABS");
+    }
 }
 
 static cfish_MakeFile*
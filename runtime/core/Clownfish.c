@@ -15,15 +15,11 @@
  */
 
 #include "Clownfish/Num.h"
-#include "Clownfish/Hash.h"
-#include "Clownfish/HashIterator.h"
 #include "Clownfish/Err.h"
 
 void
 cfish_init_parcel() {
     cfish_Bool_init_class();
-    cfish_Hash_init_class();
-    cfish_HashIter_init_class();
     cfish_Err_init_class();
 }
 
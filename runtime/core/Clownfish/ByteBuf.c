@@ -26,6 +26,7 @@
 #include "Clownfish/Class.h"
 #include "Clownfish/ByteBuf.h"
 #include "Clownfish/Err.h"
+#include "Clownfish/Util/HashUtils.h"
 #include "Clownfish/Util/Memory.h"
 
 static void
@@ -127,14 +128,7 @@ BB_Equals_Bytes_IMP(ByteBuf *self, const void *bytes, size_t size) {
 
 int32_t
 BB_Hash_Sum_IMP(ByteBuf *self) {
-    uint32_t       sum = 5381;
-    uint8_t *const buf = (uint8_t*)self->buf;
-
-    for (size_t i = 0, max = self->size; i < max; i++) {
-        sum = ((sum << 5) + sum) ^ buf[i];
-    }
-
-    return (int32_t)sum;
+    return HashUtil_hash_sum(self->buf, self->size);
 }
 
 static CFISH_INLINE void
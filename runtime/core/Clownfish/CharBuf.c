@@ -56,7 +56,7 @@ CB_new(size_t size) {
 CharBuf*
 CB_init(CharBuf *self, size_t size) {
     // Derive.
-    self->ptr = (char*)MALLOCATE(size + 1);
+    self->ptr = (char*)Memory_owned_malloc(self, MEMORY_STRING, size + 1);
 
     // Init.
     *self->ptr = '\0'; // Empty string.
@@ -86,7 +86,7 @@ CB_new_from_trusted_utf8(const char *ptr, size_t size) {
     CharBuf *self = (CharBuf*)Class_Make_Obj(CHARBUF);
 
     // Derive.
-    self->ptr = (char*)MALLOCATE(size + 1);
+    self->ptr = (char*)Memory_owned_malloc(self, MEMORY_STRING, size + 1);
 
     // Copy.
     memcpy(self->ptr, ptr, size);
@@ -111,15 +111,16 @@ CB_newf(const char *pattern, ...) {
 
 void
 CB_Destroy_IMP(CharBuf *self) {
-    FREEMEM(self->ptr);
+    Memory_owned_free(self, MEMORY_STRING, self->ptr, self->cap);
     SUPER_DESTROY(self, CHARBUF);
 }
 
 char*
 CB_Grow_IMP(CharBuf *self, size_t size) {
     if (size >= self->cap) {
+        self->ptr = (char*)Memory_owned_realloc(self, MEMORY_STRING, self->ptr,
+                                                self->cap, size + 1);
         self->cap = size + 1;
-        self->ptr = (char*)REALLOCATE(self->ptr, self->cap);
     }
     return self->ptr;
 }
@@ -295,6 +296,14 @@ CB_To_String_IMP(CharBuf *self) {
 
 String*
 CB_Yield_String_IMP(CharBuf *self) {
+    if (self->size <= STR_MAX_INLINE_SIZE) {
+        // Copying short content into a String with inline storage is
+        // cheaper than keeping the oversized buffer alive.
+        String *retval = Str_new_from_trusted_utf8(self->ptr, self->size);
+        self->size = 0;
+        return retval;
+    }
+    Memory_owned_disown(self, MEMORY_STRING, self->ptr, self->cap);
     String *retval
         = Str_new_steal_trusted_utf8(self->ptr, self->size);
     self->ptr  = NULL;
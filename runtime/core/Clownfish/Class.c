@@ -29,12 +29,13 @@
 #include "Clownfish/String.h"
 #include "Clownfish/CharBuf.h"
 #include "Clownfish/Err.h"
-#include "Clownfish/Hash.h"
+#include "Clownfish/HashSet.h"
 #include "Clownfish/LockFreeRegistry.h"
 #include "Clownfish/Method.h"
 #include "Clownfish/Num.h"
 #include "Clownfish/VArray.h"
 #include "Clownfish/Util/Atomic.h"
+#include "Clownfish/Util/HashUtils.h"
 #include "Clownfish/Util/Memory.h"
 
 #define NovelMethSpec            cfish_NovelMethSpec
@@ -44,13 +45,63 @@
 
 size_t Class_offset_of_parent = offsetof(Class, parent);
 
+static Method**
+S_get_methods(Class *self);
+
 static Method*
 S_find_method(Class *self, const char *meth_name);
 
 static int32_t
 S_claim_parcel_id(void);
 
+static void
+S_census_register(Class *klass);
+
+static void
+S_census_exclude(Obj *obj);
+
+static void
+S_init_census(void);
+
 LockFreeRegistry *Class_registry = NULL;
+bool Class_census_enabled = false;
+
+// A direct-mapped cache in front of the registry.  The slot is picked from
+// the address and length of the name, so a host which passes the same
+// buffer every time finds its Class without hashing the name.  Slots only
+// hold Classes, which are immortal, and a hit is confirmed by comparing
+// names, so threads may overwrite each other's slots freely.
+#define CLASS_CACHE_SIZE 256
+static Class *volatile Class_cache[CLASS_CACHE_SIZE];
+
+static CFISH_INLINE Class *volatile*
+SI_cache_slot(String *class_name) {
+    uint64_t key = (uint64_t)(uintptr_t)class_name->ptr
+                   ^ ((uint64_t)class_name->size << 48);
+    return &Class_cache[HashUtil_mix64(key) & (CLASS_CACHE_SIZE - 1)];
+}
+
+static Class*
+S_fetch_cached(String *class_name) {
+    Class *klass = *SI_cache_slot(class_name);
+    if (klass
+        && klass->name->size == class_name->size
+        && memcmp(klass->name->ptr, class_name->ptr, class_name->size) == 0
+       ) {
+        return klass;
+    }
+    return NULL;
+}
+
+// Aliases are left out, since a hit could never be confirmed.
+static void
+S_cache_class(String *class_name, Class *klass) {
+    if (klass->name->size == class_name->size
+        && memcmp(klass->name->ptr, class_name->ptr, class_name->size) == 0
+       ) {
+        *SI_cache_slot(class_name) = klass;
+    }
+}
 
 void
 Class_bootstrap(const ClassSpec *specs, size_t num_specs)
@@ -89,7 +140,8 @@ Class_bootstrap(const ClassSpec *specs, size_t num_specs)
         size_t class_alloc_size = novel_offset
                                   + spec->num_novel_meths
                                     * sizeof(cfish_method_t);
-        Class *klass = (Class*)Memory_wrapped_calloc(class_alloc_size, 1);
+        Class *klass = (Class*)Memory_tagged_calloc(MEMORY_CLASS,
+                                                    class_alloc_size, 1);
 
         klass->parent           = parent;
         klass->parcel_id        = parcel_id;
@@ -138,46 +190,46 @@ Class_bootstrap(const ClassSpec *specs, size_t num_specs)
     /* Pass 2:
      * - Initialize 'klass' instance variable.
      * - Initialize refcount.
+     * - Assign census_id.
      */
     for (size_t i = 0; i < num_specs; ++i) {
         const ClassSpec *spec = &specs[i];
         Class *klass = *spec->klass;
 
         Class_Init_Obj_IMP(CLASS, klass);
+        S_census_register(klass);
     }
 
     /* Now it's safe to call methods.
      *
      * Pass 3:
-     * - Inititalize name and method array.
+     * - Inititalize name.
      * - Register class.
      *
-     * We use a "wrapped" String for `name` because it's effectively
+     * `name` wraps the string literal in the ClassSpec.  That's effectively
      * threadsafe: the sole reference is owned by an immortal object and any
-     * INCREF spawns a copy.
+     * INCREF spawns a copy.  The names of all classes in the parcel share a
+     * single allocation which is never freed.
+     *
+     * Method objects are only needed for host subclasses and introspection,
+     * so they are created from the NovelMethSpecs on first use.
      */
+    size_t  str_size = STRING->obj_alloc_size;
+    char   *str_slot = (char*)Memory_tagged_calloc(MEMORY_CLASS, num_specs,
+                                                  str_size);
+
     for (size_t i = 0; i < num_specs; ++i) {
         const ClassSpec *spec = &specs[i];
         Class *klass = *spec->klass;
 
-        klass->name_internal = Str_newf("%s", spec->name);
-        klass->name
-            = Str_new_wrap_trusted_utf8(Str_Get_Ptr8(klass->name_internal),
-                                        Str_Get_Size(klass->name_internal));
-        klass->methods = (Method**)MALLOCATE((spec->num_novel_meths + 1)
-                                             * sizeof(Method*));
+        String *class_name = (String*)Class_Init_Obj_IMP(STRING, str_slot);
+        klass->name = Str_init_wrap_trusted_utf8(class_name, spec->name,
+                                                 spec->name_len);
+        str_slot += str_size;
 
-        // Only store novel methods for now.
-        for (size_t i = 0; i < spec->num_novel_meths; ++i) {
-            const NovelMethSpec *mspec = &spec->novel_meth_specs[i];
-            StackString *name
-                = SSTR_WRAP_UTF8(mspec->name, strlen(mspec->name));
-            Method *method = Method_new((String*)name, mspec->callback_func,
-                                        *mspec->offset);
-            klass->methods[i] = method;
-        }
-
-        klass->methods[spec->num_novel_meths] = NULL;
+        klass->methods          = NULL;
+        klass->novel_meth_specs = spec->novel_meth_specs;
+        klass->num_novel_meths  = spec->num_novel_meths;
 
         Class_add_to_registry(klass);
     }
@@ -191,7 +243,8 @@ Class_Destroy_IMP(Class *self) {
 Class*
 Class_Clone_IMP(Class *self) {
     Class *twin
-        = (Class*)Memory_wrapped_calloc(self->class_alloc_size, 1);
+        = (Class*)Memory_tagged_calloc(MEMORY_CLASS,
+                                       self->class_alloc_size, 1);
 
     memcpy(twin, self, self->class_alloc_size);
     Class_Init_Obj(self->klass, twin); // Set refcount.
@@ -226,8 +279,10 @@ VArray*
 Class_Get_Methods_IMP(Class *self) {
     VArray *retval = VA_new(0);
 
-    for (size_t i = 0; self->methods[i]; ++i) {
-        VA_Push(retval, INCREF(self->methods[i]));
+    Method **methods = S_get_methods(self);
+
+    for (size_t i = 0; methods[i]; ++i) {
+        VA_Push(retval, INCREF(methods[i]));
     }
 
     return retval;
@@ -235,8 +290,14 @@ Class_Get_Methods_IMP(Class *self) {
 
 void
 Class_init_registry() {
+    // The registry and the Classes live forever, so they must not be
+    // allocated from an arena.
+    Memory_push_heap();
     LockFreeRegistry *reg = LFReg_new(256);
+    Memory_pop_scope();
     if (Atomic_cas_ptr((void*volatile*)&Class_registry, NULL, reg)) {
+        S_census_exclude((Obj*)reg);
+        S_init_census();
         return;
     }
     else {
@@ -246,11 +307,16 @@ Class_init_registry() {
 
 Class*
 Class_singleton(String *class_name, Class *parent) {
+    Class *singleton = S_fetch_cached(class_name);
+    if (singleton) {
+        return singleton;
+    }
+
     if (Class_registry == NULL) {
         Class_init_registry();
     }
 
-    Class *singleton = (Class*)LFReg_Fetch(Class_registry, class_name);
+    singleton = (Class*)LFReg_Fetch(Class_registry, class_name);
     if (singleton == NULL) {
         VArray *fresh_host_methods;
         uint32_t num_fresh;
@@ -268,29 +334,39 @@ Class_singleton(String *class_name, Class *parent) {
         }
 
         // Copy source class.
+        Memory_push_heap();
         singleton = Class_Clone(parent);
 
         // Turn clone into child.
         singleton->parent = parent;
         DECREF(singleton->name);
-        singleton->name = Str_Clone(class_name);
-        singleton->methods = (Method**)CALLOCATE(1, sizeof(Method*));
+        singleton->name
+            = Str_new_from_trusted_utf8(Str_Get_Ptr8(class_name),
+                                        Str_Get_Size(class_name));
+        Memory_pop_scope();
+        S_census_exclude((Obj*)singleton->name);
+        S_census_register(singleton);
+        singleton->methods = (Method**)Memory_tagged_calloc(MEMORY_CLASS, 1,
+                                                            sizeof(Method*));
+        singleton->novel_meth_specs = NULL;
+        singleton->num_novel_meths  = 0;
 
         // Allow host methods to override.
         fresh_host_methods = Class_fresh_host_methods(class_name);
         num_fresh = VA_Get_Size(fresh_host_methods);
         if (num_fresh) {
-            Hash *meths = Hash_new(num_fresh);
+            HashSet *meths = HashSet_new(num_fresh);
             for (uint32_t i = 0; i < num_fresh; i++) {
                 String *meth = (String*)VA_Fetch(fresh_host_methods, i);
-                Hash_Store(meths, meth, (Obj*)CFISH_TRUE);
+                HashSet_Add(meths, meth);
             }
             for (Class *klass = parent; klass; klass = klass->parent) {
-                for (size_t i = 0; klass->methods[i]; i++) {
-                    Method *method = klass->methods[i];
+                Method **methods = S_get_methods(klass);
+                for (size_t i = 0; methods[i]; i++) {
+                    Method *method = methods[i];
                     if (method->callback_func) {
                         String *name = Method_Host_Name(method);
-                        if (Hash_Fetch(meths, name)) {
+                        if (HashSet_Contains(meths, name)) {
                             Class_Override(singleton, method->callback_func,
                                             method->offset);
                         }
@@ -317,6 +393,7 @@ Class_singleton(String *class_name, Class *parent) {
         }
     }
 
+    S_cache_class(class_name, singleton);
     return singleton;
 }
 
@@ -325,15 +402,15 @@ Class_add_to_registry(Class *klass) {
     if (Class_registry == NULL) {
         Class_init_registry();
     }
-    if (LFReg_Fetch(Class_registry, klass->name)) {
-        return false;
-    }
-    else {
-        String *class_name = Str_Clone(klass->name);
-        bool retval = LFReg_Register(Class_registry, class_name, (Obj*)klass);
-        DECREF(class_name);
-        return retval;
+    // INCREF copies a wrapped name.  The registry keeps the copy forever,
+    // so it's left out of the census.
+    String *key = (String*)INCREF(klass->name);
+    bool retval = LFReg_Register(Class_registry, key, (Obj*)klass);
+    if (retval && key != klass->name) {
+        S_census_exclude((Obj*)key);
     }
+    DECREF(key);
+    return retval;
 }
 
 bool
@@ -349,6 +426,9 @@ Class_add_alias_to_registry(Class *klass, const char *alias_ptr,
     else {
         String *class_name = SStr_Clone(alias);
         bool retval = LFReg_Register(Class_registry, class_name, (Obj*)klass);
+        if (retval) {
+            S_census_exclude((Obj*)class_name);
+        }
         DECREF(class_name);
         return retval;
     }
@@ -356,9 +436,12 @@ Class_add_alias_to_registry(Class *klass, const char *alias_ptr,
 
 Class*
 Class_fetch_class(String *class_name) {
-    Class *klass = NULL;
-    if (Class_registry != NULL) {
+    Class *klass = S_fetch_cached(class_name);
+    if (klass == NULL && Class_registry != NULL) {
         klass = (Class*)LFReg_Fetch(Class_registry, class_name);
+        if (klass) {
+            S_cache_class(class_name, klass);
+        }
     }
     return klass;
 }
@@ -373,6 +456,8 @@ Class_Add_Host_Method_Alias_IMP(Class *self, const char *alias,
         abort();
     }
     Method_Set_Host_Alias(method, (String*)alias_cf);
+    S_census_exclude((Obj*)method->host_alias);
+    S_census_exclude((Obj*)method->host_alias_internal);
 }
 
 void
@@ -385,12 +470,63 @@ Class_Exclude_Host_Method_IMP(Class *self, const char *meth_name) {
     method->is_excluded = true;
 }
 
+// Return the NULL-terminated array of the Class's novel methods, creating
+// the Method objects from the NovelMethSpecs on first use.  Racing threads
+// may both build an array, but only one gets published.
+static Method**
+S_get_methods(Class *self) {
+    Method **methods
+        = (Method**)Atomic_load_acquire_ptr((void*volatile*)&self->methods);
+    if (methods) { return methods; }
+
+    size_t num_meths  = self->num_novel_meths;
+    size_t array_size = (num_meths + 1) * sizeof(Method*);
+    methods = (Method**)Memory_tagged_malloc(MEMORY_CLASS, array_size);
+    Memory_push_heap();
+    for (size_t i = 0; i < num_meths; i++) {
+        const NovelMethSpec *mspec = &self->novel_meth_specs[i];
+        StackString *name = SSTR_WRAP_UTF8(mspec->name, strlen(mspec->name));
+        methods[i] = Method_new((String*)name, mspec->callback_func,
+                                *mspec->offset);
+    }
+    Memory_pop_scope();
+    methods[num_meths] = NULL;
+
+    if (Atomic_cas_ptr((void*volatile*)&self->methods, NULL, methods)) {
+        // Only the published Methods are immortal.
+        for (size_t i = 0; i < num_meths; i++) {
+            Method *method = methods[i];
+            S_census_exclude((Obj*)method);
+            S_census_exclude((Obj*)method->name);
+            S_census_exclude((Obj*)method->name_internal);
+        }
+    }
+    else {
+        // Lost the race.  Methods refuse to be destroyed, so free the
+        // unpublished ones by hand, leaving the census the way Obj_Destroy
+        // would.
+        for (size_t i = 0; i < num_meths; i++) {
+            Method *method = methods[i];
+            DECREF(method->name);
+            DECREF(method->name_internal);
+            S_census_exclude((Obj*)method);
+            Memory_obj_free(method, METHOD->obj_alloc_size);
+        }
+        Memory_tagged_free(MEMORY_CLASS, methods, array_size);
+        methods = (Method**)Atomic_load_acquire_ptr(
+                      (void*volatile*)&self->methods);
+    }
+
+    return methods;
+}
+
 static Method*
 S_find_method(Class *self, const char *name) {
-    size_t name_len = strlen(name);
+    size_t    name_len = strlen(name);
+    Method  **methods  = S_get_methods(self);
 
-    for (size_t i = 0; self->methods[i]; i++) {
-        Method *method = self->methods[i];
+    for (size_t i = 0; methods[i]; i++) {
+        Method *method = methods[i];
         if (Str_Equals_Utf8(method->name, name, name_len)) {
             return method;
         }
@@ -418,3 +554,140 @@ S_claim_parcel_id(void) {
     return new_value.num;
 }
 
+
+/* The census counts live objects per Class.  Every Class gets a slot for
+ * the counters kept by Memory_census_add.  The Classes are also recorded in
+ * pages indexed by slot, so that the report can find them.
+ */
+
+#define CENSUS_PAGE_SIZE  256
+#define CENSUS_MAX_PAGES  256
+
+static Class **volatile census_classes[CENSUS_MAX_PAGES];
+static volatile size_t census_num_classes;
+
+static void
+S_census_register(Class *klass) {
+    size_t id = Atomic_fetch_add_size(&census_num_classes, 1);
+    klass->census_id = (uint32_t)id;
+    if (id >= CENSUS_PAGE_SIZE * CENSUS_MAX_PAGES) {
+        // Not counted.
+        return;
+    }
+
+    Class **volatile *slot = &census_classes[id / CENSUS_PAGE_SIZE];
+    Class **page = (Class**)Atomic_load_acquire_ptr((void*volatile*)slot);
+    if (page == NULL) {
+        Class **fresh = (Class**)Memory_tagged_calloc(MEMORY_CLASS,
+                                                      CENSUS_PAGE_SIZE,
+                                                      sizeof(Class*));
+        if (Atomic_cas_ptr((void*volatile*)slot, NULL, fresh)) {
+            page = fresh;
+        }
+        else {
+            Memory_tagged_free(MEMORY_CLASS, fresh,
+                               CENSUS_PAGE_SIZE * sizeof(Class*));
+            page = (Class**)Atomic_load_acquire_ptr((void*volatile*)slot);
+        }
+    }
+    Atomic_store_release_ptr((void*volatile*)&page[id % CENSUS_PAGE_SIZE],
+                             klass);
+}
+
+// Take an immortal object out of the census, so that it doesn't show up in
+// the report.
+static void
+S_census_exclude(Obj *obj) {
+    if (Class_census_enabled && obj) {
+        Class_census_remove(obj);
+    }
+}
+
+static void
+S_report_census_at_exit(void) {
+    String *report = Class_census_report();
+    if (Str_Get_Size(report)) {
+        char *utf8 = Str_To_Utf8(report);
+        fprintf(stderr, "Live Clownfish objects at exit:\n%s", utf8);
+        FREEMEM(utf8);
+    }
+    DECREF(report);
+}
+
+static void
+S_init_census(void) {
+    const char *env = getenv("CLOWNFISH_OBJ_CENSUS");
+    if (env != NULL && env[0] != '\0' && env[0] != '0') {
+        Class_census_enabled = true;
+        atexit(S_report_census_at_exit);
+    }
+}
+
+void
+Class_enable_census(bool enable) {
+    // Objects are only subtracted from the census if they were added to it,
+    // so the census can't change once objects exist.
+    if (Class_registry != NULL) {
+        THROW(ERR, "The census must be enabled before bootstrapping");
+    }
+    Class_census_enabled = enable;
+}
+
+void
+Class_census_add(Obj *obj) {
+    Class *klass = obj->klass;
+    Memory_census_add(obj, klass->census_id, klass->obj_alloc_size);
+}
+
+void
+Class_census_remove(Obj *obj) {
+    Class *klass = obj->klass;
+    Memory_census_remove(obj, klass->census_id, klass->obj_alloc_size);
+}
+
+int64_t
+Class_Get_Live_Count_IMP(Class *self) {
+    int64_t count, bytes;
+    Memory_census_read(self->census_id, &count, &bytes);
+    return count;
+}
+
+int64_t
+Class_Get_Live_Bytes_IMP(Class *self) {
+    int64_t count, bytes;
+    Memory_census_read(self->census_id, &count, &bytes);
+    return bytes;
+}
+
+String*
+Class_census_report() {
+    CharBuf *buf = CB_new(0);
+    size_t num_classes = Atomic_load_acquire_size(&census_num_classes);
+    if (num_classes > CENSUS_PAGE_SIZE * CENSUS_MAX_PAGES) {
+        num_classes = CENSUS_PAGE_SIZE * CENSUS_MAX_PAGES;
+    }
+
+    // Keep the report's own buffer out of the report.
+    S_census_exclude((Obj*)buf);
+
+    for (size_t id = 0; id < num_classes; id++) {
+        Class **volatile *slot = &census_classes[id / CENSUS_PAGE_SIZE];
+        Class **page = (Class**)Atomic_load_acquire_ptr((void*volatile*)slot);
+        if (page == NULL) { continue; }
+        Class *klass = (Class*)Atomic_load_acquire_ptr(
+                           (void*volatile*)&page[id % CENSUS_PAGE_SIZE]);
+        if (klass == NULL) { continue; }
+
+        int64_t count, bytes;
+        Memory_census_read(klass->census_id, &count, &bytes);
+        if (count != 0) {
+            CB_catf(buf, "%o: %i64 objects, %i64 bytes\n", klass->name,
+                    count, bytes);
+        }
+    }
+
+    String *report = CB_Yield_String(buf);
+    if (Class_census_enabled) { Class_census_add((Obj*)buf); }
+    DECREF(buf);
+    return report;
+}
@@ -0,0 +1,324 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define C_CFISH_CONCURRENTHASH
+#define CFISH_USE_SHORT_NAMES
+
+#include "Clownfish/ConcurrentHash.h"
+#include "Clownfish/Class.h"
+#include "Clownfish/Err.h"
+#include "Clownfish/String.h"
+#include "Clownfish/VArray.h"
+#include "Clownfish/Util/Atomic.h"
+#include "Clownfish/Util/Memory.h"
+
+// A writer fills in an entry's value before publishing its key, so a reader
+// which finds the key also finds the value.  Deleting an entry clears its
+// value but keeps the key, so that probe sequences stay intact.
+typedef struct CHashEntry {
+    String *volatile key;
+    Obj    *volatile value;
+} CHashEntry;
+
+// Tables use linear probing and are never more than half full.  The entries
+// follow the header in the same allocation.
+typedef struct CHashTable {
+    struct CHashTable *next;      /* next retired table */
+    uint32_t           capacity;
+    uint32_t           used;      /* slots with a key, including deleted */
+} CHashTable;
+
+#define MIN_CAPACITY 16
+
+static CFISH_INLINE CHashEntry*
+SI_entries(CHashTable *table) {
+    return (CHashEntry*)(table + 1);
+}
+
+static CFISH_INLINE CHashTable*
+SI_current(ConcurrentHash *self) {
+    return (CHashTable*)Atomic_load_acquire_ptr((void*volatile*)&self->table);
+}
+
+static CFISH_INLINE size_t
+SI_table_size(uint32_t capacity) {
+    return sizeof(CHashTable) + capacity * sizeof(CHashEntry);
+}
+
+static CHashTable*
+S_new_table(ConcurrentHash *self, uint32_t capacity) {
+    CHashTable *table
+        = (CHashTable*)Memory_owned_calloc(self, MEMORY_HASH, 1,
+                                           SI_table_size(capacity));
+    table->next     = NULL;
+    table->capacity = capacity;
+    table->used     = 0;
+    return table;
+}
+
+static void
+S_free_table(ConcurrentHash *self, CHashTable *table) {
+    CHashEntry *entries = SI_entries(table);
+    for (uint32_t i = 0; i < table->capacity; i++) {
+        if (entries[i].key)   { DECREF(entries[i].key); }
+        if (entries[i].value) { DECREF(entries[i].value); }
+    }
+    Memory_owned_free(self, MEMORY_HASH, table,
+                      SI_table_size(table->capacity));
+}
+
+// Return a capacity which leaves plenty of room to grow beyond
+// `num_entries`.
+static uint32_t
+S_capacity_for(uint32_t num_entries) {
+    uint32_t capacity = MIN_CAPACITY;
+    while (capacity / 4 < num_entries) {
+        capacity *= 2;
+    }
+    return capacity;
+}
+
+// Return the slot holding `key`, or the empty slot where it belongs.
+static CFISH_INLINE CHashEntry*
+SI_probe(CHashTable *table, String *key, int32_t hash_sum) {
+    CHashEntry *const entries = SI_entries(table);
+    const size_t      mask    = table->capacity - 1;
+    for (size_t slot = (uint32_t)hash_sum & mask; ; slot = (slot + 1) & mask) {
+        String *entry_key = entries[slot].key;
+        if (!entry_key
+            || entry_key == key
+            || (Str_Hash_Sum(entry_key) == hash_sum
+                && Str_Equals(entry_key, (Obj*)key))
+           ) {
+            return entries + slot;
+        }
+    }
+}
+
+// Writers spin rather than block.  Updates are expected to be rare and
+// short.
+static void
+S_lock(ConcurrentHash *self) {
+    while (!Atomic_cas_ptr((void *volatile*)&self->lock, NULL, self)) {
+        // Spin.
+    }
+}
+
+static void
+S_unlock(ConcurrentHash *self) {
+    Atomic_cas_ptr((void *volatile*)&self->lock, self, NULL);
+}
+
+ConcurrentHash*
+CHash_new(uint32_t capacity) {
+    ConcurrentHash *self = (ConcurrentHash*)Class_Make_Obj(CONCURRENTHASH);
+    return CHash_init(self, capacity);
+}
+
+ConcurrentHash*
+CHash_init(ConcurrentHash *self, uint32_t capacity) {
+    uint32_t requested_capacity = capacity < INT32_MAX / 8
+                                  ? capacity : INT32_MAX / 8;
+    self->table          = S_new_table(self,
+                                       S_capacity_for(requested_capacity));
+    self->lock           = NULL;
+    self->retired        = NULL;
+    self->retired_values = VA_new(0);
+    self->size           = 0;
+    return self;
+}
+
+void
+CHash_Destroy_IMP(ConcurrentHash *self) {
+    if (self->table) {
+        CHash_Reclaim(self);
+        S_free_table(self, (CHashTable*)self->table);
+    }
+    DECREF(self->retired_values);
+    SUPER_DESTROY(self, CONCURRENTHASH);
+}
+
+// Copy the live entries into a bigger table and publish it.  The old table
+// is retired, since readers may still be probing it.  Must be called with
+// the lock held.
+static CHashTable*
+S_rebuild(ConcurrentHash *self, CHashTable *old_table) {
+    CHashTable *table       = S_new_table(self,
+                                          S_capacity_for(self->size + 1));
+    CHashEntry *old_entries = SI_entries(old_table);
+    for (uint32_t i = 0; i < old_table->capacity; i++) {
+        String *key   = old_entries[i].key;
+        Obj    *value = old_entries[i].value;
+        if (!key || !value) { continue; }
+        CHashEntry *entry = SI_probe(table, key, Str_Hash_Sum(key));
+        entry->key   = (String*)INCREF(key);
+        entry->value = INCREF(value);
+        table->used++;
+    }
+
+    Atomic_cas_ptr((void *volatile*)&self->table, old_table, table);
+    old_table->next = (CHashTable*)self->retired;
+    self->retired   = old_table;
+    return table;
+}
+
+static void
+S_do_store(ConcurrentHash *self, String *key, Obj *value) {
+    int32_t hash_sum = Str_Hash_Sum(key);
+
+    S_lock(self);
+    CHashTable *table = SI_current(self);
+    CHashEntry *entry = SI_probe(table, key, hash_sum);
+    if (entry->key) {
+        Obj *old_value = entry->value;
+        Atomic_cas_ptr((void *volatile*)&entry->value, old_value, value);
+        if (old_value) { VA_Push(self->retired_values, old_value); }
+        else           { self->size++; }
+        S_unlock(self);
+        return;
+    }
+
+    if (table->used + 1 > table->capacity / 2) {
+        if (self->size >= INT32_MAX / 8) {
+            S_unlock(self);
+            DECREF(value);
+            THROW(ERR, "ConcurrentHash too large");
+        }
+        table = S_rebuild(self, table);
+        entry = SI_probe(table, key, hash_sum);
+    }
+    // Cache the hash sum of the stored key before publishing it, so that
+    // readers comparing against it never write to it.  A key stored through
+    // Store_Utf8 is a fresh copy.
+    String *stored_key = (String*)INCREF(key);
+    Str_Hash_Sum(stored_key);
+    entry->value = value;
+    Atomic_cas_ptr((void *volatile*)&entry->key, NULL, stored_key);
+    table->used++;
+    self->size++;
+    S_unlock(self);
+}
+
+void
+CHash_Store_IMP(ConcurrentHash *self, String *key, Obj *value) {
+    S_do_store(self, key, value);
+}
+
+void
+CHash_Store_Utf8_IMP(ConcurrentHash *self, const char *key, size_t key_len,
+                     Obj *value) {
+    StackString *key_buf = SSTR_WRAP_UTF8(key, key_len);
+    S_do_store(self, (String*)key_buf, value);
+}
+
+// Readers must decide on the key they loaded: an empty slot may be claimed
+// for another key as soon as it has been seen.
+Obj*
+CHash_Fetch_IMP(ConcurrentHash *self, String *key) {
+    int32_t           hash_sum = Str_Hash_Sum(key);
+    CHashTable *const table    = SI_current(self);
+    CHashEntry *const entries  = SI_entries(table);
+    const size_t      mask     = table->capacity - 1;
+    for (size_t slot = (uint32_t)hash_sum & mask; ; slot = (slot + 1) & mask) {
+        String *entry_key = (String*)Atomic_load_acquire_ptr(
+                                (void*volatile*)&entries[slot].key);
+        if (!entry_key) {
+            return NULL;
+        }
+        else if (entry_key == key
+                 || (Str_Hash_Sum(entry_key) == hash_sum
+                     && Str_Equals(entry_key, (Obj*)key))
+                ) {
+            return (Obj*)Atomic_load_acquire_ptr(
+                       (void*volatile*)&entries[slot].value);
+        }
+    }
+}
+
+Obj*
+CHash_Fetch_Utf8_IMP(ConcurrentHash *self, const char *key, size_t key_len) {
+    StackString *key_buf = SSTR_WRAP_UTF8(key, key_len);
+    return CHash_Fetch_IMP(self, (String*)key_buf);
+}
+
+bool
+CHash_Delete_IMP(ConcurrentHash *self, String *key) {
+    int32_t hash_sum = Str_Hash_Sum(key);
+    bool    deleted  = false;
+
+    S_lock(self);
+    CHashEntry *entry = SI_probe(SI_current(self), key, hash_sum);
+    Obj        *value = entry->value;
+    if (entry->key && value) {
+        Atomic_cas_ptr((void *volatile*)&entry->value, value, NULL);
+        VA_Push(self->retired_values, value);
+        self->size--;
+        deleted = true;
+    }
+    S_unlock(self);
+
+    return deleted;
+}
+
+bool
+CHash_Delete_Utf8_IMP(ConcurrentHash *self, const char *key,
+                      size_t key_len) {
+    StackString *key_buf = SSTR_WRAP_UTF8(key, key_len);
+    return CHash_Delete_IMP(self, (String*)key_buf);
+}
+
+VArray*
+CHash_Keys_IMP(ConcurrentHash *self) {
+    S_lock(self);
+    CHashTable *table   = SI_current(self);
+    CHashEntry *entries = SI_entries(table);
+    VArray     *keys    = VA_new(self->size);
+    for (uint32_t i = 0; i < table->capacity; i++) {
+        if (entries[i].key && entries[i].value) {
+            VA_Push(keys, INCREF(entries[i].key));
+        }
+    }
+    S_unlock(self);
+    return keys;
+}
+
+uint32_t
+CHash_Reclaim_IMP(ConcurrentHash *self) {
+    S_lock(self);
+    uint32_t    count   = VA_Get_Size(self->retired_values);
+    CHashTable *retired = (CHashTable*)self->retired;
+    VA_Clear(self->retired_values);
+    while (retired) {
+        CHashTable *next = retired->next;
+        S_free_table(self, retired);
+        retired = next;
+        count++;
+    }
+    self->retired = NULL;
+    S_unlock(self);
+    return count;
+}
+
+uint32_t
+CHash_Get_Size_IMP(ConcurrentHash *self) {
+    return self->size;
+}
+
+uint32_t
+CHash_Get_Capacity_IMP(ConcurrentHash *self) {
+    return SI_current(self)->capacity;
+}
+
@@ -14,6 +14,7 @@
  * limitations under the License.
  */
 
+
 #define C_CFISH_HASH
 #define CFISH_USE_SHORT_NAMES
 
@@ -25,32 +26,91 @@
 #include "Clownfish/Hash.h"
 #include "Clownfish/String.h"
 #include "Clownfish/Err.h"
+#include "Clownfish/Num.h"
 #include "Clownfish/VArray.h"
+#include "Clownfish/Util/HashEntry.h"
+#include "Clownfish/Util/HashGroup.h"
 #include "Clownfish/Util/Memory.h"
 
-// TOMBSTONE is shared across threads, so it must never be incref'd or
-// decref'd.
-static String *TOMBSTONE;
-
-#define HashEntry cfish_HashEntry
-
-typedef struct HashEntry {
-    String  *key;
-    Obj     *value;
-    int32_t  hash_sum;
-} HashEntry;
+// Number of old slots migrated by each insertion during an incremental
+// rehash.  The new table has room for at least 7/8 of the old capacity in
+// insertions before it fills, so any step above 8/7 slots guarantees that a
+// migration completes before the next one must begin.
+#define REHASH_STEP (2 * HASHGROUP_WIDTH)
+
+// Number of keys in flight at once in Fetch_Many.
+#define FETCH_MANY_BATCH 16
+
+// Compiling with CFISH_HASH_STATS makes every Hash count what it does, for
+// Get_Stats to report.  Otherwise, the counting compiles to nothing.
+#ifdef CFISH_HASH_STATS
+typedef struct HashCounters {
+    uint64_t lookups;
+    uint64_t groups_probed;
+    uint64_t key_compares;
+    uint64_t resizes;
+    uint64_t tombstone_cleanups;
+} HashCounters;
+  #define HASH_COUNT(self, counter, amount) \
+    (((HashCounters*)(self)->stats)->counter += (amount))
+#else
+  #define HASH_COUNT(self, counter, amount) ((void)(self))
+#endif
+
+// Return the entry associated with the key within a single table, if any.
+static CFISH_INLINE HashEntry*
+SI_probe(Hash *self, HashEntry *entries, const uint8_t *ctrl,
+         uint32_t capacity, String *key, int32_t hash_sum);
 
 // Return the entry associated with the key, if any.
 static CFISH_INLINE HashEntry*
 SI_fetch_entry(Hash *self, String *key, int32_t hash_sum);
 
-// Double the number of buckets and redistribute all entries.
-static CFISH_INLINE HashEntry*
-SI_rebuild_hash(Hash *self);
+// Make room for an insertion.  If tombstones account for much of the
+// table, clear them out -- shrinking the table if it is mostly empty.
+// Otherwise, double the number of buckets.
+static void
+S_grow(Hash *self);
 
-void
-Hash_init_class() {
-    TOMBSTONE = Str_newf("[HASHTOMBSTONE]");
+// Move all entries into a new table with `capacity` slots.  Entries are
+// redistributed immediately unless `incremental` is true.
+static void
+S_resize(Hash *self, uint32_t capacity, bool incremental);
+
+// Rehash the current table in place, turning all tombstones into EMPTY
+// slots.
+static void
+S_drop_tombstones(Hash *self);
+
+// Move up to `num_slots` slots of the old table into the current one.
+static void
+S_migrate(Hash *self, uint32_t num_slots);
+
+// Allocate entries and control bytes for `capacity` slots in a single block
+// and mark all slots EMPTY.
+static void
+S_alloc_table(Hash *self, uint32_t capacity) {
+    self->entries   = HashGroup_alloc_table(self, capacity, sizeof(HashEntry));
+    self->ctrl      = HashGroup_ctrl(self->entries, capacity,
+                                     sizeof(HashEntry));
+    self->capacity  = capacity;
+    self->threshold = HashGroup_threshold(capacity);
+}
+
+// Access the current table (0) or the table being drained (1).  Return the
+// table's capacity, which is 0 if there is no such table.
+static CFISH_INLINE uint32_t
+SI_table(Hash *self, int which, HashEntry **entries, uint8_t **ctrl) {
+    if (which == 0) {
+        *entries = (HashEntry*)self->entries;
+        *ctrl    = self->ctrl;
+        return self->capacity;
+    }
+    else {
+        *entries = (HashEntry*)self->old_entries;
+        *ctrl    = self->old_ctrl;
+        return self->old_capacity;
+    }
 }
 
 Hash*
@@ -64,21 +124,25 @@ Hash_init(Hash *self, uint32_t capacity) {
     // Allocate enough space to hold the requested number of elements without
     // triggering a rebuild.
     uint32_t requested_capacity = capacity < INT32_MAX ? capacity : INT32_MAX;
-    uint32_t threshold;
-    capacity = 16;
-    while (1) {
-        threshold = (capacity / 3) * 2;
-        if (threshold > requested_capacity) { break; }
-        capacity *= 2;
-    }
+    capacity = HashGroup_capacity_for(requested_capacity);
 
     // Init.
     self->size         = 0;
+    self->old_entries  = NULL;
+    self->old_ctrl     = NULL;
+    self->old_capacity = 0;
+    self->rehash_tick  = 0;
+    self->generation   = 0;
+    self->incremental  = false;
+#ifdef CFISH_HASH_STATS
+    self->stats        = Memory_owned_calloc(self, MEMORY_HASH, 1,
+                                             sizeof(HashCounters));
+#else
+    self->stats        = NULL;
+#endif
 
     // Derive.
-    self->capacity     = capacity;
-    self->entries      = (HashEntry*)CALLOCATE(capacity, sizeof(HashEntry));
-    self->threshold    = threshold;
+    S_alloc_table(self, capacity);
 
     return self;
 }
@@ -87,69 +151,153 @@ void
 Hash_Destroy_IMP(Hash *self) {
     if (self->entries) {
         Hash_Clear(self);
-        FREEMEM(self->entries);
+        HashGroup_free_table(self, self->entries, self->capacity,
+                             sizeof(HashEntry));
     }
+#ifdef CFISH_HASH_STATS
+    Memory_owned_free(self, MEMORY_HASH, self->stats, sizeof(HashCounters));
+#endif
     SUPER_DESTROY(self, HASH);
 }
 
 void
 Hash_Clear_IMP(Hash *self) {
-    HashEntry *entry       = (HashEntry*)self->entries;
-    HashEntry *const limit = entry + self->capacity;
-
-    // Iterate through all entries.
-    for (; entry < limit; entry++) {
-        if (!entry->key) { continue; }
-        if (entry->key == TOMBSTONE) {
-            entry->key = NULL;
-            continue;
+    // Iterate through all entries of both tables.
+    for (int which = 0; which < 2; which++) {
+        HashEntry *entries;
+        uint8_t   *ctrl;
+        uint32_t   capacity = SI_table(self, which, &entries, &ctrl);
+        for (uint32_t i = 0; i < capacity; i++) {
+            if (!HashCtrl_is_full(ctrl[i])) { continue; }
+            DECREF(entries[i].key);
+            DECREF(entries[i].value);
+            entries[i].key   = NULL;
+            entries[i].value = NULL;
         }
-        DECREF(entry->key);
-        DECREF(entry->value);
-        entry->key       = NULL;
-        entry->value     = NULL;
-        entry->hash_sum  = 0;
+    }
+    memset(self->ctrl, HASHCTRL_EMPTY, self->capacity);
+
+    // Abandon any migration in progress.
+    if (self->old_entries) {
+        HashGroup_free_table(self, self->old_entries, self->old_capacity,
+                             sizeof(HashEntry));
+        self->old_entries  = NULL;
+        self->old_ctrl     = NULL;
+        self->old_capacity = 0;
+        self->rehash_tick  = 0;
     }
 
     self->size = 0;
     // All tombstones were removed, reset threshold.
-    self->threshold = (self->capacity / 3) * 2;
+    self->threshold = HashGroup_threshold(self->capacity);
+}
+
+// Fill the free slot at `tick` of the current table.  The caller is
+// responsible for updating `size`.
+static CFISH_INLINE void
+SI_place(Hash *self, size_t tick, String *key, Obj *value, int32_t hash_sum) {
+    if (self->ctrl[tick] == HASHCTRL_DELETED) {
+        // Take note of diminished tombstone clutter.
+        self->threshold++;
+    }
+    HashEntry *entry = (HashEntry*)self->entries + tick;
+    entry->key       = key;
+    entry->value     = value;
+    self->ctrl[tick] = HashGroup_h2(hash_sum);
+}
+
+// Place a key known to be absent into the first free slot of its probe
+// sequence in the current table.  The caller is responsible for ensuring
+// there is room and for updating `size`.
+static CFISH_INLINE void
+SI_insert(Hash *self, String *key, Obj *value, int32_t hash_sum) {
+    size_t tick = HashGroup_find_free(self->ctrl, self->capacity, hash_sum);
+    SI_place(self, tick, key, value, hash_sum);
+}
+
+// Probe the current table for `key`.  If it is absent, set `free_tick` to
+// the first tombstone or EMPTY slot passed along the way -- the slot which
+// HashGroup_find_free() would pick -- so that an insertion needn't probe
+// again.
+static CFISH_INLINE HashEntry*
+SI_probe_for_store(Hash *self, String *key, int32_t hash_sum,
+                   size_t *free_tick) {
+    HashEntry *const entries = (HashEntry*)self->entries;
+    const uint8_t *const ctrl = self->ctrl;
+    const uint8_t h2 = HashGroup_h2(hash_sum);
+    size_t free_slot = SIZE_MAX;
+    HashProbe probe;
+
+    HASH_COUNT(self, lookups, 1);
+    HashProbe_init(&probe, hash_sum, self->capacity);
+    while (1) {
+        size_t   offset  = HashProbe_offset(&probe);
+        uint32_t matches = HashGroup_match(ctrl + offset, h2);
+        HASH_COUNT(self, groups_probed, 1);
+        while (matches) {
+            HashEntry *entry = entries + offset + HashGroup_lowest(matches);
+            HASH_COUNT(self, key_compares, 1);
+            if (Str_Equals(key, (Obj*)entry->key)) {
+                return entry;
+            }
+            matches &= matches - 1;
+        }
+        if (free_slot == SIZE_MAX) {
+            uint32_t available = HashGroup_match_free(ctrl + offset);
+            if (available) {
+                free_slot = offset + HashGroup_lowest(available);
+            }
+        }
+        if (HashGroup_match_empty(ctrl + offset)) {
+            *free_tick = free_slot;
+            return NULL;
+        }
+        HashProbe_next(&probe);
+    }
+}
+
+// Return the entry associated with the key, if any.  Otherwise, set
+// `free_tick` to the slot where it belongs.
+static CFISH_INLINE HashEntry*
+SI_find_for_store(Hash *self, String *key, int32_t hash_sum,
+                  size_t *free_tick) {
+    HashEntry *entry = SI_probe_for_store(self, key, hash_sum, free_tick);
+    if (!entry && self->old_capacity) {
+        entry = SI_probe(self, (HashEntry*)self->old_entries,
+                         self->old_ctrl, self->old_capacity, key, hash_sum);
+    }
+    return entry;
+}
+
+// Insert an absent key at the slot found by SI_find_for_store().
+static void
+S_insert_at(Hash *self, size_t tick, String *key, Obj *value,
+            int32_t hash_sum) {
+    if (self->size >= self->threshold) {
+        S_grow(self);
+        tick = HashGroup_find_free(self->ctrl, self->capacity, hash_sum);
+    }
+    SI_place(self, tick, key, value, hash_sum);
+    self->size++;
+
+    if (self->old_capacity) {
+        S_migrate(self, REHASH_STEP);
+    }
 }
 
 static void
 S_do_store(Hash *self, String *key, Obj *value, int32_t hash_sum,
            bool incref_key) {
-    HashEntry *entry = SI_fetch_entry(self, key, hash_sum);
+    size_t     tick;
+    HashEntry *entry = SI_find_for_store(self, key, hash_sum, &tick);
     if (entry) {
         DECREF(entry->value);
         entry->value = value;
         return;
     }
 
-    HashEntry *entries = self->size >= self->threshold
-                         ? SI_rebuild_hash(self)
-                         : (HashEntry*)self->entries;
-    uint32_t       tick = hash_sum;
-    const uint32_t mask = self->capacity - 1;
-
-    while (1) {
-        tick &= mask;
-        HashEntry *entry = entries + tick;
-        if (entry->key == TOMBSTONE || !entry->key) {
-            if (entry->key == TOMBSTONE) {
-                // Take note of diminished tombstone clutter.
-                self->threshold++;
-            }
-            entry->key       = incref_key
-                               ? (String*)INCREF(key)
-                               : key;
-            entry->value     = value;
-            entry->hash_sum  = hash_sum;
-            self->size++;
-            break;
-        }
-        tick++; // linear scan
-    }
+    S_insert_at(self, tick, incref_key ? (String*)INCREF(key) : key, value,
+                hash_sum);
 }
 
 void
@@ -170,45 +318,189 @@ Hash_Fetch_Utf8_IMP(Hash *self, const char *key, size_t key_len) {
 }
 
 static CFISH_INLINE HashEntry*
-SI_fetch_entry(Hash *self, String *key, int32_t hash_sum) {
-    uint32_t tick = hash_sum;
-    HashEntry *const entries = (HashEntry*)self->entries;
-    HashEntry *entry;
+SI_probe(Hash *self, HashEntry *entries, const uint8_t *ctrl,
+         uint32_t capacity, String *key, int32_t hash_sum) {
+    const uint8_t h2 = HashGroup_h2(hash_sum);
+    HashProbe probe;
 
+    HASH_COUNT(self, lookups, 1);
+    HashProbe_init(&probe, hash_sum, capacity);
     while (1) {
-        tick &= self->capacity - 1;
-        entry = entries + tick;
-        if (!entry->key) {
+        size_t   offset  = HashProbe_offset(&probe);
+        uint32_t matches = HashGroup_match(ctrl + offset, h2);
+        HASH_COUNT(self, groups_probed, 1);
+        while (matches) {
+            HashEntry *entry = entries + offset + HashGroup_lowest(matches);
+            HASH_COUNT(self, key_compares, 1);
+            if (Str_Equals(key, (Obj*)entry->key)) {
+                return entry;
+            }
+            matches &= matches - 1;
+        }
+        if (HashGroup_match_empty(ctrl + offset)) {
             // Failed to find the key, so return NULL.
             return NULL;
         }
-        else if (entry->hash_sum == hash_sum
-                 && entry->key != TOMBSTONE
-                 && Str_Equals(key, (Obj*)entry->key)
-                ) {
-            return entry;
-        }
-        tick++;
+        HashProbe_next(&probe);
     }
 }
 
+static CFISH_INLINE HashEntry*
+SI_fetch_entry(Hash *self, String *key, int32_t hash_sum) {
+    HashEntry *entry = SI_probe(self, (HashEntry*)self->entries, self->ctrl,
+                                self->capacity, key, hash_sum);
+    if (!entry && self->old_capacity) {
+        // Not yet migrated?
+        entry = SI_probe(self, (HashEntry*)self->old_entries,
+                         self->old_ctrl, self->old_capacity, key, hash_sum);
+    }
+    return entry;
+}
+
 Obj*
 Hash_Fetch_IMP(Hash *self, String *key) {
     HashEntry *entry = SI_fetch_entry(self, key, Str_Hash_Sum(key));
     return entry ? entry->value : NULL;
 }
 
+void
+Hash_Fetch_Many_IMP(Hash *self, String **keys, Obj **values,
+                    size_t num_keys) {
+    HashEntry *const entries = (HashEntry*)self->entries;
+    const uint8_t *const ctrl = self->ctrl;
+    int32_t    hash_sums[FETCH_MANY_BATCH];
+    HashEntry *candidates[FETCH_MANY_BATCH];
+
+    for (size_t base = 0; base < num_keys; base += FETCH_MANY_BATCH) {
+        size_t batch_size = num_keys - base < FETCH_MANY_BATCH
+                            ? num_keys - base
+                            : FETCH_MANY_BATCH;
+        String **batch = keys + base;
+
+        // Hash every key and prefetch the control bytes of its first group.
+        for (size_t i = 0; i < batch_size; i++) {
+            HashProbe probe;
+            hash_sums[i] = Str_Hash_Sum(batch[i]);
+            HashProbe_init(&probe, hash_sums[i], self->capacity);
+            HashGroup_prefetch(ctrl + HashProbe_offset(&probe));
+        }
+
+        // Prefetch the first entry whose control byte matches.
+        for (size_t i = 0; i < batch_size; i++) {
+            HashProbe probe;
+            HashProbe_init(&probe, hash_sums[i], self->capacity);
+            size_t   offset  = HashProbe_offset(&probe);
+            uint32_t matches = HashGroup_match(ctrl + offset,
+                                               HashGroup_h2(hash_sums[i]));
+            candidates[i] = matches
+                            ? entries + offset + HashGroup_lowest(matches)
+                            : NULL;
+            if (candidates[i]) { HashGroup_prefetch(candidates[i]); }
+        }
+
+        // Prefetch the candidates' keys, which Str_Equals will inspect.
+        for (size_t i = 0; i < batch_size; i++) {
+            if (candidates[i]) { HashGroup_prefetch(candidates[i]->key); }
+        }
+
+        // Resolve the probes, which should now mostly hit the cache.
+        for (size_t i = 0; i < batch_size; i++) {
+            HashEntry *entry = SI_fetch_entry(self, batch[i], hash_sums[i]);
+            values[base + i] = entry ? entry->value : NULL;
+        }
+    }
+}
+
+Obj*
+Hash_Fetch_Or_Store_IMP(Hash *self, String *key, Obj *value) {
+    int32_t    hash_sum = Str_Hash_Sum(key);
+    size_t     tick;
+    HashEntry *entry    = SI_find_for_store(self, key, hash_sum, &tick);
+    if (entry) {
+        DECREF(value);
+        return entry->value;
+    }
+
+    S_insert_at(self, tick, (String*)INCREF(key), value, hash_sum);
+    return value;
+}
+
+Obj*
+Hash_Update_IMP(Hash *self, String *key, Hash_Updater_t update,
+                void *context) {
+    int32_t    hash_sum = Str_Hash_Sum(key);
+    size_t     tick;
+    HashEntry *entry    = SI_find_for_store(self, key, hash_sum, &tick);
+    if (entry) {
+        Obj *new_value = update(context, entry->key, entry->value);
+        if (!new_value) {
+            DECREF(Hash_Delete(self, key));
+            return NULL;
+        }
+        Obj *old_value = entry->value;
+        entry->value = new_value;
+        DECREF(old_value);
+        return new_value;
+    }
+
+    Obj *new_value = update(context, key, NULL);
+    if (new_value) {
+        S_insert_at(self, tick, (String*)INCREF(key), new_value, hash_sum);
+    }
+    return new_value;
+}
+
+void
+Hash_Each_IMP(Hash *self, Hash_Visitor_t visit, void *context) {
+    uint32_t capacity   = self->capacity + self->old_capacity;
+    uint32_t generation = self->generation;
+
+    for (int which = 0; which < 2; which++) {
+        HashEntry *entries;
+        uint8_t   *ctrl;
+        uint32_t   table_cap = SI_table(self, which, &entries, &ctrl);
+        for (uint32_t i = 0; i < table_cap; i++) {
+            if (!HashCtrl_is_full(ctrl[i])) { continue; }
+            if (!visit(context, entries[i].key, entries[i].value)) { return; }
+            // Deleting entries leaves the tables in place, but anything
+            // that moves entries around invalidates the walk.
+            if (self->capacity + self->old_capacity != capacity
+                || self->generation != generation
+               ) {
+                THROW(ERR, "Hash modified during iteration.");
+            }
+        }
+    }
+}
+
 Obj*
 Hash_Delete_IMP(Hash *self, String *key) {
-    HashEntry *entry = SI_fetch_entry(self, key, Str_Hash_Sum(key));
+    int32_t    hash_sum = Str_Hash_Sum(key);
+    HashEntry *entries  = (HashEntry*)self->entries;
+    HashEntry *entry    = SI_probe(self, entries, self->ctrl, self->capacity,
+                                   key, hash_sum);
+    if (entry) {
+        if (HashGroup_vacate(self->ctrl, entry - entries)) {
+            self->threshold--; // limit number of tombstones
+        }
+    }
+    else if (self->old_capacity) {
+        // The old table never receives insertions, so its tombstones don't
+        // need to be accounted for.
+        entries = (HashEntry*)self->old_entries;
+        entry   = SI_probe(self, entries, self->old_ctrl, self->old_capacity,
+                           key, hash_sum);
+        if (entry) {
+            HashGroup_vacate(self->old_ctrl, entry - entries);
+        }
+    }
+
     if (entry) {
         Obj *value = entry->value;
         DECREF(entry->key);
-        entry->key       = TOMBSTONE;
-        entry->value     = NULL;
-        entry->hash_sum  = 0;
+        entry->key   = NULL;
+        entry->value = NULL;
         self->size--;
-        self->threshold--; // limit number of tombstones
         return value;
     }
     else {
@@ -230,13 +522,16 @@ Hash_Find_Key_IMP(Hash *self, String *key, int32_t hash_sum) {
 
 VArray*
 Hash_Keys_IMP(Hash *self) {
-    VArray    *keys        = VA_new(self->size);
-    HashEntry *entry       = (HashEntry*)self->entries;
-    HashEntry *const limit = entry + self->capacity;
-
-    for (; entry < limit; entry++) {
-        if (entry->key && entry->key != TOMBSTONE) {
-            VA_Push(keys, INCREF(entry->key));
+    VArray *keys = VA_new(self->size);
+
+    for (int which = 0; which < 2; which++) {
+        HashEntry *entries;
+        uint8_t   *ctrl;
+        uint32_t   capacity = SI_table(self, which, &entries, &ctrl);
+        for (uint32_t i = 0; i < capacity; i++) {
+            if (HashCtrl_is_full(ctrl[i])) {
+                VA_Push(keys, INCREF(entries[i].key));
+            }
         }
     }
 
@@ -245,13 +540,16 @@ Hash_Keys_IMP(Hash *self) {
 
 VArray*
 Hash_Values_IMP(Hash *self) {
-    VArray    *values      = VA_new(self->size);
-    HashEntry *entry       = (HashEntry*)self->entries;
-    HashEntry *const limit = entry + self->capacity;
-
-    for (; entry < limit; entry++) {
-        if (entry->key && entry->key != TOMBSTONE) {
-            VA_Push(values, INCREF(entry->value));
+    VArray *values = VA_new(self->size);
+
+    for (int which = 0; which < 2; which++) {
+        HashEntry *entries;
+        uint8_t   *ctrl;
+        uint32_t   capacity = SI_table(self, which, &entries, &ctrl);
+        for (uint32_t i = 0; i < capacity; i++) {
+            if (HashCtrl_is_full(ctrl[i])) {
+                VA_Push(values, INCREF(entries[i].value));
+            }
         }
     }
 
@@ -266,13 +564,14 @@ Hash_Equals_IMP(Hash *self, Obj *other) {
     if (!Obj_Is_A(other, HASH))   { return false; }
     if (self->size != twin->size) { return false; }
 
-    HashEntry *entry       = (HashEntry*)self->entries;
-    HashEntry *const limit = entry + self->capacity;
-
-    for (; entry < limit; entry++) {
-        if (entry->key && entry->key != TOMBSTONE) {
-            Obj *other_val = Hash_Fetch(twin, entry->key);
-            if (!other_val || !Obj_Equals(other_val, entry->value)) {
+    for (int which = 0; which < 2; which++) {
+        HashEntry *entries;
+        uint8_t   *ctrl;
+        uint32_t   capacity = SI_table(self, which, &entries, &ctrl);
+        for (uint32_t i = 0; i < capacity; i++) {
+            if (!HashCtrl_is_full(ctrl[i])) { continue; }
+            Obj *other_val = Hash_Fetch(twin, entries[i].key);
+            if (!other_val || !Obj_Equals(other_val, entries[i].value)) {
                 return false;
             }
         }
@@ -286,41 +585,225 @@ Hash_Get_Capacity_IMP(Hash *self) {
     return self->capacity;
 }
 
+static void
+S_store_i64(Hash *stats, const char *name, int64_t value) {
+    Hash_Store_Utf8(stats, name, strlen(name), (Obj*)Int64_new(value));
+}
+
+static void
+S_store_f64(Hash *stats, const char *name, double value) {
+    Hash_Store_Utf8(stats, name, strlen(name), (Obj*)Float64_new(value));
+}
+
+Hash*
+Hash_Get_Stats_IMP(Hash *self) {
+    HashEntry *const entries  = (HashEntry*)self->entries;
+    uint8_t   *const ctrl     = self->ctrl;
+    const uint32_t   capacity = self->capacity;
+    Hash    *stats      = Hash_new(0);
+    VArray  *lengths    = VA_new(0);
+    uint32_t tombstones = 0;
+    uint32_t num_live   = 0;
+    uint64_t total      = 0;
+    uint32_t max_length = 0;
+
+    // Replay the probe sequence of every entry to find the group it ended
+    // up in.
+    for (uint32_t i = 0; i < capacity; i++) {
+        if (ctrl[i] == HASHCTRL_DELETED) { tombstones++; }
+        if (!HashCtrl_is_full(ctrl[i])) { continue; }
+
+        HashProbe probe;
+        uint32_t  length = 1;
+        HashProbe_init(&probe, Str_Hash_Sum(entries[i].key), capacity);
+        while (HashProbe_offset(&probe) != (i & ~(HASHGROUP_WIDTH - 1))) {
+            HashProbe_next(&probe);
+            length++;
+        }
+
+        while (VA_Get_Size(lengths) < length) {
+            VA_Push(lengths, (Obj*)Int64_new(0));
+        }
+        Integer64 *count = (Integer64*)VA_Fetch(lengths, length - 1);
+        Int64_Set_Value(count, Int64_Get_Value(count) + 1);
+        if (length > max_length) { max_length = length; }
+        total += length;
+        num_live++;
+    }
+
+    S_store_i64(stats, "size", self->size);
+    S_store_i64(stats, "capacity", capacity);
+    S_store_i64(stats, "old_capacity", self->old_capacity);
+    S_store_i64(stats, "tombstones", tombstones);
+    S_store_f64(stats, "load_factor", (double)num_live / capacity);
+    S_store_f64(stats, "effective_load",
+                (double)(num_live + tombstones) / capacity);
+    S_store_i64(stats, "max_probe_length", max_length);
+    S_store_f64(stats, "mean_probe_length",
+                num_live ? (double)total / num_live : 0.0);
+    Hash_Store_Utf8(stats, "probe_lengths", 13, (Obj*)lengths);
+
+#ifdef CFISH_HASH_STATS
+    HashCounters *counters = (HashCounters*)self->stats;
+    S_store_i64(stats, "lookups", (int64_t)counters->lookups);
+    S_store_i64(stats, "groups_probed", (int64_t)counters->groups_probed);
+    S_store_i64(stats, "key_compares", (int64_t)counters->key_compares);
+    S_store_i64(stats, "resizes", (int64_t)counters->resizes);
+    S_store_i64(stats, "tombstone_cleanups",
+                (int64_t)counters->tombstone_cleanups);
+#endif
+
+    return stats;
+}
+
 uint32_t
 Hash_Get_Size_IMP(Hash *self) {
     return self->size;
 }
 
-static CFISH_INLINE HashEntry*
-SI_rebuild_hash(Hash *self) {
+void
+Hash_Set_Incremental_Rehash_IMP(Hash *self, bool incremental) {
+    self->incremental = incremental;
+    if (!incremental && self->old_capacity) {
+        S_migrate(self, self->old_capacity);
+    }
+}
+
+void
+Hash_Compact_IMP(Hash *self) {
+    if (self->old_capacity) {
+        S_migrate(self, self->old_capacity);
+    }
+
+    uint32_t capacity = HashGroup_capacity_for(self->size);
+    if (capacity < self->capacity) {
+        S_resize(self, capacity, false);
+    }
+    else if (self->threshold < HashGroup_threshold(self->capacity)) {
+        S_drop_tombstones(self);
+    }
+}
+
+static void
+S_grow(Hash *self) {
+    // Only one migration at a time.
+    if (self->old_capacity) {
+        S_migrate(self, self->old_capacity);
+    }
+
+    // When at least half of the usable slots hold tombstones, doubling would
+    // only spread the clutter out, so reclaim the tombstones instead.
+    // Leave room for the hash to double in size again.
+    if (self->size <= HashGroup_threshold(self->capacity) / 2) {
+        uint32_t capacity = HashGroup_capacity_for(self->size * 2);
+        if (capacity < self->capacity) {
+            S_resize(self, capacity, false);
+        }
+        else {
+            S_drop_tombstones(self);
+        }
+        return;
+    }
+
     // HashIterator ticks are int32_t.
     if (self->capacity > INT32_MAX / 2) {
         THROW(ERR, "Hash grew too large");
     }
 
-    HashEntry *old_entries = (HashEntry*)self->entries;
-    HashEntry *entry       = old_entries;
-    HashEntry *limit       = old_entries + self->capacity;
+    S_resize(self, self->capacity * 2, self->incremental);
+}
 
-    self->capacity *= 2;
-    self->threshold = (self->capacity / 3) * 2;
-    self->entries   = (HashEntry*)CALLOCATE(self->capacity, sizeof(HashEntry));
-    self->size      = 0;
+static void
+S_resize(Hash *self, uint32_t capacity, bool incremental) {
+    HASH_COUNT(self, resizes, 1);
+    self->old_entries  = self->entries;
+    self->old_ctrl     = self->ctrl;
+    self->old_capacity = self->capacity;
+    self->rehash_tick  = 0;
+    S_alloc_table(self, capacity);
+
+    if (!incremental) {
+        S_migrate(self, self->old_capacity);
+    }
+}
 
-    for (; entry < limit; entry++) {
-        if (!entry->key || entry->key == TOMBSTONE) {
-            continue;
-        }
-        S_do_store(self, entry->key, entry->value, entry->hash_sum, false);
+static void
+S_drop_tombstones(Hash *self) {
+    HashEntry *const entries  = (HashEntry*)self->entries;
+    uint8_t   *const ctrl     = self->ctrl;
+    const uint32_t   capacity = self->capacity;
+
+    HASH_COUNT(self, tombstone_cleanups, 1);
+
+    // Free all tombstones, and mark every live entry DELETED, which here
+    // means "awaiting placement".
+    for (uint32_t i = 0; i < capacity; i++) {
+        ctrl[i] = HashCtrl_is_full(ctrl[i])
+                  ? HASHCTRL_DELETED
+                  : HASHCTRL_EMPTY;
     }
 
-    FREEMEM(old_entries);
+    for (uint32_t i = 0; i < capacity; i++) {
+        if (ctrl[i] != HASHCTRL_DELETED) { continue; }
 
-    return (HashEntry*)self->entries;
+        int32_t hash_sum = Str_Hash_Sum(entries[i].key);
+        size_t  target   = HashGroup_find_free(ctrl, capacity, hash_sum);
+
+        if ((target >> HASHGROUP_SHIFT) == (i >> HASHGROUP_SHIFT)) {
+            // The entry is already in the first group with room for it.
+            ctrl[i] = HashGroup_h2(hash_sum);
+        }
+        else if (ctrl[target] == HASHCTRL_EMPTY) {
+            entries[target] = entries[i];
+            ctrl[target]    = HashGroup_h2(hash_sum);
+            ctrl[i]         = HASHCTRL_EMPTY;
+        }
+        else {
+            // The target holds another entry awaiting placement.  Swap and
+            // place the displaced entry next.
+            HashEntry temp  = entries[target];
+            entries[target] = entries[i];
+            entries[i]      = temp;
+            ctrl[target]    = HashGroup_h2(hash_sum);
+            i--;
+        }
+    }
+
+    self->threshold = HashGroup_threshold(capacity);
+    self->generation++;
 }
 
-String*
-Hash_get_tombstone() {
-    return TOMBSTONE;
+static void
+S_migrate(Hash *self, uint32_t num_slots) {
+    HashEntry *const old_entries = (HashEntry*)self->old_entries;
+    uint8_t   *const old_ctrl    = self->old_ctrl;
+    uint32_t         limit       = self->old_capacity;
+
+    if (limit - self->rehash_tick > num_slots) {
+        limit = self->rehash_tick + num_slots;
+    }
+
+    for (uint32_t i = self->rehash_tick; i < limit; i++) {
+        if (!HashCtrl_is_full(old_ctrl[i])) {
+            continue;
+        }
+        String *key = old_entries[i].key;
+        SI_insert(self, key, old_entries[i].value, Str_Hash_Sum(key));
+        // Keep probes for other keys in the old table going.
+        old_ctrl[i] = HASHCTRL_DELETED;
+    }
+
+    self->generation++;
+    if (limit == self->old_capacity) {
+        HashGroup_free_table(self, self->old_entries, self->old_capacity,
+                             sizeof(HashEntry));
+        self->old_entries  = NULL;
+        self->old_ctrl     = NULL;
+        self->old_capacity = 0;
+        self->rehash_tick  = 0;
+    }
+    else {
+        self->rehash_tick = limit;
+    }
 }
 
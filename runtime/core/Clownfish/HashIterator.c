@@ -16,6 +16,7 @@
 
 #define C_CFISH_HASH
 #define C_CFISH_HASHITERATOR
+#define C_CFISH_STACKHASHITERATOR
 #define CFISH_USE_SHORT_NAMES
 
 #include "Clownfish/Class.h"
@@ -24,21 +25,36 @@
 
 #include "Clownfish/Hash.h"
 #include "Clownfish/HashIterator.h"
+#include "Clownfish/Util/HashEntry.h"
+#include "Clownfish/Util/HashGroup.h"
+
+// Ticks run through the slots of the Hash's current table, followed by those
+// of the table being drained by an incremental rehash.  Any resize,
+// migration step, or tombstone cleanup moves entries around, so it counts as
+// a modification.
+static CFISH_INLINE bool
+SI_modified(HashIterator *self) {
+    Hash *hash = self->hash;
+    return self->capacity != hash->capacity + hash->old_capacity
+           || self->generation != hash->generation;
+}
 
-static String *TOMBSTONE;
-
-typedef struct HashEntry {
-    String  *key;
-    Obj     *value;
-    int32_t  hash_sum;
-} HashEntry;
+static CFISH_INLINE uint8_t
+SI_ctrl(HashIterator *self) {
+    Hash *hash = self->hash;
+    uint32_t tick = (uint32_t)self->tick;
+    return tick < hash->capacity
+           ? hash->ctrl[tick]
+           : hash->old_ctrl[tick - hash->capacity];
+}
 
-void
-HashIter_init_class() {
-    TOMBSTONE = Hash_get_tombstone();
-    if (!TOMBSTONE) {
-        THROW(ERR, "Singleton tombstone not set in Hash.");
-    }
+static CFISH_INLINE HashEntry*
+SI_entry(HashIterator *self) {
+    Hash *hash = self->hash;
+    uint32_t tick = (uint32_t)self->tick;
+    return tick < hash->capacity
+           ? (HashEntry*)hash->entries + tick
+           : (HashEntry*)hash->old_entries + (tick - hash->capacity);
 }
 
 HashIterator*
@@ -49,15 +65,16 @@ HashIter_new(Hash *hash) {
 
 HashIterator*
 HashIter_init(HashIterator *self, Hash *hash) {
-    self->hash     = (Hash*)INCREF(hash);
-    self->tick     = -1;
-    self->capacity = hash->capacity;
+    self->hash       = (Hash*)INCREF(hash);
+    self->tick       = -1;
+    self->capacity   = hash->capacity + hash->old_capacity;
+    self->generation = hash->generation;
     return self;
 }
 
 bool
 HashIter_Next_IMP(HashIterator *self) {
-    if (self->capacity != self->hash->capacity) {
+    if (SI_modified(self)) {
         THROW(ERR, "Hash modified during iteration.");
     }
     while (1) {
@@ -66,20 +83,16 @@ HashIter_Next_IMP(HashIterator *self) {
             self->tick = self->capacity;
             return false;
         }
-        else {
-            HashEntry *const entry
-                = (HashEntry*)self->hash->entries + self->tick;
-            if (entry->key && entry->key != TOMBSTONE) {
-                // Success.
-                return true;
-            }
+        else if (HashCtrl_is_full(SI_ctrl(self))) {
+            // Success.
+            return true;
         }
     }
 }
 
 String*
 HashIter_Get_Key_IMP(HashIterator *self) {
-    if (self->capacity != self->hash->capacity) {
+    if (SI_modified(self)) {
         THROW(ERR, "Hash modified during iteration.");
     }
     if (self->tick >= (int32_t)self->capacity) {
@@ -89,17 +102,15 @@ HashIter_Get_Key_IMP(HashIterator *self) {
         THROW(ERR, "Invalid call to Get_Key before iteration.");
     }
 
-    HashEntry *const entry
-        = (HashEntry*)self->hash->entries + self->tick;
-    if (entry->key == TOMBSTONE) {
+    if (!HashCtrl_is_full(SI_ctrl(self))) {
         THROW(ERR, "Hash modified during iteration.");
     }
-    return entry->key;
+    return SI_entry(self)->key;
 }
 
 Obj*
 HashIter_Get_Value_IMP(HashIterator *self) {
-    if (self->capacity != self->hash->capacity) {
+    if (SI_modified(self)) {
         THROW(ERR, "Hash modified during iteration.");
     }
     if (self->tick >= (int32_t)self->capacity) {
@@ -109,9 +120,7 @@ HashIter_Get_Value_IMP(HashIterator *self) {
         THROW(ERR, "Invalid call to Get_Value before iteration.");
     }
 
-    HashEntry *const entry
-        = (HashEntry*)self->hash->entries + self->tick;
-    return entry->value;
+    return SI_entry(self)->value;
 }
 
 void
@@ -121,3 +130,29 @@ HashIter_Destroy_IMP(HashIterator *self) {
     SUPER_DESTROY(self, HASHITERATOR);
 }
 
+/*****************************************************************/
+
+StackHashIterator*
+SHashIter_new(void *allocation, Hash *hash) {
+    StackHashIterator *self
+        = (StackHashIterator*)Class_Init_Obj(STACKHASHITERATOR, allocation);
+    // Assume that the hash will be available for the lifetime of the
+    // iterator and don't increase its refcount.
+    self->hash       = hash;
+    self->tick       = -1;
+    self->capacity   = hash->capacity + hash->old_capacity;
+    self->generation = hash->generation;
+    return self;
+}
+
+size_t
+SHashIter_size() {
+    return sizeof(StackHashIterator);
+}
+
+void
+SHashIter_Destroy_IMP(StackHashIterator *self) {
+    UNUSED_VAR(self);
+    THROW(ERR, "Can't destroy a StackHashIterator");
+}
+
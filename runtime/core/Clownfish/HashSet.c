@@ -0,0 +1,286 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#define C_CFISH_HASHSET
+#define CFISH_USE_SHORT_NAMES
+
+#include <string.h>
+
+#include "Clownfish/Class.h"
+
+#include "Clownfish/HashSet.h"
+#include "Clownfish/String.h"
+#include "Clownfish/Err.h"
+#include "Clownfish/VArray.h"
+#include "Clownfish/Util/HashGroup.h"
+
+// Each slot holds nothing but a key; String caches its hash sum for
+// rebuilds.
+typedef String *HashSetEntry;
+
+// Make room for an insertion, either by doubling the number of buckets or,
+// if tombstones account for much of the table, by clearing them out.
+static void
+S_rebuild(HashSet *self);
+
+static CFISH_INLINE bool
+SI_entry_equals(const void *entry, const void *key) {
+    return Str_Equals((String*)key, *(Obj *const*)entry);
+}
+
+static CFISH_INLINE int32_t
+SI_entry_hash_sum(const void *entry, void *context) {
+    UNUSED_VAR(context);
+    return Str_Hash_Sum(*(String *const*)entry);
+}
+
+static void
+S_alloc_table(HashSet *self, uint32_t capacity) {
+    self->entries   = HashGroup_alloc_table(self, capacity,
+                                            sizeof(HashSetEntry));
+    self->ctrl      = HashGroup_ctrl(self->entries, capacity,
+                                     sizeof(HashSetEntry));
+    self->capacity  = capacity;
+    self->threshold = HashGroup_threshold(capacity);
+}
+
+// Return the slot holding the key, if any.
+static CFISH_INLINE HashSetEntry*
+SI_fetch_entry(HashSet *self, String *key, int32_t hash_sum) {
+    return (HashSetEntry*)HashGroup_find(self->entries, sizeof(HashSetEntry),
+                                         self->ctrl, self->capacity,
+                                         hash_sum, key, SI_entry_equals);
+}
+
+HashSet*
+HashSet_new(uint32_t capacity) {
+    HashSet *self = (HashSet*)Class_Make_Obj(HASHSET);
+    return HashSet_init(self, capacity);
+}
+
+HashSet*
+HashSet_init(HashSet *self, uint32_t capacity) {
+    uint32_t requested_capacity = capacity < INT32_MAX ? capacity : INT32_MAX;
+    self->size = 0;
+    S_alloc_table(self, HashGroup_capacity_for(requested_capacity));
+    return self;
+}
+
+void
+HashSet_Destroy_IMP(HashSet *self) {
+    if (self->entries) {
+        HashSet_Clear(self);
+        HashGroup_free_table(self, self->entries, self->capacity,
+                             sizeof(HashSetEntry));
+    }
+    SUPER_DESTROY(self, HASHSET);
+}
+
+void
+HashSet_Clear_IMP(HashSet *self) {
+    HashSetEntry *const entries = (HashSetEntry*)self->entries;
+    uint8_t      *const ctrl    = self->ctrl;
+
+    for (uint32_t i = 0; i < self->capacity; i++) {
+        if (HashCtrl_is_full(ctrl[i])) {
+            DECREF(entries[i]);
+        }
+    }
+    memset(ctrl, HASHCTRL_EMPTY, self->capacity);
+
+    self->size      = 0;
+    self->threshold = HashGroup_threshold(self->capacity);
+}
+
+// Add a key known to be absent, growing if necessary.
+static CFISH_INLINE void
+SI_add_absent(HashSet *self, String *key, int32_t hash_sum) {
+    if (self->size >= self->threshold) {
+        S_rebuild(self);
+    }
+    size_t tick = HashGroup_claim(self->ctrl, self->capacity, hash_sum,
+                                  &self->threshold);
+    ((HashSetEntry*)self->entries)[tick] = (String*)INCREF(key);
+    self->size++;
+}
+
+static bool
+S_do_add(HashSet *self, String *key, int32_t hash_sum) {
+    if (SI_fetch_entry(self, key, hash_sum)) {
+        return false;
+    }
+    SI_add_absent(self, key, hash_sum);
+    return true;
+}
+
+bool
+HashSet_Add_IMP(HashSet *self, String *key) {
+    return S_do_add(self, key, Str_Hash_Sum(key));
+}
+
+bool
+HashSet_Add_Utf8_IMP(HashSet *self, const char *key, size_t key_len) {
+    StackString *key_buf = SSTR_WRAP_UTF8(key, key_len);
+    return S_do_add(self, (String*)key_buf, SStr_Hash_Sum(key_buf));
+}
+
+bool
+HashSet_Contains_IMP(HashSet *self, String *key) {
+    return SI_fetch_entry(self, key, Str_Hash_Sum(key)) != NULL;
+}
+
+bool
+HashSet_Contains_Utf8_IMP(HashSet *self, const char *key, size_t key_len) {
+    StackString *key_buf = SSTR_WRAP_UTF8(key, key_len);
+    return SI_fetch_entry(self, (String*)key_buf, SStr_Hash_Sum(key_buf))
+           != NULL;
+}
+
+bool
+HashSet_Remove_IMP(HashSet *self, String *key) {
+    HashSetEntry *entry = SI_fetch_entry(self, key, Str_Hash_Sum(key));
+    if (!entry) {
+        return false;
+    }
+
+    DECREF(*entry);
+    self->size--;
+    size_t tick = entry - (HashSetEntry*)self->entries;
+    if (HashGroup_vacate(self->ctrl, tick)) {
+        self->threshold--; // limit number of tombstones
+    }
+    return true;
+}
+
+HashSet*
+HashSet_Union_IMP(HashSet *self, HashSet *other) {
+    HashSet *result = HashSet_new(self->size + other->size);
+
+    // Keys from `self` are distinct, so they need no lookup.
+    HashSetEntry *entries = (HashSetEntry*)self->entries;
+    for (uint32_t i = 0; i < self->capacity; i++) {
+        if (HashCtrl_is_full(self->ctrl[i])) {
+            SI_add_absent(result, entries[i], Str_Hash_Sum(entries[i]));
+        }
+    }
+
+    entries = (HashSetEntry*)other->entries;
+    for (uint32_t i = 0; i < other->capacity; i++) {
+        if (HashCtrl_is_full(other->ctrl[i])) {
+            S_do_add(result, entries[i], Str_Hash_Sum(entries[i]));
+        }
+    }
+
+    return result;
+}
+
+HashSet*
+HashSet_Intersection_IMP(HashSet *self, HashSet *other) {
+    // Walk the smaller set and probe the larger one.
+    HashSet *small = self->size <= other->size ? self : other;
+    HashSet *large = small == self ? other : self;
+    HashSet *result = HashSet_new(small->size);
+
+    HashSetEntry *entries = (HashSetEntry*)small->entries;
+    for (uint32_t i = 0; i < small->capacity; i++) {
+        if (!HashCtrl_is_full(small->ctrl[i])) { continue; }
+        int32_t hash_sum = Str_Hash_Sum(entries[i]);
+        if (SI_fetch_entry(large, entries[i], hash_sum)) {
+            SI_add_absent(result, entries[i], hash_sum);
+        }
+    }
+
+    return result;
+}
+
+HashSet*
+HashSet_Difference_IMP(HashSet *self, HashSet *other) {
+    HashSet *result = HashSet_new(self->size);
+
+    HashSetEntry *entries = (HashSetEntry*)self->entries;
+    for (uint32_t i = 0; i < self->capacity; i++) {
+        if (!HashCtrl_is_full(self->ctrl[i])) { continue; }
+        int32_t hash_sum = Str_Hash_Sum(entries[i]);
+        if (!SI_fetch_entry(other, entries[i], hash_sum)) {
+            SI_add_absent(result, entries[i], hash_sum);
+        }
+    }
+
+    return result;
+}
+
+VArray*
+HashSet_Keys_IMP(HashSet *self) {
+    VArray       *keys          = VA_new(self->size);
+    HashSetEntry *const entries = (HashSetEntry*)self->entries;
+    uint8_t      *const ctrl    = self->ctrl;
+
+    for (uint32_t i = 0; i < self->capacity; i++) {
+        if (HashCtrl_is_full(ctrl[i])) {
+            VA_Push(keys, INCREF(entries[i]));
+        }
+    }
+
+    return keys;
+}
+
+uint32_t
+HashSet_Get_Capacity_IMP(HashSet *self) {
+    return self->capacity;
+}
+
+uint32_t
+HashSet_Get_Size_IMP(HashSet *self) {
+    return self->size;
+}
+
+bool
+HashSet_Equals_IMP(HashSet *self, Obj *other) {
+    HashSet *twin = (HashSet*)other;
+
+    if (twin == self)               { return true; }
+    if (!Obj_Is_A(other, HASHSET))  { return false; }
+    if (self->size != twin->size)   { return false; }
+
+    HashSetEntry *const entries = (HashSetEntry*)self->entries;
+    for (uint32_t i = 0; i < self->capacity; i++) {
+        if (HashCtrl_is_full(self->ctrl[i])
+            && !HashSet_Contains(twin, entries[i])
+           ) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static void
+S_rebuild(HashSet *self) {
+    uint32_t capacity = HashGroup_rebuild_capacity(self->size, self->capacity);
+    if (capacity == 0) {
+        THROW(ERR, "HashSet grew too large");
+    }
+
+    void     *old_entries  = self->entries;
+    uint32_t  old_capacity = self->capacity;
+
+    S_alloc_table(self, capacity);
+    HashGroup_rehash(self->entries, capacity, old_entries, old_capacity,
+                     sizeof(HashSetEntry), SI_entry_hash_sum, NULL);
+    HashGroup_free_table(self, old_entries, old_capacity,
+                         sizeof(HashSetEntry));
+}
@@ -0,0 +1,183 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#define C_CFISH_I64HASH
+#define CFISH_USE_SHORT_NAMES
+
+#include <string.h>
+
+#include "Clownfish/Class.h"
+
+#include "Clownfish/I64Hash.h"
+#include "Clownfish/Err.h"
+#include "Clownfish/Util/HashGroup.h"
+#include "Clownfish/Util/HashUtils.h"
+
+typedef struct I64HashEntry {
+    int64_t  key;
+    Obj     *value;
+} I64HashEntry;
+
+// Make room for an insertion, either by doubling the number of buckets or,
+// if tombstones account for much of the table, by clearing them out.
+static void
+S_rebuild(I64Hash *self);
+
+static CFISH_INLINE int32_t
+SI_hash_sum(I64Hash *self, int64_t key) {
+    return HashUtil_fold32(HashUtil_mix64((uint64_t)key ^ self->seed));
+}
+
+static CFISH_INLINE bool
+SI_entry_equals(const void *entry, const void *key) {
+    return ((const I64HashEntry*)entry)->key == *(const int64_t*)key;
+}
+
+static CFISH_INLINE int32_t
+SI_entry_hash_sum(const void *entry, void *context) {
+    return SI_hash_sum((I64Hash*)context, ((const I64HashEntry*)entry)->key);
+}
+
+static void
+S_alloc_table(I64Hash *self, uint32_t capacity) {
+    self->entries   = HashGroup_alloc_table(self, capacity,
+                                            sizeof(I64HashEntry));
+    self->ctrl      = HashGroup_ctrl(self->entries, capacity,
+                                     sizeof(I64HashEntry));
+    self->capacity  = capacity;
+    self->threshold = HashGroup_threshold(capacity);
+}
+
+// Return the entry associated with the key, if any.
+static CFISH_INLINE I64HashEntry*
+SI_fetch_entry(I64Hash *self, int64_t key, int32_t hash_sum) {
+    return (I64HashEntry*)HashGroup_find(self->entries, sizeof(I64HashEntry),
+                                         self->ctrl, self->capacity,
+                                         hash_sum, &key, SI_entry_equals);
+}
+
+I64Hash*
+I64Hash_new(uint32_t capacity) {
+    I64Hash *self = (I64Hash*)Class_Make_Obj(I64HASH);
+    return I64Hash_init(self, capacity);
+}
+
+I64Hash*
+I64Hash_init(I64Hash *self, uint32_t capacity) {
+    uint32_t requested_capacity = capacity < INT32_MAX ? capacity : INT32_MAX;
+    self->size = 0;
+    self->seed = HashUtil_get_seed();
+    S_alloc_table(self, HashGroup_capacity_for(requested_capacity));
+    return self;
+}
+
+void
+I64Hash_Destroy_IMP(I64Hash *self) {
+    if (self->entries) {
+        I64Hash_Clear(self);
+        HashGroup_free_table(self, self->entries, self->capacity,
+                             sizeof(I64HashEntry));
+    }
+    SUPER_DESTROY(self, I64HASH);
+}
+
+void
+I64Hash_Clear_IMP(I64Hash *self) {
+    I64HashEntry *const entries = (I64HashEntry*)self->entries;
+    uint8_t      *const ctrl    = self->ctrl;
+
+    for (uint32_t i = 0; i < self->capacity; i++) {
+        if (HashCtrl_is_full(ctrl[i])) {
+            DECREF(entries[i].value);
+        }
+    }
+    memset(ctrl, HASHCTRL_EMPTY, self->capacity);
+
+    self->size      = 0;
+    self->threshold = HashGroup_threshold(self->capacity);
+}
+
+void
+I64Hash_Store_IMP(I64Hash *self, int64_t key, Obj *value) {
+    int32_t       hash_sum = SI_hash_sum(self, key);
+    I64HashEntry *entry    = SI_fetch_entry(self, key, hash_sum);
+    if (entry) {
+        DECREF(entry->value);
+        entry->value = value;
+        return;
+    }
+
+    if (self->size >= self->threshold) {
+        S_rebuild(self);
+    }
+    size_t tick = HashGroup_claim(self->ctrl, self->capacity, hash_sum,
+                                  &self->threshold);
+    entry = (I64HashEntry*)self->entries + tick;
+    entry->key   = key;
+    entry->value = value;
+    self->size++;
+}
+
+Obj*
+I64Hash_Fetch_IMP(I64Hash *self, int64_t key) {
+    I64HashEntry *entry = SI_fetch_entry(self, key, SI_hash_sum(self, key));
+    return entry ? entry->value : NULL;
+}
+
+Obj*
+I64Hash_Delete_IMP(I64Hash *self, int64_t key) {
+    I64HashEntry *entry = SI_fetch_entry(self, key, SI_hash_sum(self, key));
+    if (entry) {
+        Obj *value = entry->value;
+        self->size--;
+        size_t tick = entry - (I64HashEntry*)self->entries;
+        if (HashGroup_vacate(self->ctrl, tick)) {
+            self->threshold--; // limit number of tombstones
+        }
+        return value;
+    }
+    else {
+        return NULL;
+    }
+}
+
+uint32_t
+I64Hash_Get_Capacity_IMP(I64Hash *self) {
+    return self->capacity;
+}
+
+uint32_t
+I64Hash_Get_Size_IMP(I64Hash *self) {
+    return self->size;
+}
+
+static void
+S_rebuild(I64Hash *self) {
+    uint32_t capacity = HashGroup_rebuild_capacity(self->size, self->capacity);
+    if (capacity == 0) {
+        THROW(ERR, "I64Hash grew too large");
+    }
+
+    void     *old_entries  = self->entries;
+    uint32_t  old_capacity = self->capacity;
+
+    S_alloc_table(self, capacity);
+    HashGroup_rehash(self->entries, capacity, old_entries, old_capacity,
+                     sizeof(I64HashEntry), SI_entry_hash_sum, self);
+    HashGroup_free_table(self, old_entries, old_capacity,
+                         sizeof(I64HashEntry));
+}
@@ -24,14 +24,259 @@
 #include "Clownfish/Util/Atomic.h"
 #include "Clownfish/Util/Memory.h"
 
+// Deleted entries stay in the list, with the low bit of `next` set, until
+// a writer unlinks them.  Sentinels have a NULL key and are never deleted.
 typedef struct cfish_LFRegEntry {
-    String *key;
-    Obj *value;
+    uint32_t so_key;    /* bit-reversed sort key, odd unless a sentinel */
     int32_t hash_sum;
-    struct cfish_LFRegEntry *volatile next;
+    String *key;
+    Obj *volatile value;
+    volatile uintptr_t next;
+    struct cfish_LFRegEntry *retired_next;
 } cfish_LFRegEntry;
 #define LFRegEntry cfish_LFRegEntry
 
+// Operations announce themselves per thread with Memory_epoch_enter.
+// Retired memory is moved to `pending` when the epoch advances, and freed
+// once no thread is still in an operation which started before.  The
+// epoch isn't advanced for this registry again before that.
+typedef struct {
+    LFRegEntry *retired;        /* lock-free stack, linked by retired_next */
+    LFRegEntry *pending;        /* owned by the thread holding `lock` */
+    size_t      pending_epoch;  /* epoch after which `pending` is safe */
+    void       *lock;
+} LFRegEpochs;
+
+#define SI_ENTRY(raw)     ((LFRegEntry*)((raw) & ~(uintptr_t)1))
+#define SI_DELETED(raw)   (((raw) & 1) != 0)
+
+// Links, bucket slots and values are published with CAS by other threads,
+// so they are loaded with acquire semantics.  The other fields of an entry
+// don't change after it has been linked in.
+static CFISH_INLINE uintptr_t
+SI_load_next(LFRegEntry *entry) {
+    return (uintptr_t)Atomic_load_acquire_ptr((void*volatile*)&entry->next);
+}
+
+static CFISH_INLINE LFRegEntry*
+SI_load_slot(LFRegEntry *volatile *slot) {
+    return (LFRegEntry*)Atomic_load_acquire_ptr((void*volatile*)slot);
+}
+
+static CFISH_INLINE Obj*
+SI_load_value(LFRegEntry *entry) {
+    return (Obj*)Atomic_load_acquire_ptr((void*volatile*)&entry->value);
+}
+
+static CFISH_INLINE bool
+SI_cas_next(LFRegEntry *entry, uintptr_t old_next, uintptr_t new_next) {
+    return Atomic_cas_ptr((void*volatile*)&entry->next, (void*)old_next,
+                          (void*)new_next);
+}
+
+#define MAX_CAPACITY  ((size_t)1 << 31)
+#define MAX_SEGMENTS  33
+#define MAX_LOAD      2
+
+static uint32_t
+S_reverse_bits(uint32_t value) {
+    value = ((value >> 1) & 0x55555555u) | ((value & 0x55555555u) << 1);
+    value = ((value >> 2) & 0x33333333u) | ((value & 0x33333333u) << 2);
+    value = ((value >> 4) & 0x0F0F0F0Fu) | ((value & 0x0F0F0F0Fu) << 4);
+    value = ((value >> 8) & 0x00FF00FFu) | ((value & 0x00FF00FFu) << 8);
+    return (value >> 16) | (value << 16);
+}
+
+static CFISH_INLINE uint32_t
+SI_regular_so_key(int32_t hash_sum) {
+    return S_reverse_bits((uint32_t)hash_sum | 0x80000000u);
+}
+
+static CFISH_INLINE uint32_t
+SI_sentinel_so_key(size_t bucket) {
+    return S_reverse_bits((uint32_t)bucket);
+}
+
+// A bucket's parent is the bucket which its entries were split from.
+static CFISH_INLINE size_t
+SI_parent(size_t bucket) {
+    size_t high_bit = bucket;
+    while (high_bit & (high_bit - 1)) {
+        high_bit &= high_bit - 1;
+    }
+    return bucket & ~high_bit;
+}
+
+// Return the address of the directory slot for `bucket`, or NULL if its
+// segment hasn't been allocated yet.  With `create`, allocate the segment.
+static LFRegEntry *volatile*
+S_bucket_slot(LockFreeRegistry *self, size_t bucket, bool create) {
+    void *volatile *segments = (void*volatile*)self->segments;
+    size_t segment = 0;
+    size_t offset  = bucket;
+    size_t limit   = self->first_segment;
+    while (bucket >= limit) {
+        offset = bucket - limit;
+        limit <<= 1;
+        segment++;
+    }
+
+    LFRegEntry *volatile *entries
+        = (LFRegEntry*volatile*)Atomic_load_acquire_ptr(&segments[segment]);
+    if (!entries) {
+        if (!create) { return NULL; }
+        size_t seg_size = segment == 0
+                          ? self->first_segment
+                          : self->first_segment << (segment - 1);
+        void *fresh = CALLOCATE(seg_size, sizeof(LFRegEntry*));
+        if (!Atomic_cas_ptr(&segments[segment], NULL, fresh)) {
+            FREEMEM(fresh);
+        }
+        entries = (LFRegEntry*volatile*)Atomic_load_acquire_ptr(
+                      &segments[segment]);
+    }
+    return entries + offset;
+}
+
+static void
+S_retire(LockFreeRegistry *self, LFRegEntry *entry) {
+    LFRegEpochs *epochs = (LFRegEpochs*)self->epochs;
+    while (1) {
+        LFRegEntry *head = (LFRegEntry*)Atomic_load_acquire_ptr(
+                               (void*volatile*)&epochs->retired);
+        entry->retired_next = head;
+        if (Atomic_cas_ptr((void*volatile*)&epochs->retired, head, entry)) {
+            return;
+        }
+    }
+}
+
+// Retire a replaced value by wrapping it in an entry of its own.
+static void
+S_retire_value(LockFreeRegistry *self, Obj *value) {
+    LFRegEntry *husk = (LFRegEntry*)CALLOCATE(1, sizeof(LFRegEntry));
+    husk->value = value;
+    S_retire(self, husk);
+}
+
+static size_t
+S_free_entries(LFRegEntry *entry, bool retired) {
+    size_t num_freed = 0;
+    while (entry) {
+        LFRegEntry *next_entry = retired
+                                 ? entry->retired_next
+                                 : SI_ENTRY(entry->next);
+        if (entry->key)   { DECREF(entry->key); }
+        if (entry->value) { DECREF(entry->value); }
+        FREEMEM(entry);
+        entry = next_entry;
+        num_freed++;
+    }
+    return num_freed;
+}
+
+// Return the first entry after `start` which doesn't sort before the
+// target, and point `prev_ptr` at its predecessor.  Deleted entries met on
+// the way are unlinked and retired.  `found` is set if the entry is a
+// match: a sentinel if `key` is NULL, otherwise an entry with an equal key.
+static LFRegEntry*
+S_find(LockFreeRegistry *self, LFRegEntry *start, uint32_t so_key,
+       int32_t hash_sum, String *key, LFRegEntry **prev_ptr, bool *found) {
+RETRY:
+    *found = false;
+    LFRegEntry *prev  = start;
+    LFRegEntry *entry = SI_ENTRY(SI_load_next(prev));
+    while (entry) {
+        uintptr_t next = SI_load_next(entry);
+        if (SI_DELETED(next)) {
+            // If `prev` changed or was deleted itself, start over.
+            uintptr_t succ = (uintptr_t)SI_ENTRY(next);
+            if (!SI_cas_next(prev, (uintptr_t)entry, succ)) {
+                goto RETRY;
+            }
+            S_retire(self, entry);
+            entry = SI_ENTRY(next);
+            continue;
+        }
+        if (entry->so_key > so_key) {
+            break;
+        }
+        else if (entry->so_key == so_key
+                 && (key == NULL
+                     || (entry->hash_sum == hash_sum
+                         && Str_Equals(key, (Obj*)entry->key)))
+                ) {
+            *found = true;
+            break;
+        }
+        prev  = entry;
+        entry = SI_ENTRY(next);
+    }
+    *prev_ptr = prev;
+    return entry;
+}
+
+// Link `new_entry` into the list after `start`, unless an equal entry is
+// already present.  Return the entry which ends up in the list.
+static LFRegEntry*
+S_insert(LockFreeRegistry *self, LFRegEntry *start, LFRegEntry *new_entry) {
+    while (1) {
+        LFRegEntry *prev;
+        bool        found;
+        LFRegEntry *entry = S_find(self, start, new_entry->so_key,
+                                   new_entry->hash_sum, new_entry->key,
+                                   &prev, &found);
+        if (found) {
+            return entry;
+        }
+        new_entry->next = (uintptr_t)entry;
+        if (SI_cas_next(prev, (uintptr_t)entry, (uintptr_t)new_entry)) {
+            return new_entry;
+        }
+    }
+}
+
+static LFRegEntry*
+S_new_entry(uint32_t so_key, int32_t hash_sum, String *key, Obj *value) {
+    LFRegEntry *entry = (LFRegEntry*)MALLOCATE(sizeof(LFRegEntry));
+    entry->so_key       = so_key;
+    entry->hash_sum     = hash_sum;
+    entry->key          = key;
+    entry->value        = value;
+    entry->next         = 0;
+    entry->retired_next = NULL;
+    return entry;
+}
+
+// Return the sentinel for `bucket`, splicing it into the list first if
+// necessary.  Bucket 0 heads the list and is created by init.
+static LFRegEntry*
+S_get_bucket(LockFreeRegistry *self, size_t bucket) {
+    LFRegEntry *volatile *slot = S_bucket_slot(self, bucket, true);
+    LFRegEntry *sentinel = SI_load_slot(slot);
+    if (sentinel) { return sentinel; }
+
+    LFRegEntry *parent = S_get_bucket(self, SI_parent(bucket));
+    LFRegEntry *fresh  = S_new_entry(SI_sentinel_so_key(bucket), 0, NULL,
+                                     NULL);
+    sentinel = S_insert(self, parent, fresh);
+    if (sentinel != fresh) {
+        FREEMEM(fresh);
+    }
+    Atomic_cas_ptr((void*volatile*)slot, NULL, sentinel);
+    return sentinel;
+}
+
+// Count a new entry, doubling the number of buckets when they get too
+// crowded.  Losing the race just means that another thread did it.
+static void
+S_count_new_entry(LockFreeRegistry *self, size_t capacity) {
+    size_t size = Atomic_fetch_add_size(&self->size, 1) + 1;
+    if (size / capacity > MAX_LOAD && capacity < MAX_CAPACITY) {
+        Atomic_cas_size(&self->capacity, capacity, capacity * 2);
+    }
+}
+
 LockFreeRegistry*
 LFReg_new(size_t capacity) {
     LockFreeRegistry *self
@@ -41,89 +286,249 @@ LFReg_new(size_t capacity) {
 
 LockFreeRegistry*
 LFReg_init(LockFreeRegistry *self, size_t capacity) {
-    self->capacity = capacity;
-    self->entries  = CALLOCATE(capacity, sizeof(void*));
+    size_t first_segment = 1;
+    while (first_segment < capacity && first_segment < MAX_CAPACITY) {
+        first_segment <<= 1;
+    }
+    self->capacity      = first_segment;
+    self->size          = 0;
+    self->first_segment = first_segment;
+    self->segments      = CALLOCATE(MAX_SEGMENTS, sizeof(void*));
+    self->epochs        = CALLOCATE(1, sizeof(LFRegEpochs));
+    *S_bucket_slot(self, 0, true)
+        = S_new_entry(SI_sentinel_so_key(0), 0, NULL, NULL);
     return self;
 }
 
 bool
 LFReg_Register_IMP(LockFreeRegistry *self, String *key, Obj *value) {
-    LFRegEntry  *new_entry = NULL;
-    int32_t      hash_sum  = Str_Hash_Sum(key);
-    size_t       bucket    = (uint32_t)hash_sum  % self->capacity;
-    LFRegEntry  *volatile *entries = (LFRegEntry*volatile*)self->entries;
-    LFRegEntry  *volatile *slot    = &(entries[bucket]);
-
-    // Proceed through the linked list.  Bail out if the key has already been
-    // registered.
-FIND_END_OF_LINKED_LIST:
-    while (*slot) {
-        LFRegEntry *entry = *slot;
-        if (entry->hash_sum == hash_sum) {
-            if (Str_Equals(key, (Obj*)entry->key)) {
-                return false;
+    int32_t     hash_sum = Str_Hash_Sum(key);
+    size_t      capacity = Atomic_load_acquire_size(&self->capacity);
+    size_t      bucket   = (uint32_t)hash_sum & (capacity - 1);
+
+    Memory_epoch_enter();
+    LFRegEntry *sentinel = S_get_bucket(self, bucket);
+
+    LFRegEntry *new_entry
+        = S_new_entry(SI_regular_so_key(hash_sum), hash_sum,
+                      (String*)INCREF(key), INCREF(value));
+    bool registered = S_insert(self, sentinel, new_entry) == new_entry;
+    Memory_epoch_exit();
+
+    // Bail out if the key has already been registered.
+    if (!registered) {
+        DECREF(new_entry->key);
+        DECREF(new_entry->value);
+        FREEMEM(new_entry);
+        return false;
+    }
+    S_count_new_entry(self, capacity);
+    return true;
+}
+
+bool
+LFReg_Store_IMP(LockFreeRegistry *self, String *key, Obj *value) {
+    int32_t     hash_sum  = Str_Hash_Sum(key);
+    uint32_t    so_key    = SI_regular_so_key(hash_sum);
+    Obj        *new_value = INCREF(value);
+    LFRegEntry *new_entry = NULL;
+    bool        replaced  = false;
+    size_t      capacity  = Atomic_load_acquire_size(&self->capacity);
+    size_t      bucket    = (uint32_t)hash_sum & (capacity - 1);
+
+    Memory_epoch_enter();
+    LFRegEntry *sentinel  = S_get_bucket(self, bucket);
+
+    while (1) {
+        LFRegEntry *prev;
+        bool        found;
+        LFRegEntry *entry = S_find(self, sentinel, so_key, hash_sum, key,
+                                   &prev, &found);
+        if (found) {
+            Obj *old_value = SI_load_value(entry);
+            if (Atomic_cas_ptr((void*volatile*)&entry->value, old_value,
+                               new_value)) {
+                S_retire_value(self, old_value);
+                replaced = true;
+                break;
+            }
+        }
+        else {
+            if (!new_entry) {
+                new_entry = S_new_entry(so_key, hash_sum,
+                                        (String*)INCREF(key), new_value);
+            }
+            new_entry->next = (uintptr_t)entry;
+            if (SI_cas_next(prev, (uintptr_t)entry, (uintptr_t)new_entry)) {
+                break;
             }
         }
-        slot = &(entry->next);
     }
+    Memory_epoch_exit();
 
-    // We've found an empty slot. Create the new entry.
-    if (!new_entry) {
-        new_entry = (LFRegEntry*)MALLOCATE(sizeof(LFRegEntry));
-        new_entry->hash_sum  = hash_sum;
-        new_entry->key       = (String*)INCREF(key);
-        new_entry->value     = INCREF(value);
-        new_entry->next      = NULL;
+    if (replaced) {
+        if (new_entry) {
+            DECREF(new_entry->key);
+            FREEMEM(new_entry);
+        }
+        LFReg_Reclaim(self);
     }
+    else {
+        S_count_new_entry(self, capacity);
+    }
+    return replaced;
+}
+
+bool
+LFReg_Delete_IMP(LockFreeRegistry *self, String *key) {
+    int32_t     hash_sum = Str_Hash_Sum(key);
+    uint32_t    so_key   = SI_regular_so_key(hash_sum);
+    bool        deleted  = false;
+    size_t      capacity = Atomic_load_acquire_size(&self->capacity);
+    size_t      bucket   = (uint32_t)hash_sum & (capacity - 1);
+
+    Memory_epoch_enter();
+    LFRegEntry *sentinel = S_get_bucket(self, bucket);
+
+    while (1) {
+        LFRegEntry *prev;
+        bool        found;
+        LFRegEntry *entry = S_find(self, sentinel, so_key, hash_sum, key,
+                                   &prev, &found);
+        if (!found) { break; }
 
-    /* Attempt to append the new node onto the end of the linked list.
-     * However, if another thread filled the slot since we found it (perhaps
-     * while we were allocating that new node), the compare-and-swap will
-     * fail.  If that happens, we have to go back and find the new end of the
-     * linked list, then try again. */
-    if (!Atomic_cas_ptr((void*volatile*)slot, NULL, new_entry)) {
-        goto FIND_END_OF_LINKED_LIST;
+        // Mark the entry as deleted, then try to unlink it.  If that fails,
+        // S_find unlinks it.
+        uintptr_t next = SI_load_next(entry);
+        if (SI_DELETED(next)
+            || !SI_cas_next(entry, next, next | 1)
+           ) {
+            continue;
+        }
+        deleted = true;
+        if (SI_cas_next(prev, (uintptr_t)entry, next)) {
+            S_retire(self, entry);
+        }
+        else {
+            S_find(self, sentinel, so_key, hash_sum, key, &prev, &found);
+        }
+        break;
     }
+    Memory_epoch_exit();
 
-    return true;
+    if (deleted) {
+        Atomic_fetch_add_size(&self->size, (size_t)-1);
+        LFReg_Reclaim(self);
+    }
+    return deleted;
 }
 
 Obj*
 LFReg_Fetch_IMP(LockFreeRegistry *self, String *key) {
-    int32_t      hash_sum  = Str_Hash_Sum(key);
-    size_t       bucket    = (uint32_t)hash_sum  % self->capacity;
-    LFRegEntry **entries   = (LFRegEntry**)self->entries;
-    LFRegEntry  *entry     = entries[bucket];
+    int32_t     hash_sum = Str_Hash_Sum(key);
+    uint32_t    so_key   = SI_regular_so_key(hash_sum);
+    Obj        *value    = NULL;
+    size_t      capacity = Atomic_load_acquire_size(&self->capacity);
+    size_t      bucket   = (uint32_t)hash_sum & (capacity - 1);
+
+    Memory_epoch_enter();
+
+    // Buckets which haven't been spliced in yet are covered by their
+    // parents.  Bucket 0 always exists.
+    LFRegEntry *entry = NULL;
+    while (1) {
+        LFRegEntry *volatile *slot = S_bucket_slot(self, bucket, false);
+        if (slot && (entry = SI_load_slot(slot)) != NULL) { break; }
+        bucket = SI_parent(bucket);
+    }
 
+    entry = SI_ENTRY(SI_load_next(entry));
     while (entry) {
-        if (entry->hash_sum  == hash_sum) {
-            if (Str_Equals(key, (Obj*)entry->key)) {
-                return entry->value;
-            }
+        uintptr_t next = SI_load_next(entry);
+        if (entry->so_key > so_key) {
+            break;
         }
-        entry = entry->next;
+        else if (entry->so_key == so_key
+                 && entry->hash_sum == hash_sum
+                 && !SI_DELETED(next)
+                 && Str_Equals(key, (Obj*)entry->key)
+                ) {
+            value = SI_load_value(entry);
+            break;
+        }
+        entry = SI_ENTRY(next);
     }
 
-    return NULL;
+    Memory_epoch_exit();
+    return value;
+}
+
+size_t
+LFReg_Reclaim_IMP(LockFreeRegistry *self) {
+    LFRegEpochs *epochs    = (LFRegEpochs*)self->epochs;
+    size_t       num_freed = 0;
+
+    // Only one thread reclaims at a time.  The others leave it to it.
+    if (!Atomic_cas_ptr((void*volatile*)&epochs->lock, NULL, self)) {
+        return 0;
+    }
+
+    // Memory retired before the last advance of the epoch may still be
+    // seen by operations which started before it.
+    if (epochs->pending) {
+        if (!Memory_epoch_quiescent(epochs->pending_epoch)) {
+            Atomic_cas_ptr((void*volatile*)&epochs->lock, self, NULL);
+            return 0;
+        }
+        num_freed += S_free_entries(epochs->pending, true);
+        epochs->pending = NULL;
+    }
+
+    LFRegEntry *retired;
+    do {
+        retired = (LFRegEntry*)Atomic_load_acquire_ptr(
+                      (void*volatile*)&epochs->retired);
+    } while (!Atomic_cas_ptr((void*volatile*)&epochs->retired, retired,
+                             NULL));
+    if (retired) {
+        epochs->pending       = retired;
+        epochs->pending_epoch = Memory_epoch_advance();
+        if (Memory_epoch_quiescent(epochs->pending_epoch)) {
+            num_freed += S_free_entries(epochs->pending, true);
+            epochs->pending = NULL;
+        }
+    }
+
+    Atomic_cas_ptr((void*volatile*)&epochs->lock, self, NULL);
+    return num_freed;
+}
+
+size_t
+LFReg_Get_Size_IMP(LockFreeRegistry *self) {
+    return self->size;
+}
+
+size_t
+LFReg_Get_Capacity_IMP(LockFreeRegistry *self) {
+    return self->capacity;
 }
 
 void
 LFReg_Destroy_IMP(LockFreeRegistry *self) {
-    LFRegEntry **entries = (LFRegEntry**)self->entries;
+    LFRegEpochs *epochs   = (LFRegEpochs*)self->epochs;
+    void       **segments = (void**)self->segments;
 
-    for (size_t i = 0; i < self->capacity; i++) {
-        LFRegEntry *entry = entries[i];
-        while (entry) {
-            LFRegEntry *next_entry = entry->next;
-            DECREF(entry->key);
-            DECREF(entry->value);
-            FREEMEM(entry);
-            entry = next_entry;
-        }
+    // Every entry which hasn't been unlinked, sentinels included, is on
+    // the list headed by bucket 0.
+    S_free_entries(*S_bucket_slot(self, 0, false), false);
+    S_free_entries(epochs->retired, true);
+    S_free_entries(epochs->pending, true);
+    for (size_t i = 0; i < MAX_SEGMENTS; i++) {
+        FREEMEM(segments[i]);
     }
-    FREEMEM(self->entries);
+    FREEMEM(self->segments);
+    FREEMEM(self->epochs);
 
     SUPER_DESTROY(self, LOCKFREEREGISTRY);
 }
 
-
@@ -327,6 +327,13 @@ Bool_init_class() {
     Bool_false_singleton         = (BoolNum*)Class_Make_Obj(BOOLNUM);
     Bool_false_singleton->value  = false;
     Bool_false_singleton->string = Str_newf("false");
+    if (Class_census_enabled) {
+        // The singletons are immortal, so keep them out of the census.
+        Class_census_remove((Obj*)Bool_true_singleton);
+        Class_census_remove((Obj*)Bool_true_singleton->string);
+        Class_census_remove((Obj*)Bool_false_singleton);
+        Class_census_remove((Obj*)Bool_false_singleton->string);
+    }
 }
 
 BoolNum*
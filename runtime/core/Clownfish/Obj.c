@@ -39,7 +39,8 @@ Obj_init(Obj *self) {
 
 void
 Obj_Destroy_IMP(Obj *self) {
-    FREEMEM(self);
+    if (Class_census_enabled) { Class_census_remove(self); }
+    Memory_obj_free(self, self->klass->obj_alloc_size);
 }
 
 int32_t
@@ -0,0 +1,228 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#define C_CFISH_OBJHASH
+#define CFISH_USE_SHORT_NAMES
+
+#include <string.h>
+
+#include "Clownfish/Class.h"
+
+#include "Clownfish/ObjHash.h"
+#include "Clownfish/Err.h"
+#include "Clownfish/VArray.h"
+#include "Clownfish/Util/HashGroup.h"
+#include "Clownfish/Util/HashUtils.h"
+
+// Unlike String, arbitrary keys don't cache their hash sums, so keep them
+// around for rebuilds and to avoid calling Equals on mismatches.
+typedef struct ObjHashEntry {
+    Obj     *key;
+    Obj     *value;
+    int32_t  hash_sum;
+} ObjHashEntry;
+
+// Make room for an insertion, either by doubling the number of buckets or,
+// if tombstones account for much of the table, by clearing them out.
+static void
+S_rebuild(ObjHash *self);
+
+static CFISH_INLINE int32_t
+SI_hash_sum(Obj *key) {
+    return HashUtil_mix32(Obj_Hash_Sum(key));
+}
+
+typedef struct ObjHashKey {
+    Obj     *obj;
+    int32_t  hash_sum;
+} ObjHashKey;
+
+static CFISH_INLINE bool
+SI_entry_equals(const void *entry, const void *key) {
+    const ObjHashEntry *const e = (const ObjHashEntry*)entry;
+    const ObjHashKey   *const k = (const ObjHashKey*)key;
+    return e->hash_sum == k->hash_sum && Obj_Equals(k->obj, e->key);
+}
+
+static CFISH_INLINE int32_t
+SI_entry_hash_sum(const void *entry, void *context) {
+    UNUSED_VAR(context);
+    return ((const ObjHashEntry*)entry)->hash_sum;
+}
+
+static void
+S_alloc_table(ObjHash *self, uint32_t capacity) {
+    self->entries   = HashGroup_alloc_table(self, capacity,
+                                            sizeof(ObjHashEntry));
+    self->ctrl      = HashGroup_ctrl(self->entries, capacity,
+                                     sizeof(ObjHashEntry));
+    self->capacity  = capacity;
+    self->threshold = HashGroup_threshold(capacity);
+}
+
+// Return the entry associated with the key, if any.
+static CFISH_INLINE ObjHashEntry*
+SI_fetch_entry(ObjHash *self, Obj *key, int32_t hash_sum) {
+    ObjHashKey k = { key, hash_sum };
+    return (ObjHashEntry*)HashGroup_find(self->entries, sizeof(ObjHashEntry),
+                                         self->ctrl, self->capacity,
+                                         hash_sum, &k, SI_entry_equals);
+}
+
+ObjHash*
+ObjHash_new(uint32_t capacity) {
+    ObjHash *self = (ObjHash*)Class_Make_Obj(OBJHASH);
+    return ObjHash_init(self, capacity);
+}
+
+ObjHash*
+ObjHash_init(ObjHash *self, uint32_t capacity) {
+    uint32_t requested_capacity = capacity < INT32_MAX ? capacity : INT32_MAX;
+    self->size = 0;
+    S_alloc_table(self, HashGroup_capacity_for(requested_capacity));
+    return self;
+}
+
+void
+ObjHash_Destroy_IMP(ObjHash *self) {
+    if (self->entries) {
+        ObjHash_Clear(self);
+        HashGroup_free_table(self, self->entries, self->capacity,
+                             sizeof(ObjHashEntry));
+    }
+    SUPER_DESTROY(self, OBJHASH);
+}
+
+void
+ObjHash_Clear_IMP(ObjHash *self) {
+    ObjHashEntry *const entries = (ObjHashEntry*)self->entries;
+    uint8_t      *const ctrl    = self->ctrl;
+
+    for (uint32_t i = 0; i < self->capacity; i++) {
+        if (!HashCtrl_is_full(ctrl[i])) { continue; }
+        DECREF(entries[i].key);
+        DECREF(entries[i].value);
+    }
+    memset(ctrl, HASHCTRL_EMPTY, self->capacity);
+
+    self->size      = 0;
+    self->threshold = HashGroup_threshold(self->capacity);
+}
+
+void
+ObjHash_Store_IMP(ObjHash *self, Obj *key, Obj *value) {
+    int32_t       hash_sum = SI_hash_sum(key);
+    ObjHashEntry *entry    = SI_fetch_entry(self, key, hash_sum);
+    if (entry) {
+        DECREF(entry->value);
+        entry->value = value;
+        return;
+    }
+
+    if (self->size >= self->threshold) {
+        S_rebuild(self);
+    }
+    size_t tick = HashGroup_claim(self->ctrl, self->capacity, hash_sum,
+                                  &self->threshold);
+    entry = (ObjHashEntry*)self->entries + tick;
+    entry->key      = INCREF(key);
+    entry->value    = value;
+    entry->hash_sum = hash_sum;
+    self->size++;
+}
+
+Obj*
+ObjHash_Fetch_IMP(ObjHash *self, Obj *key) {
+    ObjHashEntry *entry = SI_fetch_entry(self, key, SI_hash_sum(key));
+    return entry ? entry->value : NULL;
+}
+
+Obj*
+ObjHash_Delete_IMP(ObjHash *self, Obj *key) {
+    ObjHashEntry *entry = SI_fetch_entry(self, key, SI_hash_sum(key));
+    if (entry) {
+        Obj *value = entry->value;
+        DECREF(entry->key);
+        self->size--;
+        size_t tick = entry - (ObjHashEntry*)self->entries;
+        if (HashGroup_vacate(self->ctrl, tick)) {
+            self->threshold--; // limit number of tombstones
+        }
+        return value;
+    }
+    else {
+        return NULL;
+    }
+}
+
+VArray*
+ObjHash_Keys_IMP(ObjHash *self) {
+    VArray       *keys          = VA_new(self->size);
+    ObjHashEntry *const entries = (ObjHashEntry*)self->entries;
+    uint8_t      *const ctrl    = self->ctrl;
+
+    for (uint32_t i = 0; i < self->capacity; i++) {
+        if (HashCtrl_is_full(ctrl[i])) {
+            VA_Push(keys, INCREF(entries[i].key));
+        }
+    }
+
+    return keys;
+}
+
+VArray*
+ObjHash_Values_IMP(ObjHash *self) {
+    VArray       *values        = VA_new(self->size);
+    ObjHashEntry *const entries = (ObjHashEntry*)self->entries;
+    uint8_t      *const ctrl    = self->ctrl;
+
+    for (uint32_t i = 0; i < self->capacity; i++) {
+        if (HashCtrl_is_full(ctrl[i])) {
+            VA_Push(values, INCREF(entries[i].value));
+        }
+    }
+
+    return values;
+}
+
+uint32_t
+ObjHash_Get_Capacity_IMP(ObjHash *self) {
+    return self->capacity;
+}
+
+uint32_t
+ObjHash_Get_Size_IMP(ObjHash *self) {
+    return self->size;
+}
+
+static void
+S_rebuild(ObjHash *self) {
+    uint32_t capacity = HashGroup_rebuild_capacity(self->size, self->capacity);
+    if (capacity == 0) {
+        THROW(ERR, "ObjHash grew too large");
+    }
+
+    void     *old_entries  = self->entries;
+    uint32_t  old_capacity = self->capacity;
+
+    S_alloc_table(self, capacity);
+    HashGroup_rehash(self->entries, capacity, old_entries, old_capacity,
+                     sizeof(ObjHashEntry), SI_entry_hash_sum, NULL);
+    HashGroup_free_table(self, old_entries, old_capacity,
+                         sizeof(ObjHashEntry));
+}
+
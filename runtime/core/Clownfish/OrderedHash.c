@@ -0,0 +1,371 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define C_CFISH_ORDEREDHASH
+#define CFISH_USE_SHORT_NAMES
+
+#include <string.h>
+
+#include "Clownfish/Class.h"
+
+#include "Clownfish/OrderedHash.h"
+#include "Clownfish/String.h"
+#include "Clownfish/Err.h"
+#include "Clownfish/VArray.h"
+#include "Clownfish/Util/Memory.h"
+
+// Entries are appended in insertion order.  Deleting an entry leaves a hole
+// with a NULL key until the next rebuild compacts the array.
+typedef struct OrdHashEntry {
+    String *key;
+    Obj    *value;
+} OrdHashEntry;
+
+// Each slot of the index table holds the position of an entry, or one of
+// the following markers.  Slots are as narrow as the number of entries
+// allows.  A deleted entry's slot becomes a dummy, which keeps probe
+// sequences through it intact.
+#define IX_EMPTY  -1
+#define IX_DUMMY  -2
+
+#define MIN_CAPACITY        8
+#define MAX_INT8_CAPACITY   128
+#define MAX_INT16_CAPACITY  32768
+
+static CFISH_INLINE size_t
+SI_ix_width(uint32_t capacity) {
+    return capacity <= MAX_INT8_CAPACITY  ? sizeof(int8_t)
+           : capacity <= MAX_INT16_CAPACITY ? sizeof(int16_t)
+           : sizeof(int32_t);
+}
+
+static CFISH_INLINE int32_t
+SI_get_ix(OrderedHash *self, size_t slot) {
+    if (self->capacity <= MAX_INT8_CAPACITY) {
+        return ((int8_t*)self->index)[slot];
+    }
+    else if (self->capacity <= MAX_INT16_CAPACITY) {
+        return ((int16_t*)self->index)[slot];
+    }
+    else {
+        return ((int32_t*)self->index)[slot];
+    }
+}
+
+static CFISH_INLINE void
+SI_set_ix(OrderedHash *self, size_t slot, int32_t ix) {
+    if (self->capacity <= MAX_INT8_CAPACITY) {
+        ((int8_t*)self->index)[slot] = (int8_t)ix;
+    }
+    else if (self->capacity <= MAX_INT16_CAPACITY) {
+        ((int16_t*)self->index)[slot] = (int16_t)ix;
+    }
+    else {
+        ((int32_t*)self->index)[slot] = ix;
+    }
+}
+
+// Two thirds of the slots may be taken, so probe sequences stay short.
+static CFISH_INLINE uint32_t
+SI_usable(uint32_t capacity) {
+    return (uint32_t)(((uint64_t)capacity * 2) / 3);
+}
+
+static uint32_t
+S_capacity_for(uint32_t num_entries) {
+    uint32_t capacity = MIN_CAPACITY;
+    while (SI_usable(capacity) < num_entries) {
+        capacity *= 2;
+    }
+    return capacity;
+}
+
+// Return the size of the block which holds the index and the entries of a
+// table with `capacity` slots.
+static CFISH_INLINE size_t
+SI_table_size(uint32_t capacity) {
+    return capacity * SI_ix_width(capacity)
+           + SI_usable(capacity) * sizeof(OrdHashEntry);
+}
+
+// Allocate the index table and the entries in a single block.  All index
+// slots start out as IX_EMPTY.
+static void
+S_alloc_table(OrderedHash *self, uint32_t capacity) {
+    size_t index_size = capacity * SI_ix_width(capacity);
+    size_t usable     = SI_usable(capacity);
+    char  *block      = (char*)Memory_owned_malloc(self, MEMORY_HASH,
+                                                   SI_table_size(capacity));
+    memset(block, 0xFF, index_size);
+    self->index    = block;
+    self->entries  = block + index_size;
+    self->capacity = capacity;
+    self->usable   = (uint32_t)usable;
+    self->num_used = 0;
+}
+
+// Return the position of the entry for `key`, or -1 if there is none.  If
+// `slot_ptr` is not NULL, it receives the slot which holds the key, or the
+// slot where the key should be inserted.
+static int32_t
+S_lookup(OrderedHash *self, String *key, int32_t hash_sum, size_t *slot_ptr) {
+    OrdHashEntry *const entries = (OrdHashEntry*)self->entries;
+    const size_t mask      = self->capacity - 1;
+    size_t       slot      = (uint32_t)hash_sum & mask;
+    size_t       free_slot = SIZE_MAX;
+
+    // Triangular probing visits every slot of a power-of-two table.
+    for (size_t step = 1; ; step++) {
+        int32_t ix = SI_get_ix(self, slot);
+        if (ix == IX_EMPTY) {
+            if (slot_ptr) {
+                *slot_ptr = free_slot != SIZE_MAX ? free_slot : slot;
+            }
+            return -1;
+        }
+        else if (ix == IX_DUMMY) {
+            if (free_slot == SIZE_MAX) { free_slot = slot; }
+        }
+        else {
+            String *entry_key = entries[ix].key;
+            if (entry_key == key
+                || (Str_Hash_Sum(entry_key) == hash_sum
+                    && Str_Equals(entry_key, (Obj*)key))
+               ) {
+                if (slot_ptr) { *slot_ptr = slot; }
+                return ix;
+            }
+        }
+        slot = (slot + step) & mask;
+    }
+}
+
+// Return the first empty slot in the probe sequence for `hash_sum`.  Only
+// valid when the table has no dummies.
+static CFISH_INLINE size_t
+SI_find_empty(OrderedHash *self, int32_t hash_sum) {
+    const size_t mask = self->capacity - 1;
+    size_t       slot = (uint32_t)hash_sum & mask;
+    for (size_t step = 1; SI_get_ix(self, slot) != IX_EMPTY; step++) {
+        slot = (slot + step) & mask;
+    }
+    return slot;
+}
+
+// Move the live entries into a fresh table with room for at least as many
+// again, dropping holes and dummies.  If deletions left many holes, the new
+// table may be smaller.
+static void
+S_rebuild(OrderedHash *self) {
+    if (self->size >= INT32_MAX / 4) {
+        THROW(ERR, "OrderedHash too large");
+    }
+
+    void         *old_index    = self->index;
+    OrdHashEntry *old_entries  = (OrdHashEntry*)self->entries;
+    uint32_t      old_num_used = self->num_used;
+    uint32_t      old_capacity = self->capacity;
+
+    S_alloc_table(self, S_capacity_for(self->size * 2 + 1));
+    OrdHashEntry *entries = (OrdHashEntry*)self->entries;
+    uint32_t      ix      = 0;
+    for (uint32_t i = 0; i < old_num_used; i++) {
+        if (!old_entries[i].key) { continue; }
+        entries[ix] = old_entries[i];
+        SI_set_ix(self, SI_find_empty(self, Str_Hash_Sum(entries[ix].key)),
+                  (int32_t)ix);
+        ix++;
+    }
+    self->num_used = ix;
+
+    Memory_owned_free(self, MEMORY_HASH, old_index,
+                      SI_table_size(old_capacity));
+}
+
+OrderedHash*
+OrdHash_new(uint32_t capacity) {
+    OrderedHash *self = (OrderedHash*)Class_Make_Obj(ORDEREDHASH);
+    return OrdHash_init(self, capacity);
+}
+
+OrderedHash*
+OrdHash_init(OrderedHash *self, uint32_t capacity) {
+    uint32_t requested_capacity = capacity < INT32_MAX / 4
+                                  ? capacity : INT32_MAX / 4;
+    self->size = 0;
+    S_alloc_table(self, S_capacity_for(requested_capacity));
+    return self;
+}
+
+void
+OrdHash_Destroy_IMP(OrderedHash *self) {
+    if (self->index) {
+        OrdHash_Clear(self);
+        Memory_owned_free(self, MEMORY_HASH, self->index,
+                          SI_table_size(self->capacity));
+    }
+    SUPER_DESTROY(self, ORDEREDHASH);
+}
+
+void
+OrdHash_Clear_IMP(OrderedHash *self) {
+    OrdHashEntry *const entries = (OrdHashEntry*)self->entries;
+    for (uint32_t i = 0; i < self->num_used; i++) {
+        if (!entries[i].key) { continue; }
+        DECREF(entries[i].key);
+        DECREF(entries[i].value);
+    }
+    memset(self->index, 0xFF, self->capacity * SI_ix_width(self->capacity));
+    self->num_used = 0;
+    self->size     = 0;
+}
+
+static void
+S_do_store(OrderedHash *self, String *key, Obj *value) {
+    int32_t hash_sum = Str_Hash_Sum(key);
+    size_t  slot;
+    int32_t ix = S_lookup(self, key, hash_sum, &slot);
+    if (ix >= 0) {
+        OrdHashEntry *entry = (OrdHashEntry*)self->entries + ix;
+        DECREF(entry->value);
+        entry->value = value;
+        return;
+    }
+
+    if (self->num_used >= self->usable) {
+        S_rebuild(self);
+        slot = SI_find_empty(self, hash_sum);
+    }
+    OrdHashEntry *entry = (OrdHashEntry*)self->entries + self->num_used;
+    entry->key   = (String*)INCREF(key);
+    entry->value = value;
+    SI_set_ix(self, slot, (int32_t)self->num_used);
+    self->num_used++;
+    self->size++;
+}
+
+void
+OrdHash_Store_IMP(OrderedHash *self, String *key, Obj *value) {
+    S_do_store(self, key, value);
+}
+
+void
+OrdHash_Store_Utf8_IMP(OrderedHash *self, const char *key, size_t key_len,
+                       Obj *value) {
+    StackString *key_buf = SSTR_WRAP_UTF8((char*)key, key_len);
+    S_do_store(self, (String*)key_buf, value);
+}
+
+Obj*
+OrdHash_Fetch_IMP(OrderedHash *self, String *key) {
+    int32_t ix = S_lookup(self, key, Str_Hash_Sum(key), NULL);
+    return ix >= 0 ? ((OrdHashEntry*)self->entries)[ix].value : NULL;
+}
+
+Obj*
+OrdHash_Fetch_Utf8_IMP(OrderedHash *self, const char *key, size_t key_len) {
+    StackString *key_buf = SSTR_WRAP_UTF8(key, key_len);
+    return OrdHash_Fetch_IMP(self, (String*)key_buf);
+}
+
+Obj*
+OrdHash_Delete_IMP(OrderedHash *self, String *key) {
+    size_t  slot;
+    int32_t ix = S_lookup(self, key, Str_Hash_Sum(key), &slot);
+    if (ix < 0) { return NULL; }
+
+    OrdHashEntry *entry = (OrdHashEntry*)self->entries + ix;
+    Obj *value = entry->value;
+    DECREF(entry->key);
+    entry->key   = NULL;
+    entry->value = NULL;
+    SI_set_ix(self, slot, IX_DUMMY);
+    self->size--;
+
+    // Once the hash is empty, start over at the beginning of the table.
+    if (self->size == 0) {
+        OrdHash_Clear(self);
+    }
+    return value;
+}
+
+Obj*
+OrdHash_Delete_Utf8_IMP(OrderedHash *self, const char *key, size_t key_len) {
+    StackString *key_buf = SSTR_WRAP_UTF8(key, key_len);
+    return OrdHash_Delete_IMP(self, (String*)key_buf);
+}
+
+VArray*
+OrdHash_Keys_IMP(OrderedHash *self) {
+    OrdHashEntry *const entries = (OrdHashEntry*)self->entries;
+    VArray *keys = VA_new(self->size);
+    for (uint32_t i = 0; i < self->num_used; i++) {
+        if (entries[i].key) { VA_Push(keys, INCREF(entries[i].key)); }
+    }
+    return keys;
+}
+
+VArray*
+OrdHash_Values_IMP(OrderedHash *self) {
+    OrdHashEntry *const entries = (OrdHashEntry*)self->entries;
+    VArray *values = VA_new(self->size);
+    for (uint32_t i = 0; i < self->num_used; i++) {
+        if (entries[i].key) { VA_Push(values, INCREF(entries[i].value)); }
+    }
+    return values;
+}
+
+void
+OrdHash_Each_IMP(OrderedHash *self, Hash_Visitor_t visit, void *context) {
+    OrdHashEntry *const entries = (OrdHashEntry*)self->entries;
+    for (uint32_t i = 0; i < self->num_used; i++) {
+        if (!entries[i].key) { continue; }
+        if (!visit(context, entries[i].key, entries[i].value)) { return; }
+        if (self->entries != entries) {
+            THROW(ERR, "OrderedHash modified during iteration.");
+        }
+    }
+}
+
+uint32_t
+OrdHash_Get_Capacity_IMP(OrderedHash *self) {
+    return self->capacity;
+}
+
+uint32_t
+OrdHash_Get_Size_IMP(OrderedHash *self) {
+    return self->size;
+}
+
+bool
+OrdHash_Equals_IMP(OrderedHash *self, Obj *other) {
+    OrderedHash *twin = (OrderedHash*)other;
+
+    if (twin == self)                  { return true; }
+    if (!Obj_Is_A(other, ORDEREDHASH)) { return false; }
+    if (self->size != twin->size)      { return false; }
+
+    OrdHashEntry *const entries = (OrdHashEntry*)self->entries;
+    for (uint32_t i = 0; i < self->num_used; i++) {
+        if (!entries[i].key) { continue; }
+        Obj *other_val = OrdHash_Fetch(twin, entries[i].key);
+        if (!other_val || !Obj_Equals(other_val, entries[i].value)) {
+            return false;
+        }
+    }
+    return true;
+}
+
@@ -0,0 +1,643 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define C_CFISH_PERSISTENTHASH
+#define CFISH_USE_SHORT_NAMES
+
+#include <string.h>
+
+#include "Clownfish/Class.h"
+
+#include "Clownfish/PersistentHash.h"
+#include "Clownfish/Hash.h"
+#include "Clownfish/String.h"
+#include "Clownfish/Err.h"
+#include "Clownfish/VArray.h"
+#include "Clownfish/Util/Atomic.h"
+#include "Clownfish/Util/Memory.h"
+
+// Each level of the trie consumes this many bits of the hash sum.  Nodes at
+// a shift of PHASH_MAX_SHIFT or more have run out of bits.
+#define PHASH_BITS       5
+#define PHASH_MASK       0x1F
+#define PHASH_MAX_SHIFT  32
+
+typedef struct PHashEntry {
+    String *key;
+    Obj    *value;
+} PHashEntry;
+
+// A node's entries are followed by pointers to its children, all in one
+// allocation.  Bit N of `datamap` or `nodemap` is set if the hash bits N at
+// the node's level lead to an entry or a child respectively, and entries and
+// children are stored in the order of their bits.  A node which has run out
+// of hash bits is a collision node: it has no children and holds entries
+// with identical hash sums in no particular order.
+//
+// Nodes are shared between versions and reference counted.  With
+// CFISH_ATOMIC_REFCOUNT, versions which share nodes may be derived and
+// destroyed on different threads, so the counts are updated atomically like
+// those of objects.  A node other than the root never holds a single entry
+// without children; such a node is folded into its parent, so that the shape
+// of the trie depends only on its contents.
+typedef struct PHashNode {
+    size_t   refcount;
+    uint32_t datamap;
+    uint32_t nodemap;
+    uint32_t num_entries;
+} PHashNode;
+
+static CFISH_INLINE uint32_t
+SI_popcount(uint32_t bits) {
+#if defined(__GNUC__)
+    return (uint32_t)__builtin_popcount(bits);
+#else
+    bits = bits - ((bits >> 1) & 0x55555555u);
+    bits = (bits & 0x33333333u) + ((bits >> 2) & 0x33333333u);
+    return (((bits + (bits >> 4)) & 0x0F0F0F0Fu) * 0x01010101u) >> 24;
+#endif
+}
+
+static CFISH_INLINE PHashEntry*
+SI_entries(PHashNode *node) {
+    return (PHashEntry*)(node + 1);
+}
+
+static CFISH_INLINE PHashNode**
+SI_children(PHashNode *node) {
+    return (PHashNode**)(SI_entries(node) + node->num_entries);
+}
+
+static CFISH_INLINE uint32_t
+SI_bit(int32_t hash_sum, uint32_t shift) {
+    return 1u << (((uint32_t)hash_sum >> shift) & PHASH_MASK);
+}
+
+// Return the position of `bit` among the bits set in `map`.
+static CFISH_INLINE uint32_t
+SI_index(uint32_t map, uint32_t bit) {
+    return SI_popcount(map & (bit - 1));
+}
+
+static CFISH_INLINE bool
+SI_key_matches(PHashEntry *entry, String *key, int32_t hash_sum) {
+    return Str_Hash_Sum(entry->key) == hash_sum
+           && Str_Equals(entry->key, (Obj*)key);
+}
+
+static CFISH_INLINE size_t
+SI_node_size(uint32_t nodemap, uint32_t num_entries) {
+    return sizeof(PHashNode)
+           + num_entries * sizeof(PHashEntry)
+           + SI_popcount(nodemap) * sizeof(PHashNode*);
+}
+
+// Nodes are shared between versions, which may be owned by different
+// regions, so they always live on the heap.
+static PHashNode*
+S_alloc_node(uint32_t datamap, uint32_t nodemap, uint32_t num_entries) {
+    size_t     size = SI_node_size(nodemap, num_entries);
+    PHashNode *node = (PHashNode*)Memory_tagged_malloc(MEMORY_HASH, size);
+    node->refcount    = 1;
+    node->datamap     = datamap;
+    node->nodemap     = nodemap;
+    node->num_entries = num_entries;
+    return node;
+}
+
+static CFISH_INLINE void
+SI_retain(PHashNode *node) {
+#ifdef CFISH_ATOMIC_REFCOUNT
+    Atomic_fetch_add_size(&node->refcount, 1);
+#else
+    node->refcount++;
+#endif
+}
+
+static void
+S_release(PHashNode *node) {
+#ifdef CFISH_ATOMIC_REFCOUNT
+    if (Atomic_fetch_add_size(&node->refcount, (size_t)-1) > 1) { return; }
+    Atomic_fence();
+#else
+    if (--node->refcount > 0) { return; }
+#endif
+
+    PHashEntry *entries      = SI_entries(node);
+    PHashNode **children     = SI_children(node);
+    uint32_t    num_children = SI_popcount(node->nodemap);
+    for (uint32_t i = 0; i < node->num_entries; i++) {
+        DECREF(entries[i].key);
+        DECREF(entries[i].value);
+    }
+    for (uint32_t i = 0; i < num_children; i++) {
+        S_release(children[i]);
+    }
+    Memory_tagged_free(MEMORY_HASH, node,
+                       SI_node_size(node->nodemap, node->num_entries));
+}
+
+// Copy `count` entries or children, which are now shared with the source.
+static void
+S_share_entries(PHashEntry *dest, PHashEntry *source, uint32_t count) {
+    for (uint32_t i = 0; i < count; i++) {
+        dest[i].key   = (String*)INCREF(source[i].key);
+        dest[i].value = INCREF(source[i].value);
+    }
+}
+
+static void
+S_share_children(PHashNode **dest, PHashNode **source, uint32_t count) {
+    for (uint32_t i = 0; i < count; i++) {
+        SI_retain(source[i]);
+        dest[i] = source[i];
+    }
+}
+
+static PHashNode*
+S_copy(PHashNode *node) {
+    PHashNode *copy = S_alloc_node(node->datamap, node->nodemap,
+                                   node->num_entries);
+    S_share_entries(SI_entries(copy), SI_entries(node), node->num_entries);
+    S_share_children(SI_children(copy), SI_children(node),
+                     SI_popcount(node->nodemap));
+    return copy;
+}
+
+// Return a copy of `node` with `entry` inserted at entry index `tick`.
+static PHashNode*
+S_copy_and_insert(PHashNode *node, uint32_t datamap, uint32_t tick,
+                  PHashEntry entry) {
+    PHashNode  *copy    = S_alloc_node(datamap, node->nodemap,
+                                       node->num_entries + 1);
+    PHashEntry *entries = SI_entries(copy);
+    S_share_entries(entries, SI_entries(node), tick);
+    entries[tick] = entry;
+    S_share_entries(entries + tick + 1, SI_entries(node) + tick,
+                    node->num_entries - tick);
+    S_share_children(SI_children(copy), SI_children(node),
+                     SI_popcount(node->nodemap));
+    return copy;
+}
+
+// Return a copy of a bitmap node with the entry for `bit` replaced by
+// `child`.
+static PHashNode*
+S_copy_entry_to_child(PHashNode *node, uint32_t bit, PHashNode *child) {
+    uint32_t    entry_tick = SI_index(node->datamap, bit);
+    uint32_t    nodemap    = node->nodemap | bit;
+    uint32_t    child_tick = SI_index(nodemap, bit);
+    uint32_t    num_kids   = SI_popcount(node->nodemap);
+    PHashNode  *copy       = S_alloc_node(node->datamap & ~bit, nodemap,
+                                          node->num_entries - 1);
+    PHashEntry *entries    = SI_entries(node);
+    PHashNode **children   = SI_children(node);
+    S_share_entries(SI_entries(copy), entries, entry_tick);
+    S_share_entries(SI_entries(copy) + entry_tick, entries + entry_tick + 1,
+                    node->num_entries - entry_tick - 1);
+    S_share_children(SI_children(copy), children, child_tick);
+    SI_children(copy)[child_tick] = child;
+    S_share_children(SI_children(copy) + child_tick + 1,
+                     children + child_tick, num_kids - child_tick);
+    return copy;
+}
+
+// Return a copy of a bitmap node with the child for `bit` replaced by the
+// single entry of `child`.
+static PHashNode*
+S_copy_child_to_entry(PHashNode *node, uint32_t bit, PHashNode *child) {
+    uint32_t    child_tick = SI_index(node->nodemap, bit);
+    uint32_t    datamap    = node->datamap | bit;
+    uint32_t    entry_tick = SI_index(datamap, bit);
+    uint32_t    num_kids   = SI_popcount(node->nodemap);
+    PHashNode  *copy       = S_alloc_node(datamap, node->nodemap & ~bit,
+                                          node->num_entries + 1);
+    PHashEntry *entries    = SI_entries(node);
+    PHashNode **children   = SI_children(node);
+    S_share_entries(SI_entries(copy), entries, entry_tick);
+    S_share_entries(SI_entries(copy) + entry_tick, SI_entries(child), 1);
+    S_share_entries(SI_entries(copy) + entry_tick + 1, entries + entry_tick,
+                    node->num_entries - entry_tick);
+    S_share_children(SI_children(copy), children, child_tick);
+    S_share_children(SI_children(copy) + child_tick,
+                     children + child_tick + 1, num_kids - child_tick - 1);
+    return copy;
+}
+
+// Return a copy of `node` without the entry at index `tick`.
+static PHashNode*
+S_copy_and_remove(PHashNode *node, uint32_t datamap, uint32_t tick) {
+    PHashNode  *copy    = S_alloc_node(datamap, node->nodemap,
+                                       node->num_entries - 1);
+    PHashEntry *entries = SI_entries(node);
+    S_share_entries(SI_entries(copy), entries, tick);
+    S_share_entries(SI_entries(copy) + tick, entries + tick + 1,
+                    node->num_entries - tick - 1);
+    S_share_children(SI_children(copy), SI_children(node),
+                     SI_popcount(node->nodemap));
+    return copy;
+}
+
+// Build the subtree holding two entries whose hash bits agree above
+// `shift`.  Takes ownership of the entries.
+static PHashNode*
+S_merge(PHashEntry a, int32_t hash_a, PHashEntry b, int32_t hash_b,
+        uint32_t shift) {
+    if (shift >= PHASH_MAX_SHIFT) {
+        PHashNode *node = S_alloc_node(0, 0, 2);
+        SI_entries(node)[0] = a;
+        SI_entries(node)[1] = b;
+        return node;
+    }
+
+    uint32_t bit_a = SI_bit(hash_a, shift);
+    uint32_t bit_b = SI_bit(hash_b, shift);
+    if (bit_a == bit_b) {
+        PHashNode *node = S_alloc_node(0, bit_a, 0);
+        SI_children(node)[0] = S_merge(a, hash_a, b, hash_b,
+                                       shift + PHASH_BITS);
+        return node;
+    }
+    else {
+        PHashNode *node = S_alloc_node(bit_a | bit_b, 0, 2);
+        SI_entries(node)[bit_a < bit_b ? 0 : 1] = a;
+        SI_entries(node)[bit_a < bit_b ? 1 : 0] = b;
+        return node;
+    }
+}
+
+// Return a new version of `node` with `value` stored under `key`.  Takes
+// ownership of `value`.  Sets `added` if `key` wasn't present.
+static PHashNode*
+S_store(PHashNode *node, String *key, int32_t hash_sum, Obj *value,
+        uint32_t shift, bool *added) {
+    PHashEntry *entries = SI_entries(node);
+
+    if (shift >= PHASH_MAX_SHIFT) {
+        for (uint32_t i = 0; i < node->num_entries; i++) {
+            if (Str_Equals(entries[i].key, (Obj*)key)) {
+                PHashNode *copy = S_copy(node);
+                DECREF(SI_entries(copy)[i].value);
+                SI_entries(copy)[i].value = value;
+                return copy;
+            }
+        }
+        PHashEntry entry = { (String*)INCREF(key), value };
+        *added = true;
+        return S_copy_and_insert(node, 0, node->num_entries, entry);
+    }
+
+    uint32_t bit = SI_bit(hash_sum, shift);
+    if (node->datamap & bit) {
+        uint32_t    tick     = SI_index(node->datamap, bit);
+        PHashEntry *existing = entries + tick;
+        if (SI_key_matches(existing, key, hash_sum)) {
+            PHashNode *copy = S_copy(node);
+            DECREF(SI_entries(copy)[tick].value);
+            SI_entries(copy)[tick].value = value;
+            return copy;
+        }
+        // Push both entries down a level.
+        PHashEntry moved = { (String*)INCREF(existing->key),
+                             INCREF(existing->value) };
+        PHashEntry entry = { (String*)INCREF(key), value };
+        PHashNode *child = S_merge(moved, Str_Hash_Sum(existing->key),
+                                   entry, hash_sum, shift + PHASH_BITS);
+        *added = true;
+        return S_copy_entry_to_child(node, bit, child);
+    }
+    else if (node->nodemap & bit) {
+        uint32_t   tick  = SI_index(node->nodemap, bit);
+        PHashNode *child = S_store(SI_children(node)[tick], key, hash_sum,
+                                   value, shift + PHASH_BITS, added);
+        PHashNode *copy  = S_copy(node);
+        S_release(SI_children(copy)[tick]);
+        SI_children(copy)[tick] = child;
+        return copy;
+    }
+    else {
+        PHashEntry entry = { (String*)INCREF(key), value };
+        *added = true;
+        return S_copy_and_insert(node, node->datamap | bit,
+                                 SI_index(node->datamap, bit), entry);
+    }
+}
+
+// Return a new version of `node` without `key`, or NULL if that would
+// leave the node empty.  Sets `found` if `key` was present; otherwise,
+// returns NULL.
+static PHashNode*
+S_delete(PHashNode *node, String *key, int32_t hash_sum, uint32_t shift,
+         bool *found) {
+    PHashEntry *entries = SI_entries(node);
+
+    if (shift >= PHASH_MAX_SHIFT) {
+        for (uint32_t i = 0; i < node->num_entries; i++) {
+            if (Str_Equals(entries[i].key, (Obj*)key)) {
+                *found = true;
+                return S_copy_and_remove(node, 0, i);
+            }
+        }
+        return NULL;
+    }
+
+    uint32_t bit = SI_bit(hash_sum, shift);
+    if (node->datamap & bit) {
+        uint32_t tick = SI_index(node->datamap, bit);
+        if (!SI_key_matches(entries + tick, key, hash_sum)) { return NULL; }
+        *found = true;
+        if (node->num_entries == 1 && !node->nodemap) { return NULL; }
+        return S_copy_and_remove(node, node->datamap & ~bit, tick);
+    }
+    else if (node->nodemap & bit) {
+        uint32_t   tick  = SI_index(node->nodemap, bit);
+        PHashNode *child = S_delete(SI_children(node)[tick], key, hash_sum,
+                                    shift + PHASH_BITS, found);
+        if (!*found) { return NULL; }
+
+        // A child always holds at least two entries, so one remains.
+        // Fold it into this node if it's the last.
+        PHashNode *copy;
+        if (child->num_entries == 1 && !child->nodemap) {
+            copy = S_copy_child_to_entry(node, bit, child);
+            S_release(child);
+        }
+        else {
+            copy = S_copy(node);
+            S_release(SI_children(copy)[tick]);
+            SI_children(copy)[tick] = child;
+        }
+        return copy;
+    }
+
+    return NULL;
+}
+
+static Obj*
+S_fetch(PHashNode *node, String *key, int32_t hash_sum) {
+    for (uint32_t shift = 0; node != NULL; shift += PHASH_BITS) {
+        PHashEntry *entries = SI_entries(node);
+        if (shift >= PHASH_MAX_SHIFT) {
+            for (uint32_t i = 0; i < node->num_entries; i++) {
+                if (Str_Equals(entries[i].key, (Obj*)key)) {
+                    return entries[i].value;
+                }
+            }
+            return NULL;
+        }
+
+        uint32_t bit = SI_bit(hash_sum, shift);
+        if (node->datamap & bit) {
+            PHashEntry *entry = entries + SI_index(node->datamap, bit);
+            return SI_key_matches(entry, key, hash_sum) ? entry->value : NULL;
+        }
+        else if (node->nodemap & bit) {
+            node = SI_children(node)[SI_index(node->nodemap, bit)];
+        }
+        else {
+            return NULL;
+        }
+    }
+    return NULL;
+}
+
+// Visit the entries below `node`.  Return false if the visitor stopped the
+// iteration.
+static bool
+S_each(PHashNode *node, Hash_Visitor_t visit, void *context) {
+    PHashEntry *entries      = SI_entries(node);
+    PHashNode **children     = SI_children(node);
+    uint32_t    num_children = SI_popcount(node->nodemap);
+    for (uint32_t i = 0; i < node->num_entries; i++) {
+        if (!visit(context, entries[i].key, entries[i].value)) {
+            return false;
+        }
+    }
+    for (uint32_t i = 0; i < num_children; i++) {
+        if (!S_each(children[i], visit, context)) { return false; }
+    }
+    return true;
+}
+
+static bool
+S_node_equals(PHashNode *node, PHashNode *other, uint32_t shift) {
+    if (node == other) { return true; }
+    if (node->datamap != other->datamap
+        || node->nodemap != other->nodemap
+        || node->num_entries != other->num_entries
+       ) {
+        return false;
+    }
+
+    PHashEntry *entries = SI_entries(node);
+    PHashEntry *other_entries = SI_entries(other);
+    if (shift >= PHASH_MAX_SHIFT) {
+        // Collision nodes are unordered.
+        for (uint32_t i = 0; i < node->num_entries; i++) {
+            uint32_t j = 0;
+            while (!Str_Equals(entries[i].key, (Obj*)other_entries[j].key)) {
+                if (++j == other->num_entries) { return false; }
+            }
+            if (!Obj_Equals(entries[i].value, other_entries[j].value)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // The shape of the trie depends only on its contents, so entries and
+    // children can be compared pairwise.
+    for (uint32_t i = 0; i < node->num_entries; i++) {
+        if (!Str_Equals(entries[i].key, (Obj*)other_entries[i].key)
+            || !Obj_Equals(entries[i].value, other_entries[i].value)
+           ) {
+            return false;
+        }
+    }
+    PHashNode **children       = SI_children(node);
+    PHashNode **other_children = SI_children(other);
+    uint32_t    num_children   = SI_popcount(node->nodemap);
+    for (uint32_t i = 0; i < num_children; i++) {
+        if (!S_node_equals(children[i], other_children[i],
+                           shift + PHASH_BITS)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static PersistentHash*
+S_new_version(PHashNode *root, uint32_t size) {
+    PersistentHash *self
+        = (PersistentHash*)Class_Make_Obj(PERSISTENTHASH);
+    self->root = root;
+    self->size = size;
+    return self;
+}
+
+PersistentHash*
+PHash_new() {
+    PersistentHash *self = (PersistentHash*)Class_Make_Obj(PERSISTENTHASH);
+    return PHash_init(self);
+}
+
+PersistentHash*
+PHash_init(PersistentHash *self) {
+    self->root = NULL;
+    self->size = 0;
+    return self;
+}
+
+static bool
+S_store_visitor(void *context, String *key, Obj *value) {
+    PersistentHash **version = (PersistentHash**)context;
+    PersistentHash  *next    = PHash_Store(*version, key, INCREF(value));
+    DECREF(*version);
+    *version = next;
+    return true;
+}
+
+PersistentHash*
+PHash_from_hash(Hash *hash) {
+    PersistentHash *self = PHash_new();
+    Hash_Each(hash, S_store_visitor, &self);
+    return self;
+}
+
+void
+PHash_Destroy_IMP(PersistentHash *self) {
+    if (self->root) { S_release((PHashNode*)self->root); }
+    SUPER_DESTROY(self, PERSISTENTHASH);
+}
+
+PersistentHash*
+PHash_Store_IMP(PersistentHash *self, String *key, Obj *value) {
+    int32_t hash_sum = Str_Hash_Sum(key);
+    if (!self->root) {
+        PHashNode *root = S_alloc_node(SI_bit(hash_sum, 0), 0, 1);
+        SI_entries(root)[0].key   = (String*)INCREF(key);
+        SI_entries(root)[0].value = value;
+        return S_new_version(root, 1);
+    }
+
+    bool       added = false;
+    PHashNode *root  = S_store((PHashNode*)self->root, key, hash_sum, value,
+                               0, &added);
+    return S_new_version(root, added ? self->size + 1 : self->size);
+}
+
+PersistentHash*
+PHash_Store_Utf8_IMP(PersistentHash *self, const char *key, size_t key_len,
+                     Obj *value) {
+    StackString *key_buf = SSTR_WRAP_UTF8(key, key_len);
+    return PHash_Store_IMP(self, (String*)key_buf, value);
+}
+
+PersistentHash*
+PHash_Delete_IMP(PersistentHash *self, String *key) {
+    bool found = false;
+    PHashNode *root = self->root
+                      ? S_delete((PHashNode*)self->root, key,
+                                 Str_Hash_Sum(key), 0, &found)
+                      : NULL;
+    if (!found) {
+        if (self->root) { SI_retain((PHashNode*)self->root); }
+        return S_new_version((PHashNode*)self->root, self->size);
+    }
+    return S_new_version(root, self->size - 1);
+}
+
+PersistentHash*
+PHash_Delete_Utf8_IMP(PersistentHash *self, const char *key,
+                      size_t key_len) {
+    StackString *key_buf = SSTR_WRAP_UTF8(key, key_len);
+    return PHash_Delete_IMP(self, (String*)key_buf);
+}
+
+Obj*
+PHash_Fetch_IMP(PersistentHash *self, String *key) {
+    return S_fetch((PHashNode*)self->root, key, Str_Hash_Sum(key));
+}
+
+Obj*
+PHash_Fetch_Utf8_IMP(PersistentHash *self, const char *key, size_t key_len) {
+    StackString *key_buf = SSTR_WRAP_UTF8(key, key_len);
+    return PHash_Fetch_IMP(self, (String*)key_buf);
+}
+
+void
+PHash_Each_IMP(PersistentHash *self, Hash_Visitor_t visit, void *context) {
+    if (self->root) { S_each((PHashNode*)self->root, visit, context); }
+}
+
+static bool
+S_push_key(void *context, String *key, Obj *value) {
+    UNUSED_VAR(value);
+    VA_Push((VArray*)context, INCREF(key));
+    return true;
+}
+
+static bool
+S_push_value(void *context, String *key, Obj *value) {
+    UNUSED_VAR(key);
+    VA_Push((VArray*)context, INCREF(value));
+    return true;
+}
+
+static bool
+S_hash_store(void *context, String *key, Obj *value) {
+    Hash_Store((Hash*)context, key, INCREF(value));
+    return true;
+}
+
+VArray*
+PHash_Keys_IMP(PersistentHash *self) {
+    VArray *keys = VA_new(self->size);
+    PHash_Each_IMP(self, S_push_key, keys);
+    return keys;
+}
+
+VArray*
+PHash_Values_IMP(PersistentHash *self) {
+    VArray *values = VA_new(self->size);
+    PHash_Each_IMP(self, S_push_value, values);
+    return values;
+}
+
+Hash*
+PHash_To_Hash_IMP(PersistentHash *self) {
+    Hash *hash = Hash_new(self->size);
+    PHash_Each_IMP(self, S_hash_store, hash);
+    return hash;
+}
+
+uint32_t
+PHash_Get_Size_IMP(PersistentHash *self) {
+    return self->size;
+}
+
+bool
+PHash_Equals_IMP(PersistentHash *self, Obj *other) {
+    PersistentHash *twin = (PersistentHash*)other;
+
+    if (twin == self)                     { return true; }
+    if (!Obj_Is_A(other, PERSISTENTHASH)) { return false; }
+    if (self->size != twin->size)         { return false; }
+    if (!self->size)                      { return true; }
+
+    return S_node_equals((PHashNode*)self->root, (PHashNode*)twin->root, 0);
+}
+
@@ -30,6 +30,7 @@
 
 #include "Clownfish/CharBuf.h"
 #include "Clownfish/Err.h"
+#include "Clownfish/Util/HashUtils.h"
 #include "Clownfish/Util/Memory.h"
 #include "Clownfish/Util/StringHelper.h"
 
@@ -48,17 +49,45 @@ static void
 S_die_invalid_utf8(const char *text, size_t size, const char *file, int line,
                    const char *func);
 
+// Strings of up to STR_MAX_INLINE_SIZE bytes store their characters right
+// after the struct, so that they take a single allocation.
+static CFISH_INLINE size_t
+SI_inline_alloc_size(size_t size) {
+    return sizeof(String) + size + 1;
+}
+
+// Create a String with room for `size` bytes of characters in the same
+// allocation.  The caller fills in the characters.
+static String*
+S_new_inline(size_t size) {
+    void   *allocation = Memory_obj_alloc(SI_inline_alloc_size(size));
+    String *self       = (String*)Class_Init_Obj(STRING, allocation);
+    if (Class_census_enabled) { Class_census_add((Obj*)self); }
+    char *ptr = (char*)self + sizeof(String);
+    ptr[size] = '\0'; // Null terminate.
+    self->ptr       = ptr;
+    self->size      = size;
+    self->origin    = self;
+    self->hash_sum  = 0;
+    self->is_inline = true;
+    return self;
+}
+
 String*
 Str_new_from_utf8(const char *utf8, size_t size) {
     if (!StrHelp_utf8_valid(utf8, size)) {
         DIE_INVALID_UTF8(utf8, size);
     }
-    String *self = (String*)Class_Make_Obj(STRING);
-    return Str_init_from_trusted_utf8(self, utf8, size);
+    return Str_new_from_trusted_utf8(utf8, size);
 }
 
 String*
 Str_new_from_trusted_utf8(const char *utf8, size_t size) {
+    if (size <= STR_MAX_INLINE_SIZE) {
+        String *self = S_new_inline(size);
+        memcpy((char*)self->ptr, utf8, size);
+        return self;
+    }
     String *self = (String*)Class_Make_Obj(STRING);
     return Str_init_from_trusted_utf8(self, utf8, size);
 }
@@ -66,16 +95,18 @@ Str_new_from_trusted_utf8(const char *utf8, size_t size) {
 String*
 Str_init_from_trusted_utf8(String *self, const char *utf8, size_t size) {
     // Allocate.
-    char *ptr = (char*)MALLOCATE(size + 1);
+    char *ptr = (char*)Memory_owned_malloc(self, MEMORY_STRING, size + 1);
 
     // Copy.
     memcpy(ptr, utf8, size);
     ptr[size] = '\0'; // Null terminate.
 
     // Assign.
-    self->ptr    = ptr;
-    self->size   = size;
-    self->origin = self;
+    self->ptr       = ptr;
+    self->size      = size;
+    self->origin    = self;
+    self->hash_sum  = 0;
+    self->is_inline = false;
 
     return self;
 }
@@ -97,9 +128,12 @@ Str_new_steal_trusted_utf8(char *utf8, size_t size) {
 
 String*
 Str_init_steal_trusted_utf8(String *self, char *utf8, size_t size) {
-    self->ptr    = utf8;
-    self->size   = size;
-    self->origin = self;
+    self->ptr       = (char*)Memory_owned_adopt(self, MEMORY_STRING, utf8,
+                                                size, size + 1);
+    self->size      = size;
+    self->origin    = self;
+    self->hash_sum  = 0;
+    self->is_inline = false;
     return self;
 }
 
@@ -120,24 +154,19 @@ Str_new_wrap_trusted_utf8(const char *utf8, size_t size) {
 
 String*
 Str_init_wrap_trusted_utf8(String *self, const char *ptr, size_t size) {
-    self->ptr    = ptr;
-    self->size   = size;
-    self->origin = NULL;
+    self->ptr       = ptr;
+    self->size      = size;
+    self->origin    = NULL;
+    self->hash_sum  = 0;
+    self->is_inline = false;
     return self;
 }
 
 String*
 Str_new_from_char(int32_t code_point) {
-    const size_t MAX_UTF8_BYTES = 4;
-    char   *ptr  = (char*)MALLOCATE(MAX_UTF8_BYTES + 1);
-    size_t  size = StrHelp_encode_utf8_char(code_point, (uint8_t*)ptr);
-    ptr[size] = '\0';
-
-    String *self = (String*)Class_Make_Obj(STRING);
-    self->ptr    = ptr;
-    self->size   = size;
-    self->origin = self;
-    return self;
+    char    buf[4]; // Maximum length of a UTF-8 sequence.
+    size_t  size = StrHelp_encode_utf8_char(code_point, (uint8_t*)buf);
+    return Str_new_from_trusted_utf8(buf, size);
 }
 
 String*
@@ -154,18 +183,18 @@ Str_newf(const char *pattern, ...) {
 
 static String*
 S_new_substring(String *string, size_t byte_offset, size_t size) {
-    String *self = (String*)Class_Make_Obj(STRING);
-
     if (string->origin == NULL) {
         // Copy substring of wrapped strings.
-        Str_init_from_trusted_utf8(self, string->ptr + byte_offset, size);
-    }
-    else {
-        self->ptr    = string->ptr + byte_offset;
-        self->size   = size;
-        self->origin = (String*)INCREF(string->origin);
+        return Str_new_from_trusted_utf8(string->ptr + byte_offset, size);
     }
 
+    // Share the characters of the origin, even if they are stored inline.
+    String *self = (String*)Class_Make_Obj(STRING);
+    self->ptr       = string->ptr + byte_offset;
+    self->size      = size;
+    self->origin    = (String*)INCREF(string->origin);
+    self->hash_sum  = 0;
+    self->is_inline = false;
     return self;
 }
 
@@ -176,8 +205,15 @@ Str_Is_Copy_On_IncRef_IMP(String *self) {
 
 void
 Str_Destroy_IMP(String *self) {
+    if (self->is_inline) {
+        // Obj_Destroy would only free the size of the struct.
+        if (Class_census_enabled) { Class_census_remove((Obj*)self); }
+        Memory_obj_free(self, SI_inline_alloc_size(self->size));
+        return;
+    }
     if (self->origin == self) {
-        FREEMEM((char*)self->ptr);
+        Memory_owned_free(self, MEMORY_STRING, (char*)self->ptr,
+                          self->size + 1);
     }
     else {
         DECREF(self->origin);
@@ -187,17 +223,18 @@ Str_Destroy_IMP(String *self) {
 
 int32_t
 Str_Hash_Sum_IMP(String *self) {
-    uint32_t hashvalue = 5381;
-    StackStringIterator *iter = STR_STACKTOP(self);
-
-    const SStrIter_Next_t next
-        = METHOD_PTR(STACKSTRINGITERATOR, CFISH_SStrIter_Next);
-    int32_t code_point;
-    while (STRITER_DONE != (code_point = next(iter))) {
-        hashvalue = ((hashvalue << 5) + hashvalue) ^ code_point;
+    // Strings are immutable, so the hash sum is computed once and cached.
+    // Racing threads always compute and store the same value, so the
+    // unsynchronized cache is safe even for strings shared across threads,
+    // like the names of immortal Classes.
+    int32_t hash_sum = self->hash_sum;
+    if (hash_sum == 0) {
+        hash_sum = HashUtil_hash_sum(self->ptr, self->size);
+        // Reserve 0 to mean "not yet computed".
+        if (hash_sum == 0) { hash_sum = 1; }
+        self->hash_sum = hash_sum;
     }
-
-    return (int32_t) hashvalue;
+    return hash_sum;
 }
 
 static void
@@ -293,7 +330,7 @@ Str_To_F64_IMP(String *self) {
 
 char*
 Str_To_Utf8_IMP(String *self) {
-    char *buf = (char*)malloc(self->size + 1);
+    char *buf = (char*)MALLOCATE(self->size + 1);
     memcpy(buf, self->ptr, self->size);
     buf[self->size] = '\0'; // NULL-terminate.
     return buf;
@@ -319,13 +356,26 @@ Str_Cat_Utf8_IMP(String *self, const char* ptr, size_t size) {
 
 String*
 Str_Cat_Trusted_Utf8_IMP(String *self, const char* ptr, size_t size) {
-    size_t  result_size = self->size + size;
-    char   *result_ptr  = (char*)MALLOCATE(result_size + 1);
+    size_t result_size = self->size + size;
+    if (result_size <= STR_MAX_INLINE_SIZE) {
+        String *result = S_new_inline(result_size);
+        memcpy((char*)result->ptr, self->ptr, self->size);
+        memcpy((char*)result->ptr + self->size, ptr, size);
+        return result;
+    }
+
+    String *result     = (String*)Class_Make_Obj(STRING);
+    char   *result_ptr = (char*)Memory_owned_malloc(result, MEMORY_STRING,
+                                                    result_size + 1);
     memcpy(result_ptr, self->ptr, self->size);
     memcpy(result_ptr + self->size, ptr, size);
     result_ptr[result_size] = '\0';
-    String *result = (String*)Class_Make_Obj(STRING);
-    return Str_init_steal_trusted_utf8(result, result_ptr, result_size);
+    result->ptr       = result_ptr;
+    result->size      = result_size;
+    result->origin    = result;
+    result->hash_sum  = 0;
+    result->is_inline = false;
+    return result;
 }
 
 bool
@@ -543,9 +593,11 @@ SStr_new_from_str(void *allocation, size_t alloc_size, String *string) {
     ptr[size] = '\0';
 
     StackString *self = (StackString*)Class_Init_Obj(STACKSTRING, allocation);
-    self->ptr    = ptr;
-    self->size   = size;
-    self->origin = NULL;
+    self->ptr       = ptr;
+    self->size      = size;
+    self->origin    = NULL;
+    self->hash_sum  = string->hash_sum;
+    self->is_inline = false;
     return self;
 }
 
@@ -553,15 +605,19 @@ StackString*
 SStr_wrap_str(void *allocation, const char *ptr, size_t size) {
     StackString *self
         = (StackString*)Class_Init_Obj(STACKSTRING, allocation);
-    self->size   = size;
-    self->ptr    = ptr;
-    self->origin = NULL;
+    self->size      = size;
+    self->ptr       = ptr;
+    self->origin    = NULL;
+    self->hash_sum  = 0;
+    self->is_inline = false;
     return self;
 }
 
 StackString*
 SStr_wrap(void *allocation, String *source) {
-    return SStr_wrap_str(allocation, source->ptr, source->size);
+    StackString *self = SStr_wrap_str(allocation, source->ptr, source->size);
+    self->hash_sum = source->hash_sum;
+    return self;
 }
 
 size_t
@@ -25,15 +25,22 @@
 #include "Clownfish/Test/TestByteBuf.h"
 #include "Clownfish/Test/TestString.h"
 #include "Clownfish/Test/TestCharBuf.h"
+#include "Clownfish/Test/TestConcurrentHash.h"
 #include "Clownfish/Test/TestErr.h"
 #include "Clownfish/Test/TestHash.h"
 #include "Clownfish/Test/TestHashIterator.h"
+#include "Clownfish/Test/TestHashSet.h"
+#include "Clownfish/Test/TestI64Hash.h"
 #include "Clownfish/Test/TestLockFreeRegistry.h"
 #include "Clownfish/Test/TestNum.h"
 #include "Clownfish/Test/TestObj.h"
+#include "Clownfish/Test/TestObjHash.h"
+#include "Clownfish/Test/TestOrderedHash.h"
+#include "Clownfish/Test/TestPersistentHash.h"
 #include "Clownfish/Test/TestThreads.h"
 #include "Clownfish/Test/TestVArray.h"
 #include "Clownfish/Test/Util/TestAtomic.h"
+#include "Clownfish/Test/Util/TestHashUtils.h"
 #include "Clownfish/Test/Util/TestMemory.h"
 #include "Clownfish/Test/Util/TestNumberUtils.h"
 #include "Clownfish/Test/Util/TestStringHelper.h"
@@ -45,6 +52,12 @@ Test_create_test_suite() {
     TestSuite_Add_Batch(suite, (TestBatch*)TestVArray_new());
     TestSuite_Add_Batch(suite, (TestBatch*)TestHash_new());
     TestSuite_Add_Batch(suite, (TestBatch*)TestHashIterator_new());
+    TestSuite_Add_Batch(suite, (TestBatch*)TestHashSet_new());
+    TestSuite_Add_Batch(suite, (TestBatch*)TestObjHash_new());
+    TestSuite_Add_Batch(suite, (TestBatch*)TestI64Hash_new());
+    TestSuite_Add_Batch(suite, (TestBatch*)TestPersistentHash_new());
+    TestSuite_Add_Batch(suite, (TestBatch*)TestOrderedHash_new());
+    TestSuite_Add_Batch(suite, (TestBatch*)TestConcurrentHash_new());
     TestSuite_Add_Batch(suite, (TestBatch*)TestObj_new());
     TestSuite_Add_Batch(suite, (TestBatch*)TestErr_new());
     TestSuite_Add_Batch(suite, (TestBatch*)TestBB_new());
@@ -53,6 +66,7 @@ Test_create_test_suite() {
     TestSuite_Add_Batch(suite, (TestBatch*)TestNumUtil_new());
     TestSuite_Add_Batch(suite, (TestBatch*)TestNum_new());
     TestSuite_Add_Batch(suite, (TestBatch*)TestStrHelp_new());
+    TestSuite_Add_Batch(suite, (TestBatch*)TestHashUtil_new());
     TestSuite_Add_Batch(suite, (TestBatch*)TestAtomic_new());
     TestSuite_Add_Batch(suite, (TestBatch*)TestLFReg_new());
     TestSuite_Add_Batch(suite, (TestBatch*)TestMemory_new());
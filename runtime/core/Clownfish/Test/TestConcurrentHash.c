@@ -0,0 +1,122 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define CFISH_USE_SHORT_NAMES
+#define TESTCFISH_USE_SHORT_NAMES
+
+#include "Clownfish/Test/TestConcurrentHash.h"
+
+#include "Clownfish/ConcurrentHash.h"
+#include "Clownfish/String.h"
+#include "Clownfish/Test.h"
+#include "Clownfish/TestHarness/TestBatchRunner.h"
+#include "Clownfish/VArray.h"
+#include "Clownfish/Class.h"
+
+TestConcurrentHash*
+TestConcurrentHash_new() {
+    return (TestConcurrentHash*)Class_Make_Obj(TESTCONCURRENTHASH);
+}
+
+static void
+test_Store_and_Fetch(TestBatchRunner *runner) {
+    ConcurrentHash *hash = CHash_new(0); // trigger multiple rebuilds.
+    uint32_t starting_cap = CHash_Get_Capacity(hash);
+
+    for (uint32_t i = 0; i < 1000; i++) {
+        String *key = Str_newf("%u32", i);
+        CHash_Store(hash, key, (Obj*)Str_Clone(key));
+        DECREF(key);
+    }
+    TEST_INT_EQ(runner, CHash_Get_Size(hash), 1000, "Get_Size");
+    TEST_TRUE(runner, CHash_Get_Capacity(hash) > starting_cap, "Rebuild");
+
+    bool all_found = true;
+    for (uint32_t i = 0; i < 1000; i++) {
+        String *key   = Str_newf("%u32", i);
+        Obj    *value = CHash_Fetch(hash, key);
+        if (!value || !Str_Equals(key, value)) { all_found = false; }
+        DECREF(key);
+    }
+    TEST_TRUE(runner, all_found, "Fetch all keys");
+    TEST_TRUE(runner, CHash_Fetch_Utf8(hash, "1000", 4) == NULL,
+              "Fetch absent key");
+
+    // Replaced values stay valid until Reclaim.
+    Obj *old_value = CHash_Fetch_Utf8(hash, "42", 2);
+    CHash_Store_Utf8(hash, "42", 2, (Obj*)Str_newf("foo"));
+    TEST_TRUE(runner, Str_Equals_Utf8((String*)CHash_Fetch_Utf8(hash, "42", 2),
+                                      "foo", 3)
+                      && CHash_Get_Size(hash) == 1000,
+              "Store replaces value");
+    TEST_TRUE(runner, Str_Equals_Utf8((String*)old_value, "42", 2),
+              "Replaced value is retired, not released");
+
+    VArray *keys = CHash_Keys(hash);
+    TEST_INT_EQ(runner, VA_Get_Size(keys), 1000, "Keys");
+    DECREF(keys);
+
+    DECREF(hash);
+}
+
+static void
+test_Delete_and_Reclaim(TestBatchRunner *runner) {
+    ConcurrentHash *hash = CHash_new(100);
+    for (uint32_t i = 0; i < 100; i++) {
+        String *key = Str_newf("%u32", i);
+        CHash_Store(hash, key, (Obj*)Str_Clone(key));
+        DECREF(key);
+    }
+    TEST_INT_EQ(runner, CHash_Reclaim(hash), 0, "Nothing to reclaim");
+
+    TEST_TRUE(runner, CHash_Delete_Utf8(hash, "7", 1), "Delete");
+    TEST_FALSE(runner, CHash_Delete_Utf8(hash, "7", 1),
+               "Delete absent key");
+    TEST_TRUE(runner, CHash_Fetch_Utf8(hash, "7", 1) == NULL
+                      && CHash_Get_Size(hash) == 99,
+              "Deleted key is gone");
+
+    CHash_Store_Utf8(hash, "7", 1, (Obj*)Str_newf("7"));
+    TEST_TRUE(runner, CHash_Fetch_Utf8(hash, "7", 1) != NULL
+                      && CHash_Get_Size(hash) == 100,
+              "Store deleted key again");
+
+    CHash_Store_Utf8(hash, "8", 1, (Obj*)Str_newf("eight"));
+    TEST_INT_EQ(runner, CHash_Reclaim(hash), 2,
+                "Reclaim releases deleted and replaced values");
+
+    // Churn through many keys, forcing rebuilds.
+    for (uint32_t i = 100; i < 1000; i++) {
+        String *key = Str_newf("%u32", i);
+        CHash_Store(hash, key, (Obj*)Str_Clone(key));
+        CHash_Delete(hash, key);
+        DECREF(key);
+    }
+    TEST_INT_EQ(runner, CHash_Get_Size(hash), 100, "Size after churn");
+    TEST_TRUE(runner, CHash_Reclaim(hash) > 900,
+              "Reclaim releases outgrown tables");
+
+    DECREF(hash);
+}
+
+void
+TestConcurrentHash_Run_IMP(TestConcurrentHash *self,
+                           TestBatchRunner *runner) {
+    TestBatchRunner_Plan(runner, (TestBatch*)self, 15);
+    test_Store_and_Fetch(runner);
+    test_Delete_and_Reclaim(runner);
+}
+
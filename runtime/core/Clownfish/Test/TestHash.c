@@ -15,6 +15,7 @@
  */
 
 #include <stdlib.h>
+#include <string.h>
 #include <time.h>
 
 #define CFISH_USE_SHORT_NAMES
@@ -22,6 +23,7 @@
 
 #include "Clownfish/Test/TestHash.h"
 
+#include "Clownfish/Err.h"
 #include "Clownfish/String.h"
 #include "Clownfish/Hash.h"
 #include "Clownfish/Num.h"
@@ -30,6 +32,7 @@
 #include "Clownfish/TestHarness/TestUtils.h"
 #include "Clownfish/VArray.h"
 #include "Clownfish/Class.h"
+#include "Clownfish/Util/Memory.h"
 
 TestHash*
 TestHash_new() {
@@ -237,15 +240,523 @@ test_store_skips_tombstone(TestBatchRunner *runner) {
     DECREF(hash);
 }
 
+static void
+test_full_groups(TestBatchRunner *runner) {
+    Hash *hash = Hash_new(50);
+    uint32_t capacity = Hash_Get_Capacity(hash);
+    uint32_t num_groups = capacity / 16;
+    VArray *keys = VA_new(24);
+
+    // Collect more keys than a group has slots, all starting their probe
+    // sequence at the same group.
+    for (int32_t i = 0; VA_Get_Size(keys) < 24; i++) {
+        String *str = Str_newf("%i32", i);
+        if ((((uint32_t)Str_Hash_Sum(str) >> 7) & (num_groups - 1)) == 0) {
+            VA_Push(keys, (Obj*)str);
+        }
+        else {
+            DECREF(str);
+        }
+    }
+    for (uint32_t i = 0; i < 24; i++) {
+        String *key = (String*)VA_Fetch(keys, i);
+        Hash_Store(hash, key, INCREF(key));
+    }
+    TEST_INT_EQ(runner, Hash_Get_Capacity(hash), capacity,
+                "colliding keys don't force a rebuild");
+
+    bool all_found = true;
+    for (uint32_t i = 0; i < 24; i++) {
+        String *key = (String*)VA_Fetch(keys, i);
+        if (Hash_Fetch(hash, key) != (Obj*)key) { all_found = false; }
+    }
+    TEST_TRUE(runner, all_found, "Fetch keys which overflow their group");
+
+    // Delete from the full home group, then look up the overflow.
+    for (uint32_t i = 0; i < 24; i += 2) {
+        String *key = (String*)VA_Fetch(keys, i);
+        DECREF(Hash_Delete(hash, key));
+    }
+    bool odd_found = true;
+    bool even_gone = true;
+    for (uint32_t i = 0; i < 24; i++) {
+        String *key = (String*)VA_Fetch(keys, i);
+        Obj    *got = Hash_Fetch(hash, key);
+        if (i % 2 && got != (Obj*)key) { odd_found = false; }
+        if (!(i % 2) && got != NULL)   { even_gone = false; }
+    }
+    TEST_TRUE(runner, odd_found, "Fetch past deleted slots in full group");
+    TEST_TRUE(runner, even_gone, "Deleted keys not found");
+    TEST_INT_EQ(runner, Hash_Get_Size(hash), 12, "size after deletions");
+
+    DECREF(keys);
+    DECREF(hash);
+}
+
+static void
+test_churn(TestBatchRunner *runner) {
+    Hash *hash = Hash_new(100);
+    uint32_t capacity = Hash_Get_Capacity(hash);
+
+    // Repeatedly delete and store a sliding window of keys.  Reclaimed
+    // slots must keep the table from growing.
+    for (int32_t i = 0; i < 5000; i++) {
+        String *str = Str_newf("%i32", i);
+        Hash_Store(hash, str, (Obj*)CFISH_TRUE);
+        DECREF(str);
+        if (i >= 100) {
+            String *old = Str_newf("%i32", i - 100);
+            DECREF(Hash_Delete(hash, old));
+            DECREF(old);
+        }
+    }
+    TEST_INT_EQ(runner, Hash_Get_Size(hash), 100, "size after churn");
+    TEST_TRUE(runner, Hash_Get_Capacity(hash) <= capacity * 2,
+              "churn doesn't grow the table without bound");
+
+    bool all_found = true;
+    for (int32_t i = 4900; i < 5000; i++) {
+        String *str = Str_newf("%i32", i);
+        if (!Hash_Fetch(hash, str)) { all_found = false; }
+        DECREF(str);
+    }
+    TEST_TRUE(runner, all_found, "Fetch after churn");
+
+    DECREF(hash);
+}
+
+static void
+test_incremental_rehash(TestBatchRunner *runner) {
+    Hash *hash = Hash_new(0);
+    Hash *dupe = Hash_new(0);
+    Hash_Set_Incremental_Rehash(hash, true);
+
+    // 900 keys start a migration out of a 1024-slot table which a few
+    // further insertions don't complete.
+    for (int32_t i = 0; i < 900; i++) {
+        String *str = Str_newf("%i32", i);
+        Hash_Store(hash, str, INCREF(str));
+        Hash_Store(dupe, str, (Obj*)str);
+    }
+    TEST_TRUE(runner, Hash_Equals(hash, (Obj*)dupe)
+                      && Hash_Equals(dupe, (Obj*)hash),
+              "Equals during incremental rehash");
+
+    for (int32_t i = 0; i < 100; i++) {
+        String *str = Str_newf("%i32", i);
+        DECREF(Hash_Delete(hash, str));
+        DECREF(Hash_Delete(dupe, str));
+        DECREF(str);
+    }
+    TEST_INT_EQ(runner, Hash_Get_Size(hash), 800,
+                "Delete during incremental rehash");
+    StackString *ten = SSTR_WRAP_UTF8("10", 2);
+    TEST_TRUE(runner, Hash_Fetch(hash, (String*)ten) == NULL,
+              "Deleted keys stay deleted");
+
+    VArray *keys = Hash_Keys(hash);
+    TEST_INT_EQ(runner, VA_Get_Size(keys), 800,
+                "Keys covers both tables");
+    DECREF(keys);
+
+    Hash_Set_Incremental_Rehash(hash, false);
+    TEST_TRUE(runner, Hash_Equals(hash, (Obj*)dupe),
+              "Disabling incremental rehash completes migration");
+
+    Hash_Set_Incremental_Rehash(hash, true);
+    for (int32_t i = 900; i < 20000; i++) {
+        String *str = Str_newf("%i32", i);
+        Hash_Store(hash, str, INCREF(str));
+        Hash_Store(dupe, str, (Obj*)str);
+    }
+    bool all_found = true;
+    for (int32_t i = 100; i < 20000; i++) {
+        String *str = Str_newf("%i32", i);
+        Obj *value = Hash_Fetch(hash, str);
+        if (!value || !Str_Equals(str, value)) { all_found = false; }
+        DECREF(str);
+    }
+    TEST_TRUE(runner, all_found, "Fetch across several incremental rehashes");
+    TEST_TRUE(runner, Hash_Equals(hash, (Obj*)dupe),
+              "Equals after several incremental rehashes");
+
+    Hash_Clear(hash);
+    TEST_INT_EQ(runner, Hash_Get_Size(hash), 0,
+                "Clear during incremental rehash");
+
+    DECREF(hash);
+    DECREF(dupe);
+}
+
+static void
+test_Fetch_Or_Store(TestBatchRunner *runner) {
+    Hash   *hash  = Hash_new(0);
+    String *key   = Str_newf("foo");
+    String *first = Str_newf("first");
+
+    Obj *got = Hash_Fetch_Or_Store(hash, key, INCREF(first));
+    TEST_TRUE(runner, got == (Obj*)first,
+              "Fetch_Or_Store returns stored value for absent key");
+    TEST_INT_EQ(runner, Hash_Get_Size(hash), 1,
+                "Fetch_Or_Store increments size for absent key");
+
+    got = Hash_Fetch_Or_Store(hash, key, (Obj*)Str_newf("second"));
+    TEST_TRUE(runner, got == (Obj*)first,
+              "Fetch_Or_Store returns existing value");
+    TEST_INT_EQ(runner, Hash_Get_Size(hash), 1,
+                "Fetch_Or_Store leaves size alone for existing key");
+
+    DECREF(first);
+    DECREF(key);
+    DECREF(hash);
+}
+
+static Obj*
+S_count(void *context, String *key, Obj *value) {
+    UNUSED_VAR(context);
+    UNUSED_VAR(key);
+    int64_t count = value ? Int64_Get_Value((Integer64*)value) : 0;
+    return (Obj*)Int64_new(count + 1);
+}
+
+static Obj*
+S_remove(void *context, String *key, Obj *value) {
+    UNUSED_VAR(key);
+    UNUSED_VAR(value);
+    *(int*)context += 1;
+    return NULL;
+}
+
+static void
+test_Update(TestBatchRunner *runner) {
+    Hash *hash = Hash_new(0);
+
+    // Count occurrences, forcing a few rebuilds along the way.
+    for (int32_t i = 0; i < 3000; i++) {
+        String *key = Str_newf("%i32", i % 1000);
+        Hash_Update(hash, key, S_count, NULL);
+        DECREF(key);
+    }
+    TEST_INT_EQ(runner, Hash_Get_Size(hash), 1000, "Update inserts");
+    bool all_counted = true;
+    for (int32_t i = 0; i < 1000; i++) {
+        String *key = Str_newf("%i32", i);
+        Integer64 *count = (Integer64*)Hash_Fetch(hash, key);
+        if (!count || Int64_Get_Value(count) != 3) { all_counted = false; }
+        DECREF(key);
+    }
+    TEST_TRUE(runner, all_counted, "Update replaces");
+
+    int calls = 0;
+    StackString *ten  = SSTR_WRAP_UTF8("10", 2);
+    StackString *nope = SSTR_WRAP_UTF8("nope", 4);
+    Obj *got = Hash_Update(hash, (String*)ten, S_remove, &calls);
+    TEST_TRUE(runner, got == NULL && Hash_Fetch(hash, (String*)ten) == NULL,
+              "Update deletes when callback returns NULL");
+    got = Hash_Update(hash, (String*)nope, S_remove, &calls);
+    TEST_TRUE(runner, got == NULL && Hash_Get_Size(hash) == 999,
+              "Update doesn't insert when callback returns NULL");
+    TEST_INT_EQ(runner, calls, 2, "Update invokes callback once per call");
+
+    DECREF(hash);
+}
+
+static void
+test_Fetch_Many(TestBatchRunner *runner) {
+    Hash    *hash     = Hash_new(0);
+    size_t   num_keys = 1000;
+    String **keys     = (String**)MALLOCATE(num_keys * sizeof(String*));
+    Obj    **values   = (Obj**)MALLOCATE(num_keys * sizeof(Obj*));
+
+    // Store every other key; look up all of them.
+    for (size_t i = 0; i < num_keys; i++) {
+        keys[i] = Str_newf("%u64", (uint64_t)i);
+        if (i % 2) {
+            Hash_Store(hash, keys[i], INCREF(keys[i]));
+        }
+    }
+
+    Hash_Fetch_Many(hash, keys, values, num_keys);
+    bool all_match = true;
+    for (size_t i = 0; i < num_keys; i++) {
+        if (values[i] != Hash_Fetch(hash, keys[i])) { all_match = false; }
+    }
+    TEST_TRUE(runner, all_match, "Fetch_Many matches Fetch");
+    TEST_TRUE(runner, values[0] == NULL && values[1] == (Obj*)keys[1],
+              "Fetch_Many yields NULL for absent keys");
+
+    // A partial batch.
+    Hash_Fetch_Many(hash, keys + 995, values, 5);
+    TEST_TRUE(runner, values[0] == (Obj*)keys[995]
+                      && values[1] == NULL
+                      && values[4] == (Obj*)keys[999],
+              "Fetch_Many with fewer keys than a batch");
+
+    for (size_t i = 0; i < num_keys; i++) { DECREF(keys[i]); }
+    FREEMEM(keys);
+    FREEMEM(values);
+    DECREF(hash);
+}
+
+static bool
+S_collect(void *context, String *key, Obj *value) {
+    Hash_Store((Hash*)context, key, INCREF(value));
+    return true;
+}
+
+static bool
+S_stop_after_ten(void *context, String *key, Obj *value) {
+    UNUSED_VAR(key);
+    UNUSED_VAR(value);
+    return ++*(int*)context < 10;
+}
+
+static bool
+S_grow(void *context, String *key, Obj *value) {
+    UNUSED_VAR(key);
+    UNUSED_VAR(value);
+    Hash *hash = (Hash*)context;
+    for (uint32_t i = 0; i < 100; i++) {
+        String *str = Str_newf("grow %u32", i);
+        Hash_Store(hash, str, (Obj*)str);
+    }
+    return true;
+}
+
+static void
+S_invoke_Each_grow(void *context) {
+    Hash_Each((Hash*)context, S_grow, context);
+}
+
+static void
+test_Each(TestBatchRunner *runner) {
+    Hash *hash = Hash_new(0);
+    Hash_Set_Incremental_Rehash(hash, true);
+
+    // Leave entries spread across the old and new tables.
+    for (uint32_t i = 0; i < 900; i++) {
+        String *str = Str_newf("%u32", i);
+        Hash_Store(hash, str, (Obj*)str);
+    }
+
+    Hash *seen = Hash_new(0);
+    Hash_Each(hash, S_collect, seen);
+    TEST_TRUE(runner, Hash_Equals(seen, (Obj*)hash),
+              "Each visits every entry once");
+    DECREF(seen);
+
+    int count = 0;
+    Hash_Each(hash, S_stop_after_ten, &count);
+    TEST_INT_EQ(runner, count, 10, "Each stops when callback returns false");
+
+    if (getenv("LUCY_VALGRIND")) {
+        SKIP(runner, 1, "memory leak");
+    }
+    else {
+        Err *error = Err_trap(S_invoke_Each_grow, hash);
+        TEST_TRUE(runner, error != NULL,
+                  "Each throws if callback rebuilds the hash");
+        DECREF(error);
+    }
+
+    DECREF(hash);
+}
+
+static void
+test_Compact(TestBatchRunner *runner) {
+    Hash *hash = Hash_new(0);
+
+    for (int32_t i = 0; i < 1000; i++) {
+        String *str = Str_newf("%i32", i);
+        Hash_Store(hash, str, (Obj*)str);
+    }
+    uint32_t big_capacity = Hash_Get_Capacity(hash);
+    for (int32_t i = 10; i < 1000; i++) {
+        String *str = Str_newf("%i32", i);
+        DECREF(Hash_Delete(hash, str));
+        DECREF(str);
+    }
+    TEST_INT_EQ(runner, Hash_Get_Capacity(hash), big_capacity,
+                "Delete doesn't shrink");
+
+    Hash_Compact(hash);
+    TEST_INT_EQ(runner, Hash_Get_Capacity(hash), 16,
+                "Compact shrinks to smallest capacity");
+    bool all_found = true;
+    for (int32_t i = 0; i < 10; i++) {
+        String *str = Str_newf("%i32", i);
+        Obj *value = Hash_Fetch(hash, str);
+        if (!value || !Str_Equals(str, value)) { all_found = false; }
+        DECREF(str);
+    }
+    TEST_TRUE(runner, all_found && Hash_Get_Size(hash) == 10,
+              "Compact keeps entries");
+
+    Hash_Compact(hash);
+    TEST_INT_EQ(runner, Hash_Get_Capacity(hash), 16,
+                "Compact on compact hash is a no-op");
+
+    Hash_Clear(hash);
+    Hash_Compact(hash);
+    TEST_INT_EQ(runner, Hash_Get_Capacity(hash), 16,
+                "Compact after Clear");
+
+    DECREF(hash);
+}
+
+// Collect `count` keys whose probe sequence starts at `group` in a table
+// with `capacity` slots.
+static void
+S_keys_for_group(VArray *keys, uint32_t capacity, uint32_t group,
+                 uint32_t count) {
+    uint32_t num_groups = capacity / 16;
+    for (int32_t i = 0; count > 0; i++) {
+        String *str = Str_newf("g%u32_%i32", group, i);
+        if ((((uint32_t)Str_Hash_Sum(str) >> 7) & (num_groups - 1)) == group) {
+            VA_Push(keys, (Obj*)str);
+            count--;
+        }
+        else {
+            DECREF(str);
+        }
+    }
+}
+
+static void
+test_tombstone_cleanup(TestBatchRunner *runner) {
+    Hash   *hash = Hash_new(50);
+    VArray *keys = VA_new(56);
+    uint32_t capacity = Hash_Get_Capacity(hash);
+
+    // Fill three of four groups to the brim, so that deletions from them
+    // leave tombstones.
+    S_keys_for_group(keys, capacity, 0, 16);
+    S_keys_for_group(keys, capacity, 1, 16);
+    S_keys_for_group(keys, capacity, 2, 16);
+    S_keys_for_group(keys, capacity, 3, 8);
+    for (uint32_t i = 0; i < 56; i++) {
+        String *key = (String*)VA_Fetch(keys, i);
+        Hash_Store(hash, key, INCREF(key));
+    }
+    for (uint32_t i = 0; i < 28; i++) {
+        String *key = (String*)VA_Fetch(keys, i);
+        DECREF(Hash_Delete(hash, key));
+    }
+
+    // Storing another key hits the threshold lowered by the tombstones.
+    String *extra = Str_newf("extra");
+    Hash_Store(hash, extra, INCREF(extra));
+    TEST_INT_EQ(runner, Hash_Get_Capacity(hash), capacity,
+                "Tombstone-dominated hash is cleaned up rather than grown");
+
+    bool all_found = Hash_Fetch(hash, extra) == (Obj*)extra;
+    for (uint32_t i = 28; i < 56; i++) {
+        String *key = (String*)VA_Fetch(keys, i);
+        if (Hash_Fetch(hash, key) != (Obj*)key) { all_found = false; }
+    }
+    TEST_TRUE(runner, all_found && Hash_Get_Size(hash) == 29,
+              "Entries survive tombstone cleanup");
+
+    // Compact clears out tombstones when the table can't shrink.
+    for (uint32_t i = 0; i < 28; i++) {
+        String *key = (String*)VA_Fetch(keys, i);
+        Hash_Store(hash, key, INCREF(key));
+    }
+    for (uint32_t i = 0; i < 14; i++) {
+        String *key = (String*)VA_Fetch(keys, i);
+        DECREF(Hash_Delete(hash, key));
+    }
+    Hash_Compact(hash);
+    all_found = true;
+    for (uint32_t i = 14; i < 56; i++) {
+        String *key = (String*)VA_Fetch(keys, i);
+        if (Hash_Fetch(hash, key) != (Obj*)key) { all_found = false; }
+    }
+    TEST_TRUE(runner, all_found && Hash_Get_Capacity(hash) == capacity,
+              "Compact in place");
+
+    DECREF(extra);
+    DECREF(keys);
+    DECREF(hash);
+}
+
+static int64_t
+S_stat(Hash *stats, const char *name) {
+    Obj *value = Hash_Fetch_Utf8(stats, name, strlen(name));
+    return value ? Obj_To_I64(value) : -1;
+}
+
+static void
+test_Get_Stats(TestBatchRunner *runner) {
+    Hash   *hash = Hash_new(50);
+    VArray *keys = VA_new(17);
+    uint32_t capacity = Hash_Get_Capacity(hash);
+
+    // Overflow the first group by one, then leave a tombstone in it.
+    S_keys_for_group(keys, capacity, 0, 17);
+    for (uint32_t i = 0; i < 17; i++) {
+        String *key = (String*)VA_Fetch(keys, i);
+        Hash_Store(hash, key, INCREF(key));
+    }
+    DECREF(Hash_Delete(hash, (String*)VA_Fetch(keys, 0)));
+
+    Hash *stats = Hash_Get_Stats(hash);
+    TEST_TRUE(runner, S_stat(stats, "size") == 16
+                      && S_stat(stats, "capacity") == capacity
+                      && S_stat(stats, "old_capacity") == 0
+                      && S_stat(stats, "tombstones") == 1,
+              "Get_Stats counts entries and tombstones");
+
+    VArray *lengths = (VArray*)Hash_Fetch_Utf8(stats, "probe_lengths", 13);
+    TEST_TRUE(runner, VA_Get_Size(lengths) == 2
+                      && Obj_To_I64(VA_Fetch(lengths, 0)) == 15
+                      && Obj_To_I64(VA_Fetch(lengths, 1)) == 1
+                      && S_stat(stats, "max_probe_length") == 2,
+              "Get_Stats reports probe lengths");
+
+    Obj *load      = Hash_Fetch_Utf8(stats, "load_factor", 11);
+    Obj *effective = Hash_Fetch_Utf8(stats, "effective_load", 14);
+    TEST_TRUE(runner, Obj_To_F64(load) == 16.0 / capacity
+                      && Obj_To_F64(effective) == 17.0 / capacity,
+              "Get_Stats reports load factors");
+    DECREF(stats);
+
+#ifdef CFISH_HASH_STATS
+    Hash *before = Hash_Get_Stats(hash);
+    Hash_Fetch(hash, (String*)VA_Fetch(keys, 1));
+    Hash *after = Hash_Get_Stats(hash);
+    TEST_TRUE(runner, S_stat(after, "lookups") == S_stat(before, "lookups") + 1
+                      && S_stat(after, "resizes") == 0,
+              "CFISH_HASH_STATS counts lookups");
+    DECREF(after);
+    DECREF(before);
+#else
+    SKIP(runner, 1, "compiled without CFISH_HASH_STATS");
+#endif
+
+    DECREF(keys);
+    DECREF(hash);
+}
+
 void
 TestHash_Run_IMP(TestHash *self, TestBatchRunner *runner) {
-    TestBatchRunner_Plan(runner, (TestBatch*)self, 26);
+    TestBatchRunner_Plan(runner, (TestBatch*)self, 69);
     srand((unsigned int)time((time_t*)NULL));
     test_Equals(runner);
     test_Store_and_Fetch(runner);
     test_Keys_Values(runner);
     test_stress(runner);
     test_store_skips_tombstone(runner);
+    test_full_groups(runner);
+    test_churn(runner);
+    test_incremental_rehash(runner);
+    test_Fetch_Or_Store(runner);
+    test_Update(runner);
+    test_Fetch_Many(runner);
+    test_Each(runner);
+    test_Compact(runner);
+    test_tombstone_cleanup(runner);
+    test_Get_Stats(runner);
 }
 
 
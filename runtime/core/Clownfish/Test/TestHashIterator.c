@@ -228,15 +228,76 @@ test_tombstone(TestBatchRunner *runner) {
     }
 }
 
+static void
+test_incremental_rehash(TestBatchRunner *runner) {
+    Hash *hash = Hash_new(0);
+    Hash_Set_Incremental_Rehash(hash, true);
+
+    // Leave entries spread across the old and new tables.
+    for (uint32_t i = 0; i < 900; i++) {
+        String *str = Str_newf("%u32", i);
+        Hash_Store(hash, str, (Obj*)str);
+    }
+
+    Hash *seen = Hash_new(0);
+    HashIterator *iter = HashIter_new(hash);
+    while (HashIter_Next(iter)) {
+        String *key = HashIter_Get_Key(iter);
+        Hash_Store(seen, key, INCREF(HashIter_Get_Value(iter)));
+    }
+    TEST_TRUE(runner, Hash_Equals(seen, (Obj*)hash),
+              "Iterate during incremental rehash");
+    DECREF(iter);
+    DECREF(seen);
+
+    iter = HashIter_new(hash);
+    HashIter_Next(iter);
+    String *str = Str_newf("foo");
+    Hash_Store(hash, str, (Obj*)str);
+    Err *next_error = Err_trap(S_invoke_Next, iter);
+    TEST_TRUE(runner, next_error != NULL,
+              "Next after migration step throws exception.");
+    DECREF(next_error);
+
+    DECREF(iter);
+    DECREF(hash);
+}
+
+static void
+test_stack_iterator(TestBatchRunner *runner) {
+    Hash *hash = Hash_new(0);
+    for (uint32_t i = 0; i < 100; i++) {
+        String *str = Str_newf("%u32", i);
+        Hash_Store(hash, str, (Obj*)str);
+    }
+    uint32_t refcount = CFISH_REFCOUNT_NN(hash);
+
+    Hash *seen = Hash_new(0);
+    StackHashIterator *iter = HASHITER_STACK(hash);
+    TEST_INT_EQ(runner, CFISH_REFCOUNT_NN(hash), refcount,
+                "StackHashIterator doesn't INCREF the hash");
+    while (SHashIter_Next(iter)) {
+        String *key = SHashIter_Get_Key(iter);
+        Hash_Store(seen, key, INCREF(SHashIter_Get_Value(iter)));
+    }
+    TEST_TRUE(runner, Hash_Equals(seen, (Obj*)hash),
+              "Iterate with StackHashIterator");
+
+    DECREF(seen);
+    DECREF(hash);
+}
+
 void
 TestHashIterator_Run_IMP(TestHashIterator *self, TestBatchRunner *runner) {
-    TestBatchRunner_Plan(runner, (TestBatch*)self, 17);
+    TestBatchRunner_Plan(runner, (TestBatch*)self, 21);
     srand((unsigned int)time((time_t*)NULL));
     test_Next(runner);
     test_empty(runner);
     test_Get_Key_and_Get_Value(runner);
     test_illegal_modification(runner);
     test_tombstone(runner);
+    test_incremental_rehash(runner);
+    test_stack_iterator(runner);
 }
 
 
@@ -0,0 +1,139 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#define CFISH_USE_SHORT_NAMES
+#define TESTCFISH_USE_SHORT_NAMES
+
+#include "Clownfish/Test/TestHashSet.h"
+
+#include "Clownfish/HashSet.h"
+#include "Clownfish/String.h"
+#include "Clownfish/Test.h"
+#include "Clownfish/TestHarness/TestBatchRunner.h"
+#include "Clownfish/VArray.h"
+#include "Clownfish/Class.h"
+
+TestHashSet*
+TestHashSet_new() {
+    return (TestHashSet*)Class_Make_Obj(TESTHASHSET);
+}
+
+// Return a set of the decimal strings for [min, max).
+static HashSet*
+S_range(int32_t min, int32_t max) {
+    HashSet *set = HashSet_new(0);
+    for (int32_t i = min; i < max; i++) {
+        String *str = Str_newf("%i32", i);
+        HashSet_Add(set, str);
+        DECREF(str);
+    }
+    return set;
+}
+
+static void
+test_Add_Contains_Remove(TestBatchRunner *runner) {
+    HashSet *set = HashSet_new(0);
+    String  *foo = Str_newf("foo");
+
+    TEST_TRUE(runner, HashSet_Add(set, foo), "Add new key returns true");
+    TEST_FALSE(runner, HashSet_Add_Utf8(set, "foo", 3),
+               "Add existing key returns false");
+    TEST_INT_EQ(runner, HashSet_Get_Size(set), 1, "size after Add");
+    TEST_TRUE(runner, HashSet_Contains_Utf8(set, "foo", 3), "Contains");
+    TEST_FALSE(runner, HashSet_Contains_Utf8(set, "bar", 3),
+               "Contains non-existent key");
+    TEST_TRUE(runner, HashSet_Remove(set, foo), "Remove returns true");
+    TEST_FALSE(runner, HashSet_Remove(set, foo),
+               "Remove non-existent key returns false");
+    TEST_INT_EQ(runner, HashSet_Get_Size(set), 0, "size after Remove");
+    DECREF(set);
+
+    // Grow through several rebuilds.
+    set = S_range(0, 1000);
+    TEST_INT_EQ(runner, HashSet_Get_Size(set), 1000, "size after rebuilds");
+    bool all_found = true;
+    for (int32_t i = 0; i < 1000; i++) {
+        String *str = Str_newf("%i32", i);
+        if (!HashSet_Contains(set, str)) { all_found = false; }
+        DECREF(str);
+    }
+    TEST_TRUE(runner, all_found, "Contains after rebuilds");
+
+    VArray *keys = HashSet_Keys(set);
+    TEST_INT_EQ(runner, VA_Get_Size(keys), 1000, "Keys");
+    DECREF(keys);
+
+    HashSet_Clear(set);
+    TEST_INT_EQ(runner, HashSet_Get_Size(set), 0, "Clear");
+    TEST_FALSE(runner, HashSet_Contains(set, foo), "Contains after Clear");
+
+    DECREF(set);
+    DECREF(foo);
+}
+
+static void
+test_set_operations(TestBatchRunner *runner) {
+    HashSet *a = S_range(0, 300);
+    HashSet *b = S_range(200, 500);
+
+    HashSet *got      = HashSet_Union(a, b);
+    HashSet *expected = S_range(0, 500);
+    TEST_TRUE(runner, HashSet_Equals(got, (Obj*)expected), "Union");
+    DECREF(got);
+    DECREF(expected);
+
+    got      = HashSet_Intersection(a, b);
+    expected = S_range(200, 300);
+    TEST_TRUE(runner, HashSet_Equals(got, (Obj*)expected), "Intersection");
+    DECREF(got);
+    got = HashSet_Intersection(b, a);
+    TEST_TRUE(runner, HashSet_Equals(got, (Obj*)expected),
+              "Intersection is commutative");
+    DECREF(got);
+    DECREF(expected);
+
+    got      = HashSet_Difference(a, b);
+    expected = S_range(0, 200);
+    TEST_TRUE(runner, HashSet_Equals(got, (Obj*)expected), "Difference");
+    DECREF(got);
+    DECREF(expected);
+
+    HashSet *empty = HashSet_new(0);
+    got = HashSet_Difference(a, empty);
+    TEST_TRUE(runner, HashSet_Equals(got, (Obj*)a),
+              "Difference with empty set");
+    DECREF(got);
+    got = HashSet_Intersection(a, empty);
+    TEST_INT_EQ(runner, HashSet_Get_Size(got), 0,
+                "Intersection with empty set");
+    DECREF(got);
+
+    TEST_FALSE(runner, HashSet_Equals(a, (Obj*)b), "Equals");
+
+    DECREF(empty);
+    DECREF(a);
+    DECREF(b);
+}
+
+void
+TestHashSet_Run_IMP(TestHashSet *self, TestBatchRunner *runner) {
+    TestBatchRunner_Plan(runner, (TestBatch*)self, 20);
+    test_Add_Contains_Remove(runner);
+    test_set_operations(runner);
+}
+
+
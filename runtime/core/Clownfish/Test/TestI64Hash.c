@@ -0,0 +1,108 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#define CFISH_USE_SHORT_NAMES
+#define TESTCFISH_USE_SHORT_NAMES
+
+#include "Clownfish/Test/TestI64Hash.h"
+
+#include "Clownfish/I64Hash.h"
+#include "Clownfish/Num.h"
+#include "Clownfish/Test.h"
+#include "Clownfish/TestHarness/TestBatchRunner.h"
+#include "Clownfish/Class.h"
+
+TestI64Hash*
+TestI64Hash_new() {
+    return (TestI64Hash*)Class_Make_Obj(TESTI64HASH);
+}
+
+static void
+test_Store_and_Fetch(TestBatchRunner *runner) {
+    I64Hash *hash = I64Hash_new(0); // trigger multiple rebuilds.
+
+    // Keys which share their low bits, plus extremes.
+    for (int64_t i = 0; i < 1000; i++) {
+        I64Hash_Store(hash, i << 32, (Obj*)Int64_new(i));
+    }
+    I64Hash_Store(hash, INT64_MIN, (Obj*)Int64_new(-1));
+    I64Hash_Store(hash, INT64_MAX, (Obj*)Int64_new(-2));
+    TEST_INT_EQ(runner, I64Hash_Get_Size(hash), 1002, "size after Store");
+
+    bool all_found = true;
+    for (int64_t i = 0; i < 1000; i++) {
+        Integer64 *value = (Integer64*)I64Hash_Fetch(hash, i << 32);
+        if (!value || Int64_Get_Value(value) != i) { all_found = false; }
+    }
+    TEST_TRUE(runner, all_found, "Fetch");
+    Integer64 *value = (Integer64*)I64Hash_Fetch(hash, INT64_MIN);
+    TEST_TRUE(runner, value && Int64_Get_Value(value) == -1,
+              "Fetch INT64_MIN");
+    TEST_TRUE(runner, I64Hash_Fetch(hash, 1) == NULL,
+              "Fetch against non-existent key returns NULL");
+
+    I64Hash_Store(hash, INT64_MAX, (Obj*)Int64_new(-3));
+    TEST_INT_EQ(runner, I64Hash_Get_Size(hash), 1002,
+                "size unaffected after value replaced");
+    value = (Integer64*)I64Hash_Delete(hash, INT64_MAX);
+    TEST_TRUE(runner, value && Int64_Get_Value(value) == -3,
+              "Delete returns replaced value");
+    DECREF(value);
+    TEST_TRUE(runner, I64Hash_Delete(hash, INT64_MAX) == NULL,
+              "Delete returns NULL when key not found");
+    TEST_INT_EQ(runner, I64Hash_Get_Size(hash), 1001,
+                "size decremented by successful Delete");
+
+    I64Hash_Clear(hash);
+    TEST_INT_EQ(runner, I64Hash_Get_Size(hash), 0, "size is 0 after Clear");
+    TEST_TRUE(runner, I64Hash_Fetch(hash, 0) == NULL, "Fetch after Clear");
+
+    DECREF(hash);
+}
+
+static void
+test_churn(TestBatchRunner *runner) {
+    I64Hash *hash = I64Hash_new(100);
+    uint32_t capacity = I64Hash_Get_Capacity(hash);
+
+    for (int64_t i = 0; i < 5000; i++) {
+        I64Hash_Store(hash, i, (Obj*)CFISH_TRUE);
+        if (i >= 100) {
+            DECREF(I64Hash_Delete(hash, i - 100));
+        }
+    }
+    TEST_INT_EQ(runner, I64Hash_Get_Size(hash), 100, "size after churn");
+    TEST_TRUE(runner, I64Hash_Get_Capacity(hash) <= capacity * 2,
+              "churn doesn't grow the table without bound");
+
+    bool all_found = true;
+    for (int64_t i = 4900; i < 5000; i++) {
+        if (!I64Hash_Fetch(hash, i)) { all_found = false; }
+    }
+    TEST_TRUE(runner, all_found, "Fetch after churn");
+
+    DECREF(hash);
+}
+
+void
+TestI64Hash_Run_IMP(TestI64Hash *self, TestBatchRunner *runner) {
+    TestBatchRunner_Plan(runner, (TestBatch*)self, 13);
+    test_Store_and_Fetch(runner);
+    test_churn(runner);
+}
+
+
@@ -25,6 +25,7 @@
 #include "Clownfish/Test.h"
 #include "Clownfish/TestHarness/TestBatchRunner.h"
 #include "Clownfish/Class.h"
+#include "Clownfish/String.h"
 
 TestLockFreeRegistry*
 TestLFReg_new() {
@@ -76,10 +77,87 @@ test_all(TestBatchRunner *runner) {
     DECREF(registry);
 }
 
+static void
+test_growth(TestBatchRunner *runner) {
+    LockFreeRegistry *registry = LFReg_new(1);
+    String *keys[1000];
+    bool    registered = true;
+    bool    fetched    = true;
+
+    for (uint32_t i = 0; i < 1000; i++) {
+        keys[i] = Str_newf("key %u32", i);
+        if (!LFReg_Register(registry, keys[i], (Obj*)keys[i])) {
+            registered = false;
+        }
+    }
+    TEST_TRUE(runner, registered, "Register() many keys");
+    TEST_INT_EQ(runner, LFReg_Get_Size(registry), 1000, "Get_Size()");
+    TEST_TRUE(runner, LFReg_Get_Capacity(registry) >= 256,
+              "registry grows as keys are added");
+
+    for (uint32_t i = 0; i < 1000; i++) {
+        String *dupe = Str_Clone(keys[i]);
+        if (LFReg_Fetch(registry, dupe) != (Obj*)keys[i]
+            || LFReg_Register(registry, dupe, (Obj*)dupe)
+           ) {
+            fetched = false;
+        }
+        DECREF(dupe);
+    }
+    TEST_TRUE(runner, fetched,
+              "Fetch() all keys after growth, no duplicates registered");
+
+    for (uint32_t i = 0; i < 1000; i++) {
+        DECREF(keys[i]);
+    }
+    DECREF(registry);
+}
+
+static void
+test_Store_and_Delete(TestBatchRunner *runner) {
+    LockFreeRegistry *registry = LFReg_new(4);
+    String *foo = Str_newf("foo");
+    String *bar = Str_newf("bar");
+    String *one = Str_newf("one");
+    String *two = Str_newf("two");
+
+    LFReg_Register(registry, foo, (Obj*)one);
+    TEST_TRUE(runner, LFReg_Store(registry, foo, (Obj*)two),
+              "Store() replaces the value of an existing key");
+    TEST_TRUE(runner, LFReg_Fetch(registry, foo) == (Obj*)two,
+              "Fetch() after Store()");
+    TEST_FALSE(runner, LFReg_Store(registry, bar, (Obj*)one),
+               "Store() new key");
+    TEST_TRUE(runner, LFReg_Fetch(registry, bar) == (Obj*)one,
+              "Fetch() key added by Store()");
+
+    TEST_TRUE(runner, LFReg_Delete(registry, foo), "Delete()");
+    TEST_TRUE(runner, LFReg_Fetch(registry, foo) == NULL,
+              "Fetch() deleted key returns NULL");
+    TEST_FALSE(runner, LFReg_Delete(registry, foo),
+               "Delete() non-existent key");
+    TEST_INT_EQ(runner, LFReg_Get_Size(registry), 1,
+                "Get_Size() after Delete()");
+    TEST_TRUE(runner, LFReg_Register(registry, foo, (Obj*)one),
+              "Register() deleted key again");
+
+    LFReg_Reclaim(registry);
+    TEST_INT_EQ(runner, CFISH_REFCOUNT_NN(two), 1,
+                "replaced and deleted values are released");
+
+    DECREF(two);
+    DECREF(one);
+    DECREF(bar);
+    DECREF(foo);
+    DECREF(registry);
+}
+
 void
 TestLFReg_Run_IMP(TestLockFreeRegistry *self, TestBatchRunner *runner) {
-    TestBatchRunner_Plan(runner, (TestBatch*)self, 6);
+    TestBatchRunner_Plan(runner, (TestBatch*)self, 20);
     test_all(runner);
+    test_growth(runner);
+    test_Store_and_Delete(runner);
 }
 
 
@@ -15,7 +15,9 @@
  */
 
 #include <stdio.h>
+#include <string.h>
 
+#define C_CFISH_METHOD
 #define CFISH_USE_SHORT_NAMES
 #define TESTCFISH_USE_SHORT_NAMES
 
@@ -28,6 +30,8 @@
 #include "Clownfish/Test.h"
 #include "Clownfish/TestHarness/TestBatchRunner.h"
 #include "Clownfish/Class.h"
+#include "Clownfish/Method.h"
+#include "Clownfish/VArray.h"
 
 TestObj*
 TestObj_new() {
@@ -110,6 +114,110 @@ test_Is_A(TestBatchRunner *runner) {
     DECREF(string);
 }
 
+static void
+test_class_cache(TestBatchRunner *runner) {
+    char buf[] = "Clownfish::Err";
+    StackString *name = SSTR_WRAP_UTF8(buf, strlen(buf));
+
+    TEST_TRUE(runner, Class_fetch_class((String*)name) == ERR,
+              "fetch_class");
+    TEST_TRUE(runner, Class_fetch_class((String*)name) == ERR,
+              "fetch_class again with the same buffer");
+    TEST_TRUE(runner, Class_singleton((String*)name, NULL) == ERR,
+              "singleton with the same buffer");
+
+    // Same address and length, different class.  Strings are immutable,
+    // so wrap the buffer anew.
+    memcpy(buf, "Clownfish::Obj", strlen(buf));
+    StackString *other = SSTR_WRAP_UTF8(buf, strlen(buf));
+    TEST_TRUE(runner, Class_fetch_class((String*)other) == OBJ,
+              "fetch_class doesn't return a stale class when the buffer"
+              " changes");
+
+    memcpy(buf, "Clownfish::Xyz", strlen(buf));
+    StackString *unknown = SSTR_WRAP_UTF8(buf, strlen(buf));
+    TEST_TRUE(runner, Class_fetch_class((String*)unknown) == NULL,
+              "fetch_class for unknown class returns NULL");
+}
+
+static void
+test_lazy_methods(TestBatchRunner *runner) {
+    VArray *methods = Class_Get_Methods(OBJ);
+    Method *to_string = NULL;
+    for (uint32_t i = 0, max = VA_Get_Size(methods); i < max; i++) {
+        Method *method = (Method*)VA_Fetch(methods, i);
+        if (Str_Equals_Utf8(Method_Get_Name(method), "To_String", 9)) {
+            to_string = method;
+        }
+    }
+    TEST_TRUE(runner, to_string != NULL, "Get_Methods finds novel method");
+    TEST_TRUE(runner,
+              to_string && to_string->offset == CFISH_Obj_To_String_OFFSET,
+              "Method is created with the offset from the spec");
+
+    VArray *again = Class_Get_Methods(OBJ);
+    TEST_TRUE(runner, VA_Get_Size(again) == VA_Get_Size(methods)
+                      && VA_Fetch(again, 0) == VA_Fetch(methods, 0),
+              "Methods are only created once");
+    DECREF(again);
+    DECREF(methods);
+
+    StackString *name = SSTR_WRAP_UTF8("TestObj::LazySub", 16);
+    Class *subclass = Class_singleton((String*)name, OBJ);
+    methods = Class_Get_Methods(subclass);
+    TEST_INT_EQ(runner, VA_Get_Size(methods), 0,
+                "subclass has no novel methods");
+    DECREF(methods);
+}
+
+static void
+S_attempt_enable_census(void *context) {
+    UNUSED_VAR(context);
+    Class_enable_census(!Class_census_enabled);
+}
+
+static void
+test_census(TestBatchRunner *runner) {
+    bool was_enabled = Class_census_enabled;
+    Err *error = Err_trap(S_attempt_enable_census, NULL);
+    TEST_TRUE(runner, error != NULL && Class_census_enabled == was_enabled,
+              "census can't be switched after bootstrapping");
+    DECREF(error);
+
+    if (!Class_census_enabled) {
+        SKIP(runner, 5, "census disabled");
+        return;
+    }
+
+    StackString *name = SSTR_WRAP_UTF8("TestObj::Census", 15);
+    Class *klass = Class_singleton((String*)name, OBJ);
+    int64_t size = (int64_t)Class_Get_Obj_Alloc_Size(klass);
+    TEST_TRUE(runner, Class_Get_Live_Count(klass) == 0,
+              "no live objects before Make_Obj");
+
+    Obj *objs[3];
+    for (int i = 0; i < 3; i++) {
+        objs[i] = Class_Make_Obj(klass);
+    }
+    TEST_TRUE(runner, Class_Get_Live_Count(klass) == 3,
+              "Make_Obj adds to live count");
+    TEST_TRUE(runner, Class_Get_Live_Bytes(klass) == 3 * size,
+              "Make_Obj adds to live bytes");
+
+    String *report = Class_census_report();
+    TEST_TRUE(runner,
+              Str_Find_Utf8(report, "TestObj::Census: 3 objects", 26) != -1,
+              "census_report lists live objects");
+    DECREF(report);
+
+    for (int i = 0; i < 3; i++) {
+        DECREF(objs[i]);
+    }
+    TEST_TRUE(runner, Class_Get_Live_Count(klass) == 0
+                      && Class_Get_Live_Bytes(klass) == 0,
+              "Destroy subtracts from census");
+}
+
 static void
 S_attempt_init(void *context) {
     Obj_init((Obj*)context);
@@ -169,12 +277,15 @@ test_abstract_routines(TestBatchRunner *runner) {
 
 void
 TestObj_Run_IMP(TestObj *self, TestBatchRunner *runner) {
-    TestBatchRunner_Plan(runner, (TestBatch*)self, 17);
+    TestBatchRunner_Plan(runner, (TestBatch*)self, 32);
     test_refcounts(runner);
     test_To_String(runner);
     test_Equals(runner);
     test_Hash_Sum(runner);
     test_Is_A(runner);
+    test_class_cache(runner);
+    test_lazy_methods(runner);
+    test_census(runner);
     test_abstract_routines(runner);
 }
 
@@ -0,0 +1,146 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#define CFISH_USE_SHORT_NAMES
+#define TESTCFISH_USE_SHORT_NAMES
+
+#include "Clownfish/Test/TestObjHash.h"
+
+#include "Clownfish/ByteBuf.h"
+#include "Clownfish/ObjHash.h"
+#include "Clownfish/Num.h"
+#include "Clownfish/String.h"
+#include "Clownfish/Test.h"
+#include "Clownfish/TestHarness/TestBatchRunner.h"
+#include "Clownfish/VArray.h"
+#include "Clownfish/Class.h"
+
+TestObjHash*
+TestObjHash_new() {
+    return (TestObjHash*)Class_Make_Obj(TESTOBJHASH);
+}
+
+static void
+test_Store_and_Fetch(TestBatchRunner *runner) {
+    ObjHash *hash = ObjHash_new(0); // trigger multiple rebuilds.
+
+    for (int64_t i = 0; i < 1000; i++) {
+        Integer64 *key = Int64_new(i * 1024);
+        ObjHash_Store(hash, (Obj*)key, (Obj*)Str_newf("%i64", i));
+        DECREF(key);
+    }
+    TEST_INT_EQ(runner, ObjHash_Get_Size(hash), 1000, "size after Store");
+
+    bool all_found = true;
+    for (int64_t i = 0; i < 1000; i++) {
+        Integer64 *key   = Int64_new(i * 1024);
+        String    *value = (String*)ObjHash_Fetch(hash, (Obj*)key);
+        String *expected = Str_newf("%i64", i);
+        if (!value || !Str_Equals(value, (Obj*)expected)) {
+            all_found = false;
+        }
+        DECREF(expected);
+        DECREF(key);
+    }
+    TEST_TRUE(runner, all_found, "Fetch with equal but distinct keys");
+
+    Integer64 *missing = Int64_new(1);
+    TEST_TRUE(runner, ObjHash_Fetch(hash, (Obj*)missing) == NULL,
+              "Fetch against non-existent key returns NULL");
+
+    Integer64 *key = Int64_new(1024);
+    ObjHash_Store(hash, (Obj*)key, (Obj*)Str_newf("replaced"));
+    TEST_INT_EQ(runner, ObjHash_Get_Size(hash), 1000,
+                "size unaffected after value replaced");
+    Obj *value = ObjHash_Delete(hash, (Obj*)key);
+    TEST_TRUE(runner, value && Str_Equals_Utf8((String*)value, "replaced", 8),
+              "Delete returns replaced value");
+    DECREF(value);
+    TEST_TRUE(runner, ObjHash_Delete(hash, (Obj*)key) == NULL,
+              "Delete returns NULL when key not found");
+    TEST_INT_EQ(runner, ObjHash_Get_Size(hash), 999,
+                "size decremented by successful Delete");
+
+    ObjHash_Clear(hash);
+    TEST_INT_EQ(runner, ObjHash_Get_Size(hash), 0, "size is 0 after Clear");
+
+    DECREF(key);
+    DECREF(missing);
+    DECREF(hash);
+}
+
+static void
+test_mixed_keys(TestBatchRunner *runner) {
+    ObjHash *hash = ObjHash_new(0);
+    String  *str  = Str_newf("foo");
+    ByteBuf *bb   = BB_new_bytes("foo", 3);
+    Obj     *obj  = (Obj*)Float64_new(1.5);
+
+    ObjHash_Store(hash, (Obj*)str, (Obj*)Str_newf("string"));
+    ObjHash_Store(hash, (Obj*)bb, (Obj*)Str_newf("bytebuf"));
+    ObjHash_Store(hash, obj, (Obj*)Str_newf("float"));
+
+    TEST_INT_EQ(runner, ObjHash_Get_Size(hash), 3,
+                "Keys of different classes don't collide");
+    String *got = (String*)ObjHash_Fetch(hash, (Obj*)bb);
+    TEST_TRUE(runner, got && Str_Equals_Utf8(got, "bytebuf", 7),
+              "Fetch ByteBuf key");
+
+    VArray *keys   = ObjHash_Keys(hash);
+    VArray *values = ObjHash_Values(hash);
+    TEST_INT_EQ(runner, VA_Get_Size(keys), 3, "Keys");
+    TEST_INT_EQ(runner, VA_Get_Size(values), 3, "Values");
+
+    DECREF(keys);
+    DECREF(values);
+    DECREF(obj);
+    DECREF(bb);
+    DECREF(str);
+    DECREF(hash);
+}
+
+static void
+test_churn(TestBatchRunner *runner) {
+    ObjHash *hash = ObjHash_new(100);
+    uint32_t capacity = ObjHash_Get_Capacity(hash);
+
+    for (int64_t i = 0; i < 5000; i++) {
+        Integer64 *key = Int64_new(i);
+        ObjHash_Store(hash, (Obj*)key, INCREF(key));
+        DECREF(key);
+        if (i >= 100) {
+            Integer64 *old = Int64_new(i - 100);
+            DECREF(ObjHash_Delete(hash, (Obj*)old));
+            DECREF(old);
+        }
+    }
+    TEST_INT_EQ(runner, ObjHash_Get_Size(hash), 100, "size after churn");
+    TEST_TRUE(runner, ObjHash_Get_Capacity(hash) <= capacity * 2,
+              "churn doesn't grow the table without bound");
+
+    DECREF(hash);
+}
+
+void
+TestObjHash_Run_IMP(TestObjHash *self, TestBatchRunner *runner) {
+    TestBatchRunner_Plan(runner, (TestBatch*)self, 14);
+    test_Store_and_Fetch(runner);
+    test_mixed_keys(runner);
+    test_churn(runner);
+}
+
+
@@ -0,0 +1,230 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define CFISH_USE_SHORT_NAMES
+#define TESTCFISH_USE_SHORT_NAMES
+
+#include "Clownfish/Test/TestOrderedHash.h"
+
+#include "Clownfish/Hash.h"
+#include "Clownfish/OrderedHash.h"
+#include "Clownfish/String.h"
+#include "Clownfish/Test.h"
+#include "Clownfish/TestHarness/TestBatchRunner.h"
+#include "Clownfish/VArray.h"
+#include "Clownfish/Class.h"
+
+TestOrderedHash*
+TestOrderedHash_new() {
+    return (TestOrderedHash*)Class_Make_Obj(TESTORDEREDHASH);
+}
+
+// Check that `keys` holds "start", "start + step", ... in that order.
+static bool
+S_in_order(VArray *keys, uint32_t start, uint32_t step, uint32_t count) {
+    if (VA_Get_Size(keys) != count) { return false; }
+    for (uint32_t i = 0; i < count; i++) {
+        String *expected = Str_newf("%u32", start + i * step);
+        bool    equal    = Str_Equals(expected, VA_Fetch(keys, i));
+        DECREF(expected);
+        if (!equal) { return false; }
+    }
+    return true;
+}
+
+static void
+test_Store_and_Fetch(TestBatchRunner *runner) {
+    OrderedHash *hash = OrdHash_new(0); // trigger multiple rebuilds.
+    for (uint32_t i = 0; i < 1000; i++) {
+        String *key = Str_newf("%u32", i);
+        OrdHash_Store(hash, key, (Obj*)Str_Clone(key));
+        DECREF(key);
+    }
+    TEST_INT_EQ(runner, OrdHash_Get_Size(hash), 1000, "Get_Size");
+
+    bool all_found = true;
+    for (uint32_t i = 0; i < 1000; i++) {
+        String *key   = Str_newf("%u32", i);
+        Obj    *value = OrdHash_Fetch(hash, key);
+        if (!value || !Str_Equals(key, value)) { all_found = false; }
+        DECREF(key);
+    }
+    TEST_TRUE(runner, all_found, "Fetch all keys");
+    TEST_TRUE(runner, OrdHash_Fetch_Utf8(hash, "1000", 4) == NULL,
+              "Fetch absent key");
+
+    VArray *keys = OrdHash_Keys(hash);
+    TEST_TRUE(runner, S_in_order(keys, 0, 1, 1000),
+              "Keys in insertion order");
+    DECREF(keys);
+
+    String *foo = Str_newf("foo");
+    OrdHash_Store_Utf8(hash, "0", 1, INCREF(foo));
+    keys = OrdHash_Keys(hash);
+    TEST_TRUE(runner, OrdHash_Fetch_Utf8(hash, "0", 1) == (Obj*)foo
+                      && OrdHash_Get_Size(hash) == 1000
+                      && S_in_order(keys, 0, 1, 1000),
+              "Store over existing key keeps its position");
+    DECREF(keys);
+    DECREF(foo);
+
+    OrdHash_Clear(hash);
+    TEST_INT_EQ(runner, OrdHash_Get_Size(hash), 0, "Clear");
+
+    DECREF(hash);
+}
+
+static void
+test_Delete(TestBatchRunner *runner) {
+    OrderedHash *hash = OrdHash_new(0);
+    for (uint32_t i = 0; i < 100; i++) {
+        String *key = Str_newf("%u32", i);
+        OrdHash_Store(hash, key, (Obj*)Str_Clone(key));
+        DECREF(key);
+    }
+
+    Obj *value = OrdHash_Delete_Utf8(hash, "0", 1);
+    TEST_TRUE(runner, value && Str_Equals_Utf8((String*)value, "0", 1),
+              "Delete");
+    DECREF(value);
+    for (uint32_t i = 2; i < 100; i += 2) {
+        String *key = Str_newf("%u32", i);
+        DECREF(OrdHash_Delete(hash, key));
+        DECREF(key);
+    }
+    TEST_TRUE(runner, OrdHash_Delete_Utf8(hash, "0", 1) == NULL,
+              "Delete absent key");
+
+    VArray *keys = OrdHash_Keys(hash);
+    TEST_TRUE(runner, OrdHash_Get_Size(hash) == 50
+                      && S_in_order(keys, 1, 2, 50),
+              "Delete keeps order of remaining keys");
+    DECREF(keys);
+
+    OrdHash_Store_Utf8(hash, "0", 1, (Obj*)Str_newf("0"));
+    keys = OrdHash_Keys(hash);
+    TEST_TRUE(runner, Str_Equals_Utf8((String*)VA_Fetch(keys, 50), "0", 1),
+              "Deleted key is appended when stored again");
+    DECREF(keys);
+
+    DECREF(hash);
+}
+
+static void
+test_churn(TestBatchRunner *runner) {
+    OrderedHash *hash = OrdHash_new(0);
+    for (uint32_t i = 0; i < 10000; i++) {
+        String *key = Str_newf("%u32", i);
+        OrdHash_Store(hash, key, (Obj*)Str_Clone(key));
+        DECREF(key);
+        if (i >= 10) {
+            key = Str_newf("%u32", i - 10);
+            DECREF(OrdHash_Delete(hash, key));
+            DECREF(key);
+        }
+    }
+    VArray *keys = OrdHash_Keys(hash);
+    TEST_TRUE(runner, S_in_order(keys, 9990, 1, 10),
+              "Order survives rebuilds");
+    TEST_TRUE(runner, OrdHash_Get_Capacity(hash) <= 64,
+              "Rebuilds drop deleted entries instead of growing");
+    DECREF(keys);
+    DECREF(hash);
+}
+
+static void
+test_index_widths(TestBatchRunner *runner) {
+    // Grow past the limits of 8-bit and 16-bit index slots.
+    OrderedHash *hash = OrdHash_new(0);
+    for (uint32_t i = 0; i < 50000; i++) {
+        String *key = Str_newf("%u32", i);
+        OrdHash_Store(hash, key, (Obj*)Str_Clone(key));
+        DECREF(key);
+    }
+    bool all_found = true;
+    for (uint32_t i = 0; i < 50000; i++) {
+        String *key   = Str_newf("%u32", i);
+        Obj    *value = OrdHash_Fetch(hash, key);
+        if (!value || !Str_Equals(key, value)) { all_found = false; }
+        DECREF(key);
+    }
+    TEST_TRUE(runner, all_found, "Fetch with 32-bit index slots");
+    TEST_TRUE(runner, OrdHash_Get_Capacity(hash) > 32768,
+              "Capacity beyond 16-bit index slots");
+    DECREF(hash);
+}
+
+static bool
+S_collect(void *context, String *key, Obj *value) {
+    UNUSED_VAR(value);
+    VA_Push((VArray*)context, INCREF(key));
+    return VA_Get_Size((VArray*)context) < 20;
+}
+
+static void
+test_Each(TestBatchRunner *runner) {
+    OrderedHash *hash = OrdHash_new(0);
+    for (uint32_t i = 0; i < 100; i++) {
+        String *key = Str_newf("%u32", i);
+        OrdHash_Store(hash, key, (Obj*)Str_Clone(key));
+        DECREF(key);
+    }
+    VArray *keys = VA_new(0);
+    OrdHash_Each(hash, S_collect, keys);
+    TEST_TRUE(runner, S_in_order(keys, 0, 1, 20),
+              "Each visits in insertion order until callback returns false");
+    DECREF(keys);
+    DECREF(hash);
+}
+
+static void
+test_Equals(TestBatchRunner *runner) {
+    OrderedHash *hash     = OrdHash_new(0);
+    OrderedHash *reversed = OrdHash_new(0);
+    for (uint32_t i = 0; i < 100; i++) {
+        String *key = Str_newf("%u32", i);
+        OrdHash_Store(hash, key, (Obj*)Str_Clone(key));
+        DECREF(key);
+        key = Str_newf("%u32", 99 - i);
+        OrdHash_Store(reversed, key, (Obj*)Str_Clone(key));
+        DECREF(key);
+    }
+    TEST_TRUE(runner, OrdHash_Equals(hash, (Obj*)reversed),
+              "Equals ignores order");
+    OrdHash_Store_Utf8(reversed, "42", 2, (Obj*)Str_newf("foo"));
+    TEST_FALSE(runner, OrdHash_Equals(hash, (Obj*)reversed),
+               "Not Equals with different value");
+
+    Hash *plain = Hash_new(0);
+    TEST_FALSE(runner, OrdHash_Equals(hash, (Obj*)plain),
+               "Not Equals to a Hash");
+    DECREF(plain);
+
+    DECREF(reversed);
+    DECREF(hash);
+}
+
+void
+TestOrderedHash_Run_IMP(TestOrderedHash *self, TestBatchRunner *runner) {
+    TestBatchRunner_Plan(runner, (TestBatch*)self, 18);
+    test_Store_and_Fetch(runner);
+    test_Delete(runner);
+    test_churn(runner);
+    test_index_widths(runner);
+    test_Each(runner);
+    test_Equals(runner);
+}
+
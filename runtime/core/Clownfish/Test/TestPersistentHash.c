@@ -0,0 +1,334 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#define CFISH_USE_SHORT_NAMES
+#define TESTCFISH_USE_SHORT_NAMES
+
+#include "Clownfish/Test/TestPersistentHash.h"
+
+#include "Clownfish/Err.h"
+#include "Clownfish/Hash.h"
+#include "Clownfish/PersistentHash.h"
+#include "Clownfish/String.h"
+#include "Clownfish/Test.h"
+#include "Clownfish/TestHarness/TestBatchRunner.h"
+#include "Clownfish/VArray.h"
+#include "Clownfish/Class.h"
+#include "Clownfish/Util/HashUtils.h"
+#include "Clownfish/Util/Memory.h"
+
+TestPersistentHash*
+TestPersistentHash_new() {
+    return (TestPersistentHash*)Class_Make_Obj(TESTPERSISTENTHASH);
+}
+
+// Return a new version with keys "0" through "num_keys - 1" added, each
+// mapped to a copy of itself.
+static PersistentHash*
+S_add_keys(PersistentHash *phash, uint32_t offset, uint32_t num_keys) {
+    PersistentHash *version = (PersistentHash*)INCREF(phash);
+    for (uint32_t i = offset; i < offset + num_keys; i++) {
+        String *key = Str_newf("%u32", i);
+        PersistentHash *next
+            = PHash_Store(version, key, (Obj*)Str_Clone(key));
+        DECREF(version);
+        version = next;
+        DECREF(key);
+    }
+    return version;
+}
+
+static void
+test_Store_and_Fetch(TestBatchRunner *runner) {
+    PersistentHash *empty = PHash_new();
+    PersistentHash *half  = S_add_keys(empty, 0, 500);
+    PersistentHash *full  = S_add_keys(half, 500, 500);
+
+    TEST_INT_EQ(runner, PHash_Get_Size(empty), 0, "new version is empty");
+    TEST_INT_EQ(runner, PHash_Get_Size(full), 1000, "Get_Size");
+
+    bool all_found = true;
+    for (uint32_t i = 0; i < 1000; i++) {
+        String *key = Str_newf("%u32", i);
+        Obj *value = PHash_Fetch(full, key);
+        if (!value || !Str_Equals(key, value)) { all_found = false; }
+        DECREF(key);
+    }
+    TEST_TRUE(runner, all_found, "Fetch all keys");
+
+    TEST_TRUE(runner, PHash_Get_Size(half) == 500
+                      && PHash_Fetch_Utf8(half, "100", 3) != NULL
+                      && PHash_Fetch_Utf8(half, "700", 3) == NULL,
+              "old version is unaffected by Store");
+    TEST_TRUE(runner, PHash_Fetch_Utf8(empty, "100", 3) == NULL,
+              "Fetch from empty version");
+
+    String *key = Str_newf("100");
+    String *foo = Str_newf("foo");
+    PersistentHash *replaced = PHash_Store(full, key, INCREF(foo));
+    TEST_TRUE(runner, PHash_Fetch(replaced, key) == (Obj*)foo
+                      && PHash_Get_Size(replaced) == 1000,
+              "Store replaces value");
+    TEST_TRUE(runner, !Str_Equals(foo, PHash_Fetch(full, key)),
+              "old version keeps replaced value");
+    DECREF(replaced);
+
+    PersistentHash *utf8 = PHash_Store_Utf8(empty, "foo", 3, INCREF(foo));
+    TEST_TRUE(runner, PHash_Fetch(utf8, foo) == (Obj*)foo, "Store_Utf8");
+    DECREF(utf8);
+
+    DECREF(foo);
+    DECREF(key);
+    DECREF(full);
+    DECREF(half);
+    DECREF(empty);
+}
+
+static void
+test_Delete(TestBatchRunner *runner) {
+    PersistentHash *empty   = PHash_new();
+    PersistentHash *full    = S_add_keys(empty, 0, 1000);
+    PersistentHash *version = (PersistentHash*)INCREF(full);
+
+    bool ok = true;
+    for (uint32_t i = 0; i < 1000; i++) {
+        String *key = Str_newf("%u32", i);
+        PersistentHash *next = PHash_Delete(version, key);
+        DECREF(version);
+        version = next;
+        if (PHash_Fetch(version, key) != NULL
+            || PHash_Get_Size(version) != 999 - i
+           ) {
+            ok = false;
+        }
+        DECREF(key);
+    }
+    TEST_TRUE(runner, ok, "Delete all keys");
+    TEST_TRUE(runner, PHash_Equals(version, (Obj*)empty),
+              "version with all keys deleted equals empty version");
+    TEST_INT_EQ(runner, PHash_Get_Size(full), 1000,
+                "old version is unaffected by Delete");
+    DECREF(version);
+
+    version = PHash_Delete_Utf8(full, "nope", 4);
+    TEST_TRUE(runner, PHash_Get_Size(version) == 1000
+                      && PHash_Equals(version, (Obj*)full),
+              "Delete absent key");
+    DECREF(version);
+
+    // Deleting must leave the same shape as never inserting.
+    PersistentHash *more = S_add_keys(full, 1000, 1000);
+    version = (PersistentHash*)INCREF(more);
+    for (uint32_t i = 1000; i < 2000; i++) {
+        String *key = Str_newf("%u32", i);
+        PersistentHash *next = PHash_Delete(version, key);
+        DECREF(version);
+        version = next;
+        DECREF(key);
+    }
+    TEST_TRUE(runner, PHash_Equals(version, (Obj*)full),
+              "Delete restores canonical shape");
+    DECREF(version);
+    DECREF(more);
+
+    DECREF(full);
+    DECREF(empty);
+}
+
+static void
+test_Equals(TestBatchRunner *runner) {
+    PersistentHash *empty = PHash_new();
+    PersistentHash *full  = S_add_keys(empty, 0, 100);
+    Hash           *hash  = PHash_To_Hash(full);
+    PersistentHash *twin  = PHash_from_hash(hash);
+
+    TEST_INT_EQ(runner, Hash_Get_Size(hash), 100, "To_Hash");
+    TEST_TRUE(runner, PHash_Equals(full, (Obj*)twin),
+              "Equals after round trip through Hash");
+    TEST_FALSE(runner, PHash_Equals(full, (Obj*)hash),
+               "Not Equals to a Hash");
+
+    PersistentHash *other = PHash_Store_Utf8(twin, "42", 2,
+                                             (Obj*)Str_newf("foo"));
+    TEST_FALSE(runner, PHash_Equals(full, (Obj*)other),
+               "Not Equals with different value");
+    DECREF(other);
+
+    DECREF(twin);
+    DECREF(hash);
+    DECREF(full);
+    DECREF(empty);
+}
+
+static bool
+S_count(void *context, String *key, Obj *value) {
+    UNUSED_VAR(key);
+    UNUSED_VAR(value);
+    return ++*(int*)context < 10;
+}
+
+static void
+test_Keys_Values(TestBatchRunner *runner) {
+    PersistentHash *empty  = PHash_new();
+    PersistentHash *full   = S_add_keys(empty, 0, 100);
+    VArray         *keys   = PHash_Keys(full);
+    VArray         *values = PHash_Values(full);
+
+    VA_Sort(keys, NULL, NULL);
+    VA_Sort(values, NULL, NULL);
+    TEST_TRUE(runner, VA_Equals(keys, (Obj*)values), "Keys and Values");
+    TEST_INT_EQ(runner, VA_Get_Size(keys), 100, "Keys returns all keys");
+
+    int count = 0;
+    PHash_Each(full, S_count, &count);
+    TEST_INT_EQ(runner, count, 10, "Each stops when callback returns false");
+
+    DECREF(values);
+    DECREF(keys);
+    DECREF(full);
+    DECREF(empty);
+}
+
+static int
+S_compare_uint64(const void *va, const void *vb) {
+    uint64_t a = *(const uint64_t*)va;
+    uint64_t b = *(const uint64_t*)vb;
+    return a < b ? -1 : a > b ? 1 : 0;
+}
+
+// Find two strings with identical hash sums by brute force.
+static bool
+S_find_collision(char *a, char *b) {
+    const uint32_t num_tries = 400000;
+    uint64_t *sums = (uint64_t*)MALLOCATE(num_tries * sizeof(uint64_t));
+    char buf[20];
+    for (uint32_t i = 0; i < num_tries; i++) {
+        size_t  len      = (size_t)sprintf(buf, "%lu", (unsigned long)i);
+        int32_t hash_sum = HashUtil_hash_sum(buf, len);
+        if (hash_sum == 0) { hash_sum = 1; } // as in Str_Hash_Sum
+        sums[i] = ((uint64_t)(uint32_t)hash_sum << 32) | i;
+    }
+    qsort(sums, num_tries, sizeof(uint64_t), S_compare_uint64);
+
+    bool found = false;
+    for (uint32_t i = 1; i < num_tries; i++) {
+        if ((sums[i] >> 32) == (sums[i - 1] >> 32)) {
+            sprintf(a, "%lu", (unsigned long)(uint32_t)sums[i - 1]);
+            sprintf(b, "%lu", (unsigned long)(uint32_t)sums[i]);
+            found = true;
+            break;
+        }
+    }
+    FREEMEM(sums);
+    return found;
+}
+
+static void
+test_collisions(TestBatchRunner *runner) {
+    char a[20], b[20];
+    if (!S_find_collision(a, b)) {
+        SKIP(runner, 4, "no hash collision found");
+        return;
+    }
+
+    PersistentHash *empty = PHash_new();
+    PersistentHash *one   = PHash_Store_Utf8(empty, a, strlen(a),
+                                             (Obj*)Str_newf("a"));
+    PersistentHash *both  = PHash_Store_Utf8(one, b, strlen(b),
+                                             (Obj*)Str_newf("b"));
+    TEST_TRUE(runner, PHash_Get_Size(both) == 2
+                      && Str_Equals_Utf8((String*)PHash_Fetch_Utf8(both, a,
+                                                                   strlen(a)),
+                                         "a", 1)
+                      && Str_Equals_Utf8((String*)PHash_Fetch_Utf8(both, b,
+                                                                   strlen(b)),
+                                         "b", 1),
+              "Store and Fetch colliding keys");
+
+    PersistentHash *other = PHash_Store_Utf8(empty, b, strlen(b),
+                                             (Obj*)Str_newf("b"));
+    PersistentHash *reversed = PHash_Store_Utf8(other, a, strlen(a),
+                                                (Obj*)Str_newf("a"));
+    TEST_TRUE(runner, PHash_Equals(both, (Obj*)reversed),
+              "Equals ignores order of colliding keys");
+
+    PersistentHash *deleted = PHash_Delete_Utf8(both, b, strlen(b));
+    TEST_TRUE(runner, PHash_Equals(deleted, (Obj*)one),
+              "Delete colliding key");
+    TEST_TRUE(runner, PHash_Fetch_Utf8(deleted, b, strlen(b)) == NULL
+                      && PHash_Fetch_Utf8(both, b, strlen(b)) != NULL,
+              "Delete colliding key leaves old version intact");
+
+    DECREF(deleted);
+    DECREF(reversed);
+    DECREF(other);
+    DECREF(both);
+    DECREF(one);
+    DECREF(empty);
+}
+
+static void
+test_random_ops(TestBatchRunner *runner) {
+    Hash           *hash    = Hash_new(0);
+    PersistentHash *version = PHash_new();
+
+    for (uint32_t i = 0; i < 10000; i++) {
+        String *key = Str_newf("%i32", (int32_t)(rand() % 500));
+        PersistentHash *next;
+        if (rand() % 3) {
+            String *value = Str_newf("%u32", i);
+            Hash_Store(hash, key, INCREF(value));
+            next = PHash_Store(version, key, (Obj*)value);
+        }
+        else {
+            DECREF(Hash_Delete(hash, key));
+            next = PHash_Delete(version, key);
+        }
+        DECREF(version);
+        version = next;
+        DECREF(key);
+    }
+
+    Hash *converted = PHash_To_Hash(version);
+    TEST_TRUE(runner, Hash_Equals(hash, (Obj*)converted),
+              "Random Store and Delete match Hash");
+    DECREF(converted);
+
+    PersistentHash *twin = PHash_from_hash(hash);
+    TEST_TRUE(runner, PHash_Equals(version, (Obj*)twin),
+              "Shape is independent of history");
+    DECREF(twin);
+
+    DECREF(version);
+    DECREF(hash);
+}
+
+void
+TestPersistentHash_Run_IMP(TestPersistentHash *self,
+                           TestBatchRunner *runner) {
+    TestBatchRunner_Plan(runner, (TestBatch*)self, 26);
+    test_Store_and_Fetch(runner);
+    test_Delete(runner);
+    test_Equals(runner);
+    test_Keys_Values(runner);
+    test_collisions(runner);
+    test_random_ops(runner);
+}
+
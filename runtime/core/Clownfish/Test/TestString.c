@@ -163,6 +163,86 @@ test_SubString(TestBatchRunner *runner) {
     DECREF(string);
 }
 
+static bool
+S_is_inline(String *string) {
+    size_t offset = Class_Get_Obj_Alloc_Size(STRING);
+    return Str_Get_Ptr8(string) == (const char*)string + offset;
+}
+
+static void
+test_inline_storage(TestBatchRunner *runner) {
+    char chars[STR_MAX_INLINE_SIZE + 1];
+    memset(chars, 'x', sizeof(chars));
+
+    String *inline_str = Str_new_from_utf8(chars, STR_MAX_INLINE_SIZE);
+    String *heap_str   = Str_new_from_utf8(chars, STR_MAX_INLINE_SIZE + 1);
+    TEST_TRUE(runner, S_is_inline(inline_str) && !S_is_inline(heap_str),
+              "short Strings store their characters inline");
+
+    String *wanted;
+    String *got = Str_Cat(inline_str, heap_str);
+    TEST_TRUE(runner, !S_is_inline(got)
+                      && Str_Get_Size(got) == 2 * STR_MAX_INLINE_SIZE + 1
+                      && Str_Ends_With(got, heap_str),
+              "Cat beyond the inline size");
+    DECREF(got);
+    DECREF(heap_str);
+
+    String *string = Str_newf("a%sb", smiley);
+    String *sub    = Str_SubString(string, 1, 2);
+    TEST_TRUE(runner, S_is_inline(string), "newf stores short Strings inline");
+    DECREF(string);
+    wanted = Str_newf("%sb", smiley);
+    TEST_TRUE(runner, Str_Equals(sub, (Obj*)wanted),
+              "SubString of inline String outlives its origin");
+    DECREF(wanted);
+    DECREF(sub);
+
+    CharBuf *buf = CB_new(0);
+    CB_Cat(buf, inline_str);
+    got = CB_Yield_String(buf);
+    TEST_TRUE(runner, S_is_inline(got) && Str_Equals(got, (Obj*)inline_str),
+              "Yield_String stores short content inline");
+    TEST_INT_EQ(runner, CB_Get_Size(buf), 0, "Yield_String clears CharBuf");
+    DECREF(got);
+    DECREF(buf);
+
+    got = Str_new_from_char(smiley_cp);
+    TEST_TRUE(runner, S_is_inline(got) && Str_Get_Size(got) == smiley_len,
+              "new_from_char stores its character inline");
+    DECREF(got);
+    DECREF(inline_str);
+}
+
+static void
+test_Hash_Sum(TestBatchRunner *runner) {
+    String *string = Str_newf("a%sb", smiley);
+    String *copy   = Str_newf("a%sb", smiley);
+    int32_t sum    = Str_Hash_Sum(string);
+
+    TEST_INT_EQ(runner, Str_Hash_Sum(string), sum, "Hash_Sum is stable");
+    TEST_INT_EQ(runner, Str_Hash_Sum(copy), sum,
+                "equal strings have equal Hash_Sum");
+
+    StackString *wrapper = SSTR_WRAP(string);
+    TEST_INT_EQ(runner, SStr_Hash_Sum(wrapper), sum,
+                "StackString wrapper carries Hash_Sum");
+    StackString *utf8_wrapper = SSTR_WRAP_UTF8(Str_Get_Ptr8(copy),
+                                               Str_Get_Size(copy));
+    TEST_INT_EQ(runner, SStr_Hash_Sum(utf8_wrapper), sum,
+                "StackString of UTF-8 computes same Hash_Sum");
+
+    String *longer = Str_newf("xa%sbx", smiley);
+    String *sub    = Str_SubString(longer, 1, 3);
+    TEST_INT_EQ(runner, Str_Hash_Sum(sub), sum,
+                "SubString computes its own Hash_Sum");
+
+    DECREF(sub);
+    DECREF(longer);
+    DECREF(copy);
+    DECREF(string);
+}
+
 static void
 test_Trim(TestBatchRunner *runner) {
     String *ws_smiley = S_smiley_with_whitespace(NULL);
@@ -500,12 +580,14 @@ test_iterator_substring(TestBatchRunner *runner) {
 
 void
 TestStr_Run_IMP(TestString *self, TestBatchRunner *runner) {
-    TestBatchRunner_Plan(runner, (TestBatch*)self, 101);
+    TestBatchRunner_Plan(runner, (TestBatch*)self, 113);
     test_Cat(runner);
     test_Clone(runner);
     test_Code_Point_At_and_From(runner);
     test_Find(runner);
     test_SubString(runner);
+    test_inline_storage(runner);
+    test_Hash_Sum(runner);
     test_Trim(runner);
     test_To_F64(runner);
     test_To_I64(runner);
@@ -295,6 +295,56 @@ test_Clone_and_Shallow_Copy(TestBatchRunner *runner) {
     DECREF(twin);
 }
 
+static bool
+S_sum(void *context, uint32_t tick, Obj *elem) {
+    UNUSED_VAR(tick);
+    if (elem) { *(int64_t*)context += Int32_Get_Value((Integer32*)elem); }
+    else      { *(int64_t*)context += 1000; }
+    return true;
+}
+
+static bool
+S_find(void *context, uint32_t tick, Obj *elem) {
+    if (elem && Int32_Get_Value((Integer32*)elem) == 5) {
+        *(uint32_t*)context = tick;
+        return false;
+    }
+    return true;
+}
+
+static bool
+S_pop(void *context, uint32_t tick, Obj *elem) {
+    UNUSED_VAR(tick);
+    UNUSED_VAR(elem);
+    DECREF(VA_Pop((VArray*)context));
+    return true;
+}
+
+static void
+test_Each(TestBatchRunner *runner) {
+    VArray *array = VA_new(0);
+    for (int32_t i = 0; i < 10; i++) {
+        VA_Push(array, (Obj*)Int32_new(i));
+    }
+    VA_Store(array, 12, (Obj*)Int32_new(12));
+
+    int64_t sum = 0;
+    VA_Each(array, S_sum, &sum);
+    TEST_INT_EQ(runner, sum, 45 + 2000 + 12,
+                "Each visits every element, including NULLs");
+
+    uint32_t tick = 0;
+    VA_Each(array, S_find, &tick);
+    TEST_INT_EQ(runner, tick, 5, "Each stops when callback returns false");
+
+    // Shrink the array from within the callback.
+    VA_Each(array, S_pop, array);
+    TEST_INT_EQ(runner, VA_Get_Size(array), 6,
+                "Each rechecks size after each callback");
+
+    DECREF(array);
+}
+
 static void
 S_overflow_Push(void *context) {
     UNUSED_VAR(context);
@@ -358,7 +408,7 @@ test_exceptions(TestBatchRunner *runner) {
 
 void
 TestVArray_Run_IMP(TestVArray *self, TestBatchRunner *runner) {
-    TestBatchRunner_Plan(runner, (TestBatch*)self, 47);
+    TestBatchRunner_Plan(runner, (TestBatch*)self, 50);
     test_Equals(runner);
     test_Store_Fetch(runner);
     test_Push_Pop_Shift_Unshift(runner);
@@ -368,6 +418,7 @@ TestVArray_Run_IMP(TestVArray *self, TestBatchRunner *runner) {
     test_Push_VArray(runner);
     test_Slice(runner);
     test_Clone_and_Shallow_Copy(runner);
+    test_Each(runner);
     test_exceptions(runner);
 }
 
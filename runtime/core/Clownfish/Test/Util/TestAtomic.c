@@ -56,10 +56,52 @@ test_cas_ptr(TestBatchRunner *runner) {
     TEST_TRUE(runner, target == bar_pointer, "cas_ptr sets target");
 }
 
+static void
+test_cas_size(TestBatchRunner *runner) {
+    size_t target = 5;
+
+    TEST_TRUE(runner, Atomic_cas_size(&target, 5, 7),
+              "cas_size returns true on success");
+    TEST_TRUE(runner, target == 7, "cas_size sets target");
+    TEST_FALSE(runner, Atomic_cas_size(&target, 5, 9),
+               "cas_size returns false when old_value doesn't match");
+    TEST_TRUE(runner, target == 7,
+              "cas_size doesn't do anything to target when old_value doesn't match");
+}
+
+static void
+test_fetch_add_size(TestBatchRunner *runner) {
+    size_t target = 10;
+
+    TEST_TRUE(runner, Atomic_fetch_add_size(&target, 3) == 10,
+              "fetch_add_size returns the old value");
+    TEST_TRUE(runner, target == 13, "fetch_add_size adds");
+    Atomic_fetch_add_size(&target, (size_t)-13);
+    TEST_TRUE(runner, target == 0, "fetch_add_size subtracts");
+}
+
+static void
+test_load_and_store(TestBatchRunner *runner) {
+    int     foo     = 1;
+    void   *pointer = NULL;
+    size_t  size    = 0;
+
+    Atomic_store_release_ptr(&pointer, &foo);
+    TEST_TRUE(runner, Atomic_load_acquire_ptr(&pointer) == &foo,
+              "store_release_ptr and load_acquire_ptr");
+    Atomic_store_release_size(&size, 42);
+    Atomic_fence();
+    TEST_TRUE(runner, Atomic_load_acquire_size(&size) == 42,
+              "store_release_size and load_acquire_size");
+}
+
 void
 TestAtomic_Run_IMP(TestAtomic *self, TestBatchRunner *runner) {
-    TestBatchRunner_Plan(runner, (TestBatch*)self, 6);
+    TestBatchRunner_Plan(runner, (TestBatch*)self, 15);
     test_cas_ptr(runner);
+    test_cas_size(runner);
+    test_fetch_add_size(runner);
+    test_load_and_store(runner);
 }
 
 
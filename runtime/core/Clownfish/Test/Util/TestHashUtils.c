@@ -0,0 +1,116 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <string.h>
+
+#define CFISH_USE_SHORT_NAMES
+#define TESTCFISH_USE_SHORT_NAMES
+
+#include "Clownfish/Test/Util/TestHashUtils.h"
+
+#include "Clownfish/ByteBuf.h"
+#include "Clownfish/String.h"
+#include "Clownfish/Test.h"
+#include "Clownfish/TestHarness/TestBatchRunner.h"
+#include "Clownfish/Util/HashUtils.h"
+#include "Clownfish/Class.h"
+
+TestHashUtils*
+TestHashUtil_new() {
+    return (TestHashUtils*)Class_Make_Obj(TESTHASHUTILS);
+}
+
+static void
+test_hash_bytes(TestBatchRunner *runner) {
+    char     buf[256];
+    char     shifted[264];
+    uint64_t hashes[200];
+    bool     aligned_ok   = true;
+    bool     distinct_ok  = true;
+
+    for (int i = 0; i < 256; i++) { buf[i] = (char)(i * 7 + 3); }
+
+    for (size_t size = 0; size < 200; size++) {
+        hashes[size] = HashUtil_hash_bytes(buf, size);
+
+        // Same bytes at a different alignment must produce the same hash.
+        memcpy(shifted + 3, buf, size);
+        if (HashUtil_hash_bytes(shifted + 3, size) != hashes[size]) {
+            aligned_ok = false;
+        }
+    }
+    TEST_TRUE(runner, aligned_ok, "hash_bytes ignores alignment");
+
+    // Prefixes of the same buffer must not collide.
+    for (size_t i = 0; i < 200; i++) {
+        for (size_t j = i + 1; j < 200; j++) {
+            if (hashes[i] == hashes[j]) { distinct_ok = false; }
+        }
+    }
+    TEST_TRUE(runner, distinct_ok, "hash_bytes of prefixes are distinct");
+
+    // Flipping a single bit changes about half of the output bits.
+    uint64_t total_flipped = 0;
+    for (int bit = 0; bit < 64 * 8; bit++) {
+        char copy[64];
+        memcpy(copy, buf, 64);
+        copy[bit / 8] ^= (char)(1 << (bit % 8));
+        uint64_t diff = HashUtil_hash_bytes(copy, 64) ^ hashes[64];
+        while (diff) {
+            total_flipped += diff & 1;
+            diff >>= 1;
+        }
+    }
+    double avg_flipped = (double)total_flipped / (64 * 8);
+    TEST_TRUE(runner, avg_flipped > 28.0 && avg_flipped < 36.0,
+              "single bit flips avalanche (%f bits changed on average)",
+              avg_flipped);
+
+    TEST_TRUE(runner, HashUtil_get_seed() != 0, "seed is initialized");
+}
+
+static void
+test_hash_sum(TestBatchRunner *runner) {
+    const char *text = "Clownfish::Util::HashUtils";
+    size_t      size = strlen(text);
+    int32_t     sum  = HashUtil_hash_sum(text, size);
+
+    TEST_INT_EQ(runner, sum, HashUtil_fold32(HashUtil_hash_bytes(text, size)),
+                "hash_sum folds hash_bytes");
+
+    String *string = Str_new_from_utf8(text, size);
+    TEST_INT_EQ(runner, Str_Hash_Sum(string), sum,
+                "String uses hash_sum");
+    DECREF(string);
+
+    StackString *wrapped = SSTR_WRAP_UTF8(text, size);
+    TEST_INT_EQ(runner, SStr_Hash_Sum(wrapped), sum,
+                "StackString uses hash_sum");
+
+    ByteBuf *bb = BB_new_bytes(text, size);
+    TEST_INT_EQ(runner, BB_Hash_Sum(bb), sum, "ByteBuf uses hash_sum");
+    DECREF(bb);
+}
+
+void
+TestHashUtil_Run_IMP(TestHashUtils *self, TestBatchRunner *runner) {
+    TestBatchRunner_Plan(runner, (TestBatch*)self, 8);
+    test_hash_bytes(runner);
+    test_hash_sum(runner);
+}
+
+
@@ -19,12 +19,25 @@
 
 #include "charmony.h"
 
+#include <stdlib.h>
+#include <string.h>
+
 #include "Clownfish/Test/Util/TestMemory.h"
 
 #include "Clownfish/Test.h"
 #include "Clownfish/TestHarness/TestBatchRunner.h"
 #include "Clownfish/Util/Memory.h"
+#include "Clownfish/CharBuf.h"
 #include "Clownfish/Class.h"
+#include "Clownfish/ConcurrentHash.h"
+#include "Clownfish/Hash.h"
+#include "Clownfish/HashSet.h"
+#include "Clownfish/I64Hash.h"
+#include "Clownfish/ObjHash.h"
+#include "Clownfish/OrderedHash.h"
+#include "Clownfish/Num.h"
+#include "Clownfish/String.h"
+#include "Clownfish/VArray.h"
 
 TestMemory*
 TestMemory_new() {
@@ -108,12 +121,289 @@ test_oversize__rounding(TestBatchRunner *runner) {
     PASS(runner, "Round allocations up to the size of a pointer");
 }
 
+static bool
+S_all_zero(const char *ptr, size_t size) {
+    for (size_t i = 0; i < size; i++) {
+        if (ptr[i] != 0) { return false; }
+    }
+    return true;
+}
+
+static void
+test_obj_alloc(TestBatchRunner *runner) {
+    char *block = (char*)Memory_obj_alloc(40);
+    TEST_TRUE(runner, S_all_zero(block, 40), "obj_alloc zeroes memory");
+    memset(block, 'x', 40);
+    Memory_obj_free(block, 40);
+
+    char *again = (char*)Memory_obj_alloc(40);
+#ifdef CFISH_NO_OBJ_SLABS
+    SKIP(runner, 1, "object slabs disabled");
+#else
+    TEST_TRUE(runner, again == block, "obj_free recycles block");
+#endif
+    TEST_TRUE(runner, S_all_zero(again, 40), "recycled block is zeroed");
+    Memory_obj_free(again, 40);
+
+    char *large = (char*)Memory_obj_alloc(1000);
+    TEST_TRUE(runner, S_all_zero(large, 1000),
+              "obj_alloc zeroes memory beyond the slab sizes");
+    Memory_obj_free(large, 1000);
+}
+
+static void
+test_arena(TestBatchRunner *runner) {
+    CharBuf *heap_buf = CB_new_from_trusted_utf8("heap", 4);
+    CB_Cat_Trusted_Utf8(heap_buf, " buffer", 7);
+
+    Memory_push_arena();
+    TEST_TRUE(runner, Memory_in_arena(), "in_arena after push_arena");
+
+    void *owner = Memory_obj_alloc(32);
+    TEST_TRUE(runner, S_all_zero((char*)owner, 32), "arena memory is zeroed");
+    char *buf = (char*)Memory_owned_malloc(owner, MEMORY_STRING, 16);
+    memset(buf, 'a', 16);
+    char *grown
+        = (char*)Memory_owned_realloc(owner, MEMORY_STRING, buf, 16, 100);
+    TEST_TRUE(runner, grown == buf, "last arena buffer grows in place");
+    TEST_TRUE(runner, grown[15] == 'a' && S_all_zero(grown + 16, 84),
+              "grown arena buffer keeps content");
+    Memory_owned_free(owner, MEMORY_STRING, grown, 100);
+    Memory_obj_free(owner, 32);
+
+    CharBuf *cb = CB_new(0);
+    for (int i = 0; i < 100; i++) {
+        CB_catf(cb, "%i32,", (int32_t)i);
+    }
+    String *joined = CB_Yield_String(cb);
+    TEST_TRUE(runner, Str_Starts_With_Utf8(joined, "0,1,2,", 6)
+                      && Str_Ends_With_Utf8(joined, "98,99,", 6),
+              "CharBuf grows in arena");
+
+    VArray *array = VA_new(0);
+    Hash   *hash  = Hash_new(0);
+    for (int32_t i = 0; i < 200; i++) {
+        String *key = Str_newf("key %i32", i);
+        VA_Push(array, (Obj*)Int32_new(i));
+        Hash_Store(hash, key, (Obj*)Int32_new(i));
+        DECREF(key);
+    }
+    String *wanted = (String*)SSTR_WRAP_UTF8("key 199", 7);
+    Integer32 *value = (Integer32*)Hash_Fetch(hash, wanted);
+    TEST_TRUE(runner, value && Int32_Get_Value(value) == 199
+                      && VA_Get_Size(array) == 200,
+              "VArray and Hash grow in arena");
+
+    String *adopted = CB_Yield_String(heap_buf);
+    TEST_TRUE(runner, Str_Equals_Utf8(adopted, "heap buffer", 11),
+              "arena String adopts heap buffer");
+
+    Memory_push_heap();
+    TEST_FALSE(runner, Memory_in_arena(), "in_arena false in heap scope");
+    String *kept = Str_new_from_trusted_utf8(Str_Get_Ptr8(joined),
+                                             Str_Get_Size(joined));
+    Memory_pop_scope();
+
+    DECREF(adopted);
+    DECREF(hash);
+    DECREF(array);
+    DECREF(joined);
+    DECREF(cb);
+    Memory_pop_scope();
+    TEST_FALSE(runner, Memory_in_arena(), "in_arena false after pop_scope");
+
+    TEST_TRUE(runner, Str_Ends_With_Utf8(kept, "98,99,", 6),
+              "String copied in heap scope survives the arena");
+    DECREF(kept);
+    DECREF(heap_buf);
+}
+
+static size_t num_counted_calls;
+static long   num_live_blocks;
+
+static void*
+S_counting_malloc(void *context, size_t size) {
+    num_counted_calls++;
+    num_live_blocks++;
+    return ((Allocator*)context)->malloc_func(NULL, size);
+}
+
+static void*
+S_counting_calloc(void *context, size_t count, size_t size) {
+    num_counted_calls++;
+    num_live_blocks++;
+    return ((Allocator*)context)->calloc_func(NULL, count, size);
+}
+
+static void*
+S_counting_realloc(void *context, void *ptr, size_t size) {
+    num_counted_calls++;
+    if (ptr == NULL) { num_live_blocks++; }
+    return ((Allocator*)context)->realloc_func(NULL, ptr, size);
+}
+
+static void
+S_counting_free(void *context, void *ptr) {
+    num_counted_calls++;
+    if (ptr != NULL) { num_live_blocks--; }
+    ((Allocator*)context)->free_func(NULL, ptr);
+}
+
+static void
+test_allocator(TestBatchRunner *runner) {
+    // Wrap the default allocator, so that memory can be freed after the
+    // counting allocator is removed.
+    Allocator libc = *Memory_get_allocator();
+    Allocator counting = {
+        S_counting_malloc, S_counting_calloc, S_counting_realloc,
+        S_counting_free, &libc
+    };
+
+    Memory_set_allocator(&counting);
+    TEST_TRUE(runner, Memory_get_allocator()->malloc_func == S_counting_malloc,
+              "set_allocator installs allocator");
+    num_counted_calls = 0;
+    char *ptr = (char*)MALLOCATE(10);
+    ptr = (char*)REALLOCATE(ptr, 1000);
+    FREEMEM(ptr);
+    String *string = Str_newf("%s", "routed through the allocator");
+    DECREF(string);
+    Memory_set_allocator(NULL);
+
+    TEST_TRUE(runner, num_counted_calls >= 5,
+              "allocations go through the installed allocator");
+    TEST_TRUE(runner, Memory_get_allocator()->malloc_func == libc.malloc_func,
+              "set_allocator(NULL) restores the default");
+}
+
+static void
+test_arena_hash_tables(TestBatchRunner *runner) {
+    Allocator libc = *Memory_get_allocator();
+    Allocator counting = {
+        S_counting_malloc, S_counting_calloc, S_counting_realloc,
+        S_counting_free, &libc
+    };
+
+    // Tables of hashes made in an arena live in the arena as well, so no
+    // heap memory is left over once the arena's chunks are released.
+    Memory_set_allocator(&counting);
+    num_live_blocks = 0;
+    Memory_push_arena();
+    ObjHash        *obj_hash  = ObjHash_new(0);
+    I64Hash        *i64_hash  = I64Hash_new(0);
+    HashSet        *set       = HashSet_new(0);
+    OrderedHash    *ord_hash  = OrdHash_new(0);
+    ConcurrentHash *conc_hash = CHash_new(0);
+    for (int32_t i = 0; i < 100; i++) {
+        String *key = Str_newf("%i32", i);
+        ObjHash_Store(obj_hash, (Obj*)key, INCREF(key));
+        I64Hash_Store(i64_hash, i, INCREF(key));
+        HashSet_Add(set, key);
+        OrdHash_Store(ord_hash, key, INCREF(key));
+        CHash_Store(conc_hash, key, INCREF(key));
+        DECREF(key);
+    }
+    CHash_Reclaim(conc_hash);
+    Memory_pop_scope();
+    Memory_set_allocator(NULL);
+
+    TEST_INT_EQ(runner, num_live_blocks, 0,
+                "hash tables in an arena take no heap memory");
+}
+
+static void
+test_stats(TestBatchRunner *runner) {
+    bool was_enabled = Memory_stats_enabled();
+    Memory_enable_stats(true);
+    TEST_TRUE(runner, Memory_stats_enabled(), "enable_stats");
+
+    MemoryStats before, after;
+    // Short Strings store their characters inline, so use a long one.
+    char chars[100];
+    memset(chars, 'x', sizeof(chars));
+    Memory_get_stats(MEMORY_STRING, &before);
+    String *string = Str_new_from_trusted_utf8(chars, sizeof(chars));
+    Memory_get_stats(MEMORY_STRING, &after);
+    TEST_INT_EQ(runner, after.num_allocs - before.num_allocs, 1,
+                "String buffer counted");
+    TEST_INT_EQ(runner, after.bytes_allocated - before.bytes_allocated, 101,
+                "String buffer bytes counted");
+    DECREF(string);
+
+    CharBuf *buf = CB_new(0);
+    for (int i = 0; i < 100; i++) {
+        CB_Cat_Trusted_Utf8(buf, "abcdefghij", 10);
+    }
+    string = CB_Yield_String(buf);
+    DECREF(buf);
+    DECREF(string);
+    Memory_get_stats(MEMORY_STRING, &after);
+    TEST_INT_EQ(runner, after.bytes_allocated - after.bytes_freed,
+                before.bytes_allocated - before.bytes_freed,
+                "no live String bytes after String and CharBuf are freed");
+
+    Memory_get_stats(MEMORY_HASH, &before);
+    Memory_get_stats(MEMORY_OBJECT, &after);
+    size_t obj_live = after.bytes_allocated - after.bytes_freed;
+    Hash *hash = Hash_new(0);
+    for (int32_t i = 0; i < 100; i++) {
+        String *key = Str_newf("%i32", i);
+        Hash_Store(hash, key, (Obj*)Int32_new(i));
+        DECREF(key);
+    }
+    Memory_get_stats(MEMORY_HASH, &after);
+    TEST_TRUE(runner, after.bytes_allocated > before.bytes_allocated
+                      && after.num_frees > before.num_frees,
+              "Hash tables counted");
+    DECREF(hash);
+    Memory_get_stats(MEMORY_HASH, &after);
+    TEST_INT_EQ(runner, after.bytes_allocated - after.bytes_freed,
+                before.bytes_allocated - before.bytes_freed,
+                "no live Hash bytes after Hash is freed");
+    Memory_get_stats(MEMORY_OBJECT, &after);
+    TEST_INT_EQ(runner, after.bytes_allocated - after.bytes_freed, obj_live,
+                "no live object bytes after objects are freed");
+
+    TEST_TRUE(runner, strcmp(Memory_tag_name(MEMORY_VARRAY), "VArray") == 0,
+              "tag_name");
+    TEST_TRUE(runner, Memory_tag_name(MEMORY_NUM_TAGS) == NULL,
+              "tag_name for invalid tag");
+
+    Memory_enable_stats(was_enabled);
+}
+
+static void
+test_epochs(TestBatchRunner *runner) {
+    Memory_epoch_enter();
+    Memory_epoch_enter();
+    size_t epoch = Memory_epoch_advance();
+    TEST_FALSE(runner, Memory_epoch_quiescent(epoch),
+               "thread which entered before the advance holds up epoch");
+    Memory_epoch_exit();
+    TEST_FALSE(runner, Memory_epoch_quiescent(epoch),
+               "epoch_enter nests");
+    Memory_epoch_exit();
+    TEST_TRUE(runner, Memory_epoch_quiescent(epoch),
+              "epoch quiescent after epoch_exit");
+
+    Memory_epoch_enter();
+    TEST_TRUE(runner, Memory_epoch_quiescent(epoch),
+              "thread which entered after the advance doesn't hold it up");
+    Memory_epoch_exit();
+}
+
 void
 TestMemory_Run_IMP(TestMemory *self, TestBatchRunner *runner) {
-    TestBatchRunner_Plan(runner, (TestBatch*)self, 30);
+    TestBatchRunner_Plan(runner, (TestBatch*)self, 61);
     test_oversize__growth_rate(runner);
     test_oversize__ceiling(runner);
     test_oversize__rounding(runner);
+    test_obj_alloc(runner);
+    test_arena(runner);
+    test_allocator(runner);
+    test_arena_hash_tables(runner);
+    test_stats(runner);
+    test_epochs(runner);
 }
 
 
@@ -32,6 +32,11 @@ cfish_Atomic_wrapped_cas_ptr(void *volatile *target, void *old_value,
            == old_value;
 }
 
+void
+cfish_Atomic_wrapped_fence(void) {
+    MemoryBarrier();
+}
+
 /************************** Fall back to ptheads ***************************/
 #elif defined(CHY_HAS_PTHREAD_H)
 
@@ -31,6 +31,47 @@ extern "C" {
 static CFISH_INLINE bool
 cfish_Atomic_cas_ptr(void *volatile *target, void *old_value, void *new_value);
 
+/** Compare and swap a size_t, like cfish_Atomic_cas_ptr.
+ */
+static CFISH_INLINE bool
+cfish_Atomic_cas_size(volatile size_t *target, size_t old_value,
+                      size_t new_value);
+
+/** Add `amount` to the size_t at `target` and return the previous value.
+ * Subtract by adding `(size_t)-N`.
+ */
+static CFISH_INLINE size_t
+cfish_Atomic_fetch_add_size(volatile size_t *target, size_t amount);
+
+/** Load a pointer.  Memory accesses which follow in program order can't be
+ * moved before the load.
+ */
+static CFISH_INLINE void*
+cfish_Atomic_load_acquire_ptr(void *volatile *source);
+
+/** Store a pointer.  Memory accesses which precede in program order can't
+ * be moved after the store.
+ */
+static CFISH_INLINE void
+cfish_Atomic_store_release_ptr(void *volatile *target, void *value);
+
+/** Load a size_t with acquire semantics, like
+ * cfish_Atomic_load_acquire_ptr.
+ */
+static CFISH_INLINE size_t
+cfish_Atomic_load_acquire_size(volatile size_t *source);
+
+/** Store a size_t with release semantics, like
+ * cfish_Atomic_store_release_ptr.
+ */
+static CFISH_INLINE void
+cfish_Atomic_store_release_size(volatile size_t *target, size_t value);
+
+/** Full memory barrier.
+ */
+static CFISH_INLINE void
+cfish_Atomic_fence(void);
+
 /************************** Single threaded *******************************/
 #ifdef CFISH_NOTHREADS
 
@@ -45,6 +86,70 @@ cfish_Atomic_cas_ptr(void *volatile *target, void *old_value, void *new_value) {
     }
 }
 
+static CFISH_INLINE bool
+cfish_Atomic_cas_size(volatile size_t *target, size_t old_value,
+                      size_t new_value) {
+    if (*target == old_value) {
+        *target = new_value;
+        return true;
+    }
+    else {
+        return false;
+    }
+}
+
+static CFISH_INLINE void
+cfish_Atomic_fence(void) {
+}
+
+/********************** GCC 4.7 and later, Clang **************************/
+#elif defined(__ATOMIC_SEQ_CST)
+
+#define CFISH_ATOMIC_NATIVE_OPS
+
+static CFISH_INLINE bool
+cfish_Atomic_cas_ptr(void *volatile *target, void *old_value, void *new_value) {
+    return __atomic_compare_exchange_n(target, &old_value, new_value, false,
+                                       __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+}
+
+static CFISH_INLINE bool
+cfish_Atomic_cas_size(volatile size_t *target, size_t old_value,
+                      size_t new_value) {
+    return __atomic_compare_exchange_n(target, &old_value, new_value, false,
+                                       __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+}
+
+static CFISH_INLINE size_t
+cfish_Atomic_fetch_add_size(volatile size_t *target, size_t amount) {
+    return __atomic_fetch_add(target, amount, __ATOMIC_ACQ_REL);
+}
+
+static CFISH_INLINE void*
+cfish_Atomic_load_acquire_ptr(void *volatile *source) {
+    return __atomic_load_n(source, __ATOMIC_ACQUIRE);
+}
+
+static CFISH_INLINE void
+cfish_Atomic_store_release_ptr(void *volatile *target, void *value) {
+    __atomic_store_n(target, value, __ATOMIC_RELEASE);
+}
+
+static CFISH_INLINE size_t
+cfish_Atomic_load_acquire_size(volatile size_t *source) {
+    return __atomic_load_n(source, __ATOMIC_ACQUIRE);
+}
+
+static CFISH_INLINE void
+cfish_Atomic_store_release_size(volatile size_t *target, size_t value) {
+    __atomic_store_n(target, value, __ATOMIC_RELEASE);
+}
+
+static CFISH_INLINE void
+cfish_Atomic_fence(void) {
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+
 /************************** Mac OS X 10.4 and later ***********************/
 #elif defined(CHY_HAS_OSATOMIC_CAS_PTR)
 #include <libkern/OSAtomic.h>
@@ -54,6 +159,19 @@ cfish_Atomic_cas_ptr(void *volatile *target, void *old_value, void *new_value) {
     return OSAtomicCompareAndSwapPtr(old_value, new_value, target);
 }
 
+static CFISH_INLINE bool
+cfish_Atomic_cas_size(volatile size_t *target, size_t old_value,
+                      size_t new_value) {
+    return OSAtomicCompareAndSwapPtrBarrier((void*)old_value,
+                                            (void*)new_value,
+                                            (void*volatile*)target);
+}
+
+static CFISH_INLINE void
+cfish_Atomic_fence(void) {
+    OSMemoryBarrier();
+}
+
 /********************************** Windows *******************************/
 #elif defined(CHY_HAS_WINDOWS_H)
 
@@ -61,11 +179,26 @@ bool
 cfish_Atomic_wrapped_cas_ptr(void *volatile *target, void *old_value,
                             void *new_value);
 
+void
+cfish_Atomic_wrapped_fence(void);
+
 static CFISH_INLINE bool
 cfish_Atomic_cas_ptr(void *volatile *target, void *old_value, void *new_value) {
     return cfish_Atomic_wrapped_cas_ptr(target, old_value, new_value);
 }
 
+static CFISH_INLINE bool
+cfish_Atomic_cas_size(volatile size_t *target, size_t old_value,
+                      size_t new_value) {
+    return cfish_Atomic_wrapped_cas_ptr((void*volatile*)target,
+                                        (void*)old_value, (void*)new_value);
+}
+
+static CFISH_INLINE void
+cfish_Atomic_fence(void) {
+    cfish_Atomic_wrapped_fence();
+}
+
 /**************************** Solaris 10 and later ************************/
 #elif defined(CHY_HAS_SYS_ATOMIC_H)
 #include <sys/atomic.h>
@@ -75,6 +208,19 @@ cfish_Atomic_cas_ptr(void *volatile *target, void *old_value, void *new_value) {
     return atomic_cas_ptr(target, old_value, new_value) == old_value;
 }
 
+static CFISH_INLINE bool
+cfish_Atomic_cas_size(volatile size_t *target, size_t old_value,
+                      size_t new_value) {
+    return atomic_cas_ulong((volatile ulong_t*)target, old_value, new_value)
+           == old_value;
+}
+
+static CFISH_INLINE void
+cfish_Atomic_fence(void) {
+    membar_enter();
+    membar_exit();
+}
+
 /****************************** GCC 4.1 and later *************************/
 #elif defined(CHY_HAS___SYNC_BOOL_COMPARE_AND_SWAP)
 
@@ -83,6 +229,17 @@ cfish_Atomic_cas_ptr(void *volatile *target, void *old_value, void *new_value) {
     return __sync_bool_compare_and_swap(target, old_value, new_value);
 }
 
+static CFISH_INLINE bool
+cfish_Atomic_cas_size(volatile size_t *target, size_t old_value,
+                      size_t new_value) {
+    return __sync_bool_compare_and_swap(target, old_value, new_value);
+}
+
+static CFISH_INLINE void
+cfish_Atomic_fence(void) {
+    __sync_synchronize();
+}
+
 /************************ Fall back to pthread.h. **************************/
 #elif defined(CHY_HAS_PTHREAD_H)
 #include <pthread.h>
@@ -103,6 +260,28 @@ cfish_Atomic_cas_ptr(void *volatile *target, void *old_value, void *new_value) {
     }
 }
 
+static CFISH_INLINE bool
+cfish_Atomic_cas_size(volatile size_t *target, size_t old_value,
+                      size_t new_value) {
+    pthread_mutex_lock(&cfish_Atomic_mutex);
+    if (*target == old_value) {
+        *target = new_value;
+        pthread_mutex_unlock(&cfish_Atomic_mutex);
+        return true;
+    }
+    else {
+        pthread_mutex_unlock(&cfish_Atomic_mutex);
+        return false;
+    }
+}
+
+// Locking and unlocking a mutex implies a full barrier.
+static CFISH_INLINE void
+cfish_Atomic_fence(void) {
+    pthread_mutex_lock(&cfish_Atomic_mutex);
+    pthread_mutex_unlock(&cfish_Atomic_mutex);
+}
+
 /******************** No support for atomics at all. ***********************/
 #else
 
@@ -110,8 +289,56 @@ cfish_Atomic_cas_ptr(void *volatile *target, void *old_value, void *new_value) {
 
 #endif /* Big platform if-else chain. */
 
+/********** Operations derived from compare-and-swap and fences ************/
+#ifndef CFISH_ATOMIC_NATIVE_OPS
+
+static CFISH_INLINE size_t
+cfish_Atomic_fetch_add_size(volatile size_t *target, size_t amount) {
+    while (1) {
+        size_t old_value = *target;
+        if (cfish_Atomic_cas_size(target, old_value, old_value + amount)) {
+            return old_value;
+        }
+    }
+}
+
+static CFISH_INLINE void*
+cfish_Atomic_load_acquire_ptr(void *volatile *source) {
+    void *value = *source;
+    cfish_Atomic_fence();
+    return value;
+}
+
+static CFISH_INLINE void
+cfish_Atomic_store_release_ptr(void *volatile *target, void *value) {
+    cfish_Atomic_fence();
+    *target = value;
+}
+
+static CFISH_INLINE size_t
+cfish_Atomic_load_acquire_size(volatile size_t *source) {
+    size_t value = *source;
+    cfish_Atomic_fence();
+    return value;
+}
+
+static CFISH_INLINE void
+cfish_Atomic_store_release_size(volatile size_t *target, size_t value) {
+    cfish_Atomic_fence();
+    *target = value;
+}
+
+#endif /* CFISH_ATOMIC_NATIVE_OPS */
+
 #ifdef CFISH_USE_SHORT_NAMES
-  #define Atomic_cas_ptr cfish_Atomic_cas_ptr
+  #define Atomic_cas_ptr            cfish_Atomic_cas_ptr
+  #define Atomic_cas_size           cfish_Atomic_cas_size
+  #define Atomic_fetch_add_size     cfish_Atomic_fetch_add_size
+  #define Atomic_load_acquire_ptr   cfish_Atomic_load_acquire_ptr
+  #define Atomic_store_release_ptr  cfish_Atomic_store_release_ptr
+  #define Atomic_load_acquire_size  cfish_Atomic_load_acquire_size
+  #define Atomic_store_release_size cfish_Atomic_store_release_size
+  #define Atomic_fence              cfish_Atomic_fence
 #endif
 
 #ifdef __cplusplus
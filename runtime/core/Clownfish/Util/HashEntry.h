@@ -0,0 +1,47 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/* Private layout of the entries of a Hash, shared by Hash and HashIterator.
+ *
+ * Hash sums aren't stored with the entries: String caches its own, and the
+ * control bytes filter out all but 1/128 of non-matching candidates.
+ */
+
+#ifndef H_CLOWNFISH_UTIL_HASHENTRY
+#define H_CLOWNFISH_UTIL_HASHENTRY 1
+
+#include "cfish_parcel.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct cfish_HashEntry {
+    cfish_String  *key;
+    cfish_Obj     *value;
+} cfish_HashEntry;
+
+#ifdef CFISH_USE_SHORT_NAMES
+  #define HashEntry                 cfish_HashEntry
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* H_CLOWNFISH_UTIL_HASHENTRY */
+
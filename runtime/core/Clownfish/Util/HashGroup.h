@@ -0,0 +1,477 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/* Control-byte group primitives shared by Clownfish's open-addressing hash
+ * tables.
+ *
+ * Every slot of a table has a one-byte control word stored in a separate,
+ * densely packed array.  A control byte is either EMPTY, DELETED, or -- for
+ * occupied slots -- the low 7 bits of the key's hash sum ("h2").  Slots are
+ * probed a group of 16 at a time: a single SIMD comparison yields a bitmask
+ * of the slots in a group whose control byte matches, so only candidates
+ * whose h2 agrees with the sought key ever have their keys compared.
+ *
+ * Groups are aligned; the probe sequence visits whole groups in triangular
+ * order, which reaches every group when the number of groups is a power of
+ * two.  A lookup stops at the first group containing an EMPTY slot, so a
+ * table must always keep at least one EMPTY slot.
+ *
+ * Defining CFISH_HASHGROUP_SCALAR forces the portable fallback.
+ */
+
+#ifndef H_CLOWNFISH_UTIL_HASHGROUP
+#define H_CLOWNFISH_UTIL_HASHGROUP 1
+
+#include <string.h>
+
+#include "charmony.h"
+#include "cfish_parcel.h"
+#include "Clownfish/Util/Memory.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CFISH_HASHGROUP_WIDTH   16
+#define CFISH_HASHGROUP_SHIFT   4
+#define CFISH_HASHCTRL_EMPTY    ((uint8_t)0x80)
+#define CFISH_HASHCTRL_DELETED  ((uint8_t)0xFE)
+
+#if defined(CFISH_HASHGROUP_SCALAR)
+  /* Portable fallback requested. */
+#elif defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64) \
+      || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+  #define CFISH_HASHGROUP_SSE2
+  #include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+  #define CFISH_HASHGROUP_NEON
+  #include <arm_neon.h>
+#endif
+
+#if defined(_MSC_VER)
+  #include <intrin.h>
+#endif
+
+/** Return true if the control byte marks an occupied slot.
+ */
+static CFISH_INLINE bool
+cfish_HashCtrl_is_full(uint8_t ctrl) {
+    return ctrl < 0x80;
+}
+
+/** Return the 7-bit fragment of `hash_sum` which is stored in the control
+ * byte of an occupied slot.
+ */
+static CFISH_INLINE uint8_t
+cfish_HashGroup_h2(int32_t hash_sum) {
+    return (uint8_t)((uint32_t)hash_sum & 0x7F);
+}
+
+/** Return the index of the lowest set bit in a non-zero match mask.
+ */
+static CFISH_INLINE uint32_t
+cfish_HashGroup_lowest(uint32_t mask) {
+#if defined(__GNUC__)
+    return (uint32_t)__builtin_ctz(mask);
+#elif defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return (uint32_t)index;
+#else
+    uint32_t index = 0;
+    while (!(mask & 1)) {
+        mask >>= 1;
+        index++;
+    }
+    return index;
+#endif
+}
+
+/** Hint that the cache line holding `ptr` will be read soon.
+ */
+static CFISH_INLINE void
+cfish_HashGroup_prefetch(const void *ptr) {
+#if defined(__GNUC__)
+    __builtin_prefetch(ptr, 0, 3);
+#elif defined(CFISH_HASHGROUP_SSE2)
+    _mm_prefetch((const char*)ptr, _MM_HINT_T0);
+#else
+    (void)ptr;
+#endif
+}
+
+/** Return a mask with bit `i` set for each control byte in the group
+ * which equals `h2`.
+ */
+static CFISH_INLINE uint32_t
+cfish_HashGroup_match(const uint8_t *group, uint8_t h2);
+
+/** Return a mask of the EMPTY slots in the group.
+ */
+static CFISH_INLINE uint32_t
+cfish_HashGroup_match_empty(const uint8_t *group);
+
+/** Return a mask of the slots in the group which are EMPTY or DELETED,
+ * i.e. available for insertion.
+ */
+static CFISH_INLINE uint32_t
+cfish_HashGroup_match_free(const uint8_t *group);
+
+/********************************** SSE2 **********************************/
+#if defined(CFISH_HASHGROUP_SSE2)
+
+static CFISH_INLINE uint32_t
+cfish_HashGroup_match(const uint8_t *group, uint8_t h2) {
+    __m128i ctrl = _mm_loadu_si128((const __m128i*)group);
+    __m128i eq   = _mm_cmpeq_epi8(ctrl, _mm_set1_epi8((char)h2));
+    return (uint32_t)_mm_movemask_epi8(eq);
+}
+
+static CFISH_INLINE uint32_t
+cfish_HashGroup_match_empty(const uint8_t *group) {
+    return cfish_HashGroup_match(group, CFISH_HASHCTRL_EMPTY);
+}
+
+static CFISH_INLINE uint32_t
+cfish_HashGroup_match_free(const uint8_t *group) {
+    // EMPTY and DELETED are the only control bytes with the high bit set.
+    __m128i ctrl = _mm_loadu_si128((const __m128i*)group);
+    return (uint32_t)_mm_movemask_epi8(ctrl);
+}
+
+/********************************** NEON **********************************/
+#elif defined(CFISH_HASHGROUP_NEON)
+
+static CFISH_INLINE uint32_t
+cfish_HashGroup_neon_mask(uint8x16_t eq) {
+    static const uint8_t weights[16] = {
+        1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128
+    };
+    uint8x16_t bits = vandq_u8(eq, vld1q_u8(weights));
+    return (uint32_t)vaddv_u8(vget_low_u8(bits))
+           | ((uint32_t)vaddv_u8(vget_high_u8(bits)) << 8);
+}
+
+static CFISH_INLINE uint32_t
+cfish_HashGroup_match(const uint8_t *group, uint8_t h2) {
+    uint8x16_t ctrl = vld1q_u8(group);
+    return cfish_HashGroup_neon_mask(vceqq_u8(ctrl, vdupq_n_u8(h2)));
+}
+
+static CFISH_INLINE uint32_t
+cfish_HashGroup_match_empty(const uint8_t *group) {
+    return cfish_HashGroup_match(group, CFISH_HASHCTRL_EMPTY);
+}
+
+static CFISH_INLINE uint32_t
+cfish_HashGroup_match_free(const uint8_t *group) {
+    uint8x16_t ctrl = vld1q_u8(group);
+    return cfish_HashGroup_neon_mask(vcgeq_u8(ctrl, vdupq_n_u8(0x80)));
+}
+
+/********************************* Scalar *********************************/
+#else
+
+static CFISH_INLINE uint32_t
+cfish_HashGroup_match(const uint8_t *group, uint8_t h2) {
+    uint32_t mask = 0;
+    for (uint32_t i = 0; i < CFISH_HASHGROUP_WIDTH; i++) {
+        if (group[i] == h2) { mask |= 1u << i; }
+    }
+    return mask;
+}
+
+static CFISH_INLINE uint32_t
+cfish_HashGroup_match_empty(const uint8_t *group) {
+    return cfish_HashGroup_match(group, CFISH_HASHCTRL_EMPTY);
+}
+
+static CFISH_INLINE uint32_t
+cfish_HashGroup_match_free(const uint8_t *group) {
+    uint32_t mask = 0;
+    for (uint32_t i = 0; i < CFISH_HASHGROUP_WIDTH; i++) {
+        if (group[i] & 0x80) { mask |= 1u << i; }
+    }
+    return mask;
+}
+
+#endif
+
+/******************************* Probing **********************************/
+
+typedef struct cfish_HashProbe {
+    uint32_t group;
+    uint32_t mask;
+    uint32_t step;
+} cfish_HashProbe;
+
+/** Start the probe sequence for `hash_sum` in a table with `capacity`
+ * slots.  `capacity` must be a power of two no smaller than the group
+ * width.
+ */
+static CFISH_INLINE void
+cfish_HashProbe_init(cfish_HashProbe *probe, int32_t hash_sum,
+                     uint32_t capacity) {
+    probe->mask  = (capacity >> CFISH_HASHGROUP_SHIFT) - 1;
+    probe->group = ((uint32_t)hash_sum >> 7) & probe->mask;
+    probe->step  = 0;
+}
+
+/** Return the index of the first slot in the current group.
+ */
+static CFISH_INLINE size_t
+cfish_HashProbe_offset(const cfish_HashProbe *probe) {
+    return (size_t)probe->group << CFISH_HASHGROUP_SHIFT;
+}
+
+/** Advance to the next group in the probe sequence.
+ */
+static CFISH_INLINE void
+cfish_HashProbe_next(cfish_HashProbe *probe) {
+    probe->step++;
+    probe->group = (probe->group + probe->step) & probe->mask;
+}
+
+/** Return the number of occupied or DELETED slots a table of `capacity`
+ * slots may hold before it has to grow: a load factor of 7/8.
+ */
+static CFISH_INLINE uint32_t
+cfish_HashGroup_threshold(uint32_t capacity) {
+    return capacity - capacity / 8;
+}
+
+/** Find the first slot available for insertion along the probe sequence of
+ * `hash_sum`.  The table must contain at least one EMPTY or DELETED slot.
+ */
+static CFISH_INLINE size_t
+cfish_HashGroup_find_free(const uint8_t *ctrl, uint32_t capacity,
+                          int32_t hash_sum) {
+    cfish_HashProbe probe;
+    cfish_HashProbe_init(&probe, hash_sum, capacity);
+    while (1) {
+        size_t   offset = cfish_HashProbe_offset(&probe);
+        uint32_t free   = cfish_HashGroup_match_free(ctrl + offset);
+        if (free) {
+            return offset + cfish_HashGroup_lowest(free);
+        }
+        cfish_HashProbe_next(&probe);
+    }
+}
+
+/** Mark the occupied slot at `tick` as vacated.  If the slot's group still
+ * has an EMPTY slot, no probe sequence can have passed through the group,
+ * so the slot reverts to EMPTY.  Otherwise it becomes DELETED, and true is
+ * returned so that the caller can account for the new tombstone.
+ */
+static CFISH_INLINE bool
+cfish_HashGroup_vacate(uint8_t *ctrl, size_t tick) {
+    size_t offset = tick & ~(size_t)(CFISH_HASHGROUP_WIDTH - 1);
+    if (cfish_HashGroup_match_empty(ctrl + offset)) {
+        ctrl[tick] = CFISH_HASHCTRL_EMPTY;
+        return false;
+    }
+    else {
+        ctrl[tick] = CFISH_HASHCTRL_DELETED;
+        return true;
+    }
+}
+
+/******************************** Tables **********************************/
+
+/* A table is a single block holding `capacity` entries of `entry_size`
+ * bytes, followed by `capacity` control bytes.  Entries are opaque to the
+ * helpers below: each table type supplies the functions which hash an entry
+ * and compare it to a key, and these are inlined into the probe loops.
+ */
+
+/** Return true if `entry` holds `key`.
+ */
+typedef bool
+(*cfish_HashGroup_Equals_t)(const void *entry, const void *key);
+
+/** Return the hash sum of the key in `entry`.
+ */
+typedef int32_t
+(*cfish_HashGroup_Hash_t)(const void *entry, void *context);
+
+/** Return the smallest capacity which holds `num_entries` without reaching
+ * the threshold.
+ */
+static CFISH_INLINE uint32_t
+cfish_HashGroup_capacity_for(uint32_t num_entries) {
+    uint32_t capacity = CFISH_HASHGROUP_WIDTH;
+    while (cfish_HashGroup_threshold(capacity) <= num_entries) {
+        capacity *= 2;
+    }
+    return capacity;
+}
+
+/** Return the capacity of the table which replaces a table of `capacity`
+ * slots holding `size` entries once it reached its threshold.  When
+ * tombstones make up much of the table, rehashing without growing makes
+ * enough room.  Return 0 if the table can't grow any further.
+ */
+static CFISH_INLINE uint32_t
+cfish_HashGroup_rebuild_capacity(uint32_t size, uint32_t capacity) {
+    if (size <= cfish_HashGroup_threshold(capacity) / 2) {
+        // Mostly tombstones: rehash without growing.
+        return cfish_HashGroup_capacity_for(size * 2);
+    }
+    // Iterator ticks are int32_t.
+    return capacity > INT32_MAX / 2 ? 0 : capacity * 2;
+}
+
+/** Return the size of the block which holds a table.
+ */
+static CFISH_INLINE size_t
+cfish_HashGroup_table_size(uint32_t capacity, size_t entry_size) {
+    return capacity * (entry_size + 1);
+}
+
+/** Return the control bytes of a table.
+ */
+static CFISH_INLINE uint8_t*
+cfish_HashGroup_ctrl(void *entries, uint32_t capacity, size_t entry_size) {
+    return (uint8_t*)entries + capacity * entry_size;
+}
+
+/** Allocate a table in the region of `owner`, accounted to
+ * CFISH_MEMORY_HASH, and mark all slots EMPTY.
+ */
+static CFISH_INLINE void*
+cfish_HashGroup_alloc_table(void *owner, uint32_t capacity,
+                            size_t entry_size) {
+    size_t  size    = cfish_HashGroup_table_size(capacity, entry_size);
+    void   *entries = cfish_Memory_owned_malloc(owner, CFISH_MEMORY_HASH,
+                                                size);
+    memset(cfish_HashGroup_ctrl(entries, capacity, entry_size),
+           CFISH_HASHCTRL_EMPTY, capacity);
+    return entries;
+}
+
+/** Free a table from [](.alloc_table).
+ */
+static CFISH_INLINE void
+cfish_HashGroup_free_table(void *owner, void *entries, uint32_t capacity,
+                           size_t entry_size) {
+    cfish_Memory_owned_free(owner, CFISH_MEMORY_HASH, entries,
+                            cfish_HashGroup_table_size(capacity, entry_size));
+}
+
+/** Claim the first free slot along the probe sequence of `hash_sum` for a
+ * key known to be absent, and return its index.  Reusing a tombstone makes
+ * room for another entry below `threshold`.  The caller fills in the entry
+ * and must make sure there is room.
+ */
+static CFISH_INLINE size_t
+cfish_HashGroup_claim(uint8_t *ctrl, uint32_t capacity, int32_t hash_sum,
+                      uint32_t *threshold) {
+    size_t tick = cfish_HashGroup_find_free(ctrl, capacity, hash_sum);
+    if (ctrl[tick] == CFISH_HASHCTRL_DELETED) {
+        (*threshold)++;
+    }
+    ctrl[tick] = cfish_HashGroup_h2(hash_sum);
+    return tick;
+}
+
+/** Return the entry which holds `key`, or NULL if there is none.
+ */
+static CFISH_INLINE void*
+cfish_HashGroup_find(void *entries, size_t entry_size, const uint8_t *ctrl,
+                     uint32_t capacity, int32_t hash_sum, const void *key,
+                     cfish_HashGroup_Equals_t equals) {
+    const uint8_t h2 = cfish_HashGroup_h2(hash_sum);
+    cfish_HashProbe probe;
+
+    cfish_HashProbe_init(&probe, hash_sum, capacity);
+    while (1) {
+        size_t   offset  = cfish_HashProbe_offset(&probe);
+        uint32_t matches = cfish_HashGroup_match(ctrl + offset, h2);
+        while (matches) {
+            size_t tick = offset + cfish_HashGroup_lowest(matches);
+            char  *entry = (char*)entries + tick * entry_size;
+            if (equals(entry, key)) {
+                return entry;
+            }
+            matches &= matches - 1;
+        }
+        if (cfish_HashGroup_match_empty(ctrl + offset)) {
+            return NULL;
+        }
+        cfish_HashProbe_next(&probe);
+    }
+}
+
+/** Copy the entries of an old table into an empty new one.
+ */
+static CFISH_INLINE void
+cfish_HashGroup_rehash(void *entries, uint32_t capacity,
+                       void *old_entries, uint32_t old_capacity,
+                       size_t entry_size, cfish_HashGroup_Hash_t hash,
+                       void *context) {
+    uint8_t *ctrl     = cfish_HashGroup_ctrl(entries, capacity, entry_size);
+    uint8_t *old_ctrl = cfish_HashGroup_ctrl(old_entries, old_capacity,
+                                             entry_size);
+    for (uint32_t i = 0; i < old_capacity; i++) {
+        if (!cfish_HashCtrl_is_full(old_ctrl[i])) { continue; }
+        const char *old_entry = (char*)old_entries + i * entry_size;
+        int32_t     hash_sum  = hash(old_entry, context);
+        size_t      tick      = cfish_HashGroup_find_free(ctrl, capacity,
+                                                          hash_sum);
+        ctrl[tick] = cfish_HashGroup_h2(hash_sum);
+        memcpy((char*)entries + tick * entry_size, old_entry, entry_size);
+    }
+}
+
+#ifdef CFISH_USE_SHORT_NAMES
+  #define HASHGROUP_WIDTH           CFISH_HASHGROUP_WIDTH
+  #define HASHGROUP_SHIFT           CFISH_HASHGROUP_SHIFT
+  #define HASHCTRL_EMPTY            CFISH_HASHCTRL_EMPTY
+  #define HASHCTRL_DELETED          CFISH_HASHCTRL_DELETED
+  #define HashCtrl_is_full          cfish_HashCtrl_is_full
+  #define HashGroup_h2              cfish_HashGroup_h2
+  #define HashGroup_lowest          cfish_HashGroup_lowest
+  #define HashGroup_prefetch        cfish_HashGroup_prefetch
+  #define HashGroup_match           cfish_HashGroup_match
+  #define HashGroup_match_empty     cfish_HashGroup_match_empty
+  #define HashGroup_match_free      cfish_HashGroup_match_free
+  #define HashGroup_threshold       cfish_HashGroup_threshold
+  #define HashGroup_find_free       cfish_HashGroup_find_free
+  #define HashGroup_vacate          cfish_HashGroup_vacate
+  #define HashGroup_Equals_t        cfish_HashGroup_Equals_t
+  #define HashGroup_Hash_t          cfish_HashGroup_Hash_t
+  #define HashGroup_capacity_for    cfish_HashGroup_capacity_for
+  #define HashGroup_rebuild_capacity cfish_HashGroup_rebuild_capacity
+  #define HashGroup_table_size      cfish_HashGroup_table_size
+  #define HashGroup_ctrl            cfish_HashGroup_ctrl
+  #define HashGroup_alloc_table     cfish_HashGroup_alloc_table
+  #define HashGroup_free_table      cfish_HashGroup_free_table
+  #define HashGroup_claim           cfish_HashGroup_claim
+  #define HashGroup_find            cfish_HashGroup_find
+  #define HashGroup_rehash          cfish_HashGroup_rehash
+  #define HashProbe                 cfish_HashProbe
+  #define HashProbe_init            cfish_HashProbe_init
+  #define HashProbe_offset          cfish_HashProbe_offset
+  #define HashProbe_next            cfish_HashProbe_next
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* H_CLOWNFISH_UTIL_HASHGROUP */
+
@@ -0,0 +1,212 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#define C_CFISH_HASHUTILS
+#define CFISH_USE_SHORT_NAMES
+
+#include "charmony.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "Clownfish/Util/HashUtils.h"
+#include "Clownfish/Util/Atomic.h"
+
+/* The hash function follows the design of wyhash by Wang Yi (public
+ * domain): inputs are consumed in 64-bit words which are folded into the
+ * state with a 64x64->128 bit multiply.
+ */
+
+#define HASHUTIL_P0 UINT64_C(0xa0761d6478bd642f)
+#define HASHUTIL_P1 UINT64_C(0xe7037ed1a0b428db)
+#define HASHUTIL_P2 UINT64_C(0x8ebc6af09c88c6e3)
+#define HASHUTIL_P3 UINT64_C(0x589965cc75374cc3)
+
+// Arbitrary default seed, used unless CLOWNFISH_HASH_SEED is set.
+#define HASHUTIL_DEFAULT_SEED UINT64_C(0x2d358dccaa6c78a5)
+
+// The seed is computed once.  The first thread to claim `seed_guard` stores
+// it, then marks it ready with a release store; other threads wait for that.
+#define SEED_UNSET  NULL
+#define SEED_BUSY   ((void*)&seed_guard)
+#define SEED_READY  ((void*)&hash_seed)
+
+static uint64_t hash_seed = 0;
+static void *volatile seed_guard = SEED_UNSET;
+
+static uint64_t
+S_init_seed(void);
+
+static CFISH_INLINE void
+SI_mum(uint64_t *a, uint64_t *b) {
+#if defined(__SIZEOF_INT128__)
+    __uint128_t product = (__uint128_t)*a * *b;
+    *a = (uint64_t)product;
+    *b = (uint64_t)(product >> 64);
+#else
+    uint64_t a_hi = *a >> 32, a_lo = (uint32_t)*a;
+    uint64_t b_hi = *b >> 32, b_lo = (uint32_t)*b;
+    uint64_t hh = a_hi * b_hi, hl = a_hi * b_lo;
+    uint64_t lh = a_lo * b_hi, ll = a_lo * b_lo;
+    uint64_t t  = ll + (hl << 32);
+    uint64_t lo = t + (lh << 32);
+    uint64_t hi = hh + (hl >> 32) + (lh >> 32)
+                  + (t < ll) + (lo < t);
+    *a = lo;
+    *b = hi;
+#endif
+}
+
+static CFISH_INLINE uint64_t
+SI_mix(uint64_t a, uint64_t b) {
+    SI_mum(&a, &b);
+    return a ^ b;
+}
+
+static CFISH_INLINE uint64_t
+SI_read64(const uint8_t *p) {
+    uint64_t value;
+    memcpy(&value, p, sizeof(uint64_t));
+    return value;
+}
+
+static CFISH_INLINE uint64_t
+SI_read32(const uint8_t *p) {
+    uint32_t value;
+    memcpy(&value, p, sizeof(uint32_t));
+    return value;
+}
+
+// Read 1 to 3 bytes.
+static CFISH_INLINE uint64_t
+SI_read_small(const uint8_t *p, size_t size) {
+    return ((uint64_t)p[0] << 16)
+           | ((uint64_t)p[size >> 1] << 8)
+           | p[size - 1];
+}
+
+uint64_t
+HashUtil_hash_bytes(const void *ptr, size_t size) {
+    const uint8_t *p = (const uint8_t*)ptr;
+    uint64_t seed = HashUtil_get_seed();
+    uint64_t a, b;
+
+    seed ^= SI_mix(seed ^ HASHUTIL_P0, HASHUTIL_P1);
+
+    if (size <= 16) {
+        if (size >= 4) {
+            size_t shift = (size >> 3) << 2;
+            a = (SI_read32(p) << 32) | SI_read32(p + shift);
+            b = (SI_read32(p + size - 4) << 32)
+                | SI_read32(p + size - 4 - shift);
+        }
+        else if (size > 0) {
+            a = SI_read_small(p, size);
+            b = 0;
+        }
+        else {
+            a = b = 0;
+        }
+    }
+    else {
+        size_t remaining = size;
+        if (remaining > 48) {
+            // Three independent lanes, which the CPU can run in parallel.
+            uint64_t seed1 = seed;
+            uint64_t seed2 = seed;
+            do {
+                seed  = SI_mix(SI_read64(p) ^ HASHUTIL_P1,
+                               SI_read64(p + 8) ^ seed);
+                seed1 = SI_mix(SI_read64(p + 16) ^ HASHUTIL_P2,
+                               SI_read64(p + 24) ^ seed1);
+                seed2 = SI_mix(SI_read64(p + 32) ^ HASHUTIL_P3,
+                               SI_read64(p + 40) ^ seed2);
+                p         += 48;
+                remaining -= 48;
+            } while (remaining > 48);
+            seed ^= seed1 ^ seed2;
+        }
+        while (remaining > 16) {
+            seed = SI_mix(SI_read64(p) ^ HASHUTIL_P1,
+                          SI_read64(p + 8) ^ seed);
+            p         += 16;
+            remaining -= 16;
+        }
+        a = SI_read64(p + remaining - 16);
+        b = SI_read64(p + remaining - 8);
+    }
+
+    a ^= HASHUTIL_P1;
+    b ^= seed;
+    SI_mum(&a, &b);
+    return SI_mix(a ^ HASHUTIL_P0 ^ size, b ^ HASHUTIL_P1);
+}
+
+int32_t
+HashUtil_hash_sum(const void *ptr, size_t size) {
+    return HashUtil_fold32(HashUtil_hash_bytes(ptr, size));
+}
+
+uint64_t
+HashUtil_get_seed() {
+    if (Atomic_load_acquire_ptr(&seed_guard) == SEED_READY) {
+        return hash_seed;
+    }
+    return S_init_seed();
+}
+
+static uint64_t
+S_compute_seed(void) {
+    const char *env  = getenv(CFISH_HASHUTIL_SEED_ENV);
+    uint64_t    seed;
+
+    if (env == NULL || env[0] == '\0') {
+        seed = HASHUTIL_DEFAULT_SEED;
+    }
+    else if (strcmp(env, "random") == 0) {
+        // Mix the time, the address of a stack variable and the address of
+        // a heap allocation.  With ASLR, the addresses differ per process.
+        void *heap_addr = malloc(1);
+        seed = SI_mix((uint64_t)time(NULL) ^ HASHUTIL_P0,
+                      (uint64_t)(size_t)&seed ^ HASHUTIL_P1);
+        seed = SI_mix(seed ^ (uint64_t)(size_t)heap_addr, HASHUTIL_P2);
+        free(heap_addr);
+    }
+    else {
+        seed = (uint64_t)strtoull(env, NULL, 0);
+    }
+    if (seed == 0) { seed = 1; }
+
+    return seed;
+}
+
+static uint64_t
+S_init_seed(void) {
+    if (Atomic_cas_ptr(&seed_guard, SEED_UNSET, SEED_BUSY)) {
+        hash_seed = S_compute_seed();
+        Atomic_store_release_ptr(&seed_guard, SEED_READY);
+    }
+    else {
+        while (Atomic_load_acquire_ptr(&seed_guard) != SEED_READY) {
+            // Spin until the seed is published.
+        }
+    }
+    return hash_seed;
+}
+
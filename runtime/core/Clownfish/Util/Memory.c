@@ -21,12 +21,63 @@
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 
 #include "Clownfish/Util/Memory.h"
+#include "Clownfish/Util/Atomic.h"
+
+/******************************* Allocator *********************************/
+
+static void*
+S_libc_malloc(void *context, size_t size) {
+    UNUSED_VAR(context);
+    return malloc(size);
+}
+
+static void*
+S_libc_calloc(void *context, size_t count, size_t size) {
+    UNUSED_VAR(context);
+    return calloc(count, size);
+}
+
+static void*
+S_libc_realloc(void *context, void *ptr, size_t size) {
+    UNUSED_VAR(context);
+    return realloc(ptr, size);
+}
+
+static void
+S_libc_free(void *context, void *ptr) {
+    UNUSED_VAR(context);
+    free(ptr);
+}
+
+static Allocator allocator = {
+    S_libc_malloc, S_libc_calloc, S_libc_realloc, S_libc_free, NULL
+};
+
+void
+Memory_set_allocator(const Allocator *new_allocator) {
+    if (new_allocator) {
+        allocator = *new_allocator;
+    }
+    else {
+        allocator.malloc_func  = S_libc_malloc;
+        allocator.calloc_func  = S_libc_calloc;
+        allocator.realloc_func = S_libc_realloc;
+        allocator.free_func    = S_libc_free;
+        allocator.context      = NULL;
+    }
+}
+
+const Allocator*
+Memory_get_allocator() {
+    return &allocator;
+}
 
 void*
 Memory_wrapped_malloc(size_t count) {
-    void *pointer = malloc(count);
+    void *pointer = allocator.malloc_func(allocator.context, count);
     if (pointer == NULL && count != 0) {
         fprintf(stderr, "Can't malloc %" PRIu64 " bytes.\n", (uint64_t)count);
         exit(1);
@@ -36,7 +87,7 @@ Memory_wrapped_malloc(size_t count) {
 
 void*
 Memory_wrapped_calloc(size_t count, size_t size) {
-    void *pointer = calloc(count, size);
+    void *pointer = allocator.calloc_func(allocator.context, count, size);
     if (pointer == NULL && count != 0) {
         fprintf(stderr, "Can't calloc %" PRIu64 " elements of size %" PRIu64 ".\n",
                 (uint64_t)count, (uint64_t)size);
@@ -47,7 +98,7 @@ Memory_wrapped_calloc(size_t count, size_t size) {
 
 void*
 Memory_wrapped_realloc(void *ptr, size_t size) {
-    void *pointer = realloc(ptr, size);
+    void *pointer = allocator.realloc_func(allocator.context, ptr, size);
     if (pointer == NULL && size != 0) {
         fprintf(stderr, "Can't realloc %" PRIu64 " bytes.\n", (uint64_t)size);
         exit(1);
@@ -57,7 +108,107 @@ Memory_wrapped_realloc(void *ptr, size_t size) {
 
 void
 Memory_wrapped_free(void *ptr) {
-    free(ptr);
+    allocator.free_func(allocator.context, ptr);
+}
+
+/******************************* Accounting ********************************/
+
+// Counters are shared by all threads and only updated while accounting is
+// enabled, either with Memory_enable_stats or through the environment.
+static MemoryStats memory_stats[MEMORY_NUM_TAGS];
+
+// -1 until the environment has been checked.
+static volatile int memory_stats_enabled = -1;
+
+static const char *const memory_tag_names[MEMORY_NUM_TAGS] = {
+    "Object", "String", "Hash", "VArray", "Class", "Err", "Arena"
+};
+
+static bool
+S_init_stats_enabled(void) {
+    const char *env = getenv(CFISH_MEMORY_STATS_ENV);
+    memory_stats_enabled = env != NULL && env[0] != '\0' && env[0] != '0';
+    return memory_stats_enabled;
+}
+
+static CFISH_INLINE bool
+SI_stats_enabled(void) {
+    int enabled = memory_stats_enabled;
+    return enabled < 0 ? S_init_stats_enabled() : (bool)enabled;
+}
+
+static CFISH_INLINE void
+SI_count_alloc(int32_t tag, size_t size) {
+    if (SI_stats_enabled()) {
+        MemoryStats *stats = &memory_stats[tag];
+        Atomic_fetch_add_size(&stats->num_allocs, 1);
+        Atomic_fetch_add_size(&stats->bytes_allocated, size);
+    }
+}
+
+static CFISH_INLINE void
+SI_count_free(int32_t tag, size_t size) {
+    if (SI_stats_enabled()) {
+        MemoryStats *stats = &memory_stats[tag];
+        Atomic_fetch_add_size(&stats->num_frees, 1);
+        Atomic_fetch_add_size(&stats->bytes_freed, size);
+    }
+}
+
+void
+Memory_enable_stats(bool enable) {
+    memory_stats_enabled = enable;
+}
+
+bool
+Memory_stats_enabled() {
+    return SI_stats_enabled();
+}
+
+void
+Memory_get_stats(int32_t tag, MemoryStats *stats) {
+    if (tag < 0 || tag >= MEMORY_NUM_TAGS) {
+        memset(stats, 0, sizeof(MemoryStats));
+        return;
+    }
+    MemoryStats *src = &memory_stats[tag];
+    stats->num_allocs      = Atomic_load_acquire_size(&src->num_allocs);
+    stats->num_frees       = Atomic_load_acquire_size(&src->num_frees);
+    stats->bytes_allocated = Atomic_load_acquire_size(&src->bytes_allocated);
+    stats->bytes_freed     = Atomic_load_acquire_size(&src->bytes_freed);
+}
+
+const char*
+Memory_tag_name(int32_t tag) {
+    if (tag < 0 || tag >= MEMORY_NUM_TAGS) { return NULL; }
+    return memory_tag_names[tag];
+}
+
+void*
+Memory_tagged_malloc(int32_t tag, size_t size) {
+    SI_count_alloc(tag, size);
+    return Memory_wrapped_malloc(size);
+}
+
+void*
+Memory_tagged_calloc(int32_t tag, size_t count, size_t size) {
+    SI_count_alloc(tag, count * size);
+    return Memory_wrapped_calloc(count, size);
+}
+
+void*
+Memory_tagged_realloc(int32_t tag, void *ptr, size_t old_size, size_t size) {
+    if (ptr) { SI_count_free(tag, old_size); }
+    SI_count_alloc(tag, size);
+    return Memory_wrapped_realloc(ptr, size);
+}
+
+void
+Memory_tagged_free(int32_t tag, void *ptr, size_t size) {
+    if (ptr) {
+        SI_count_free(tag, size);
+        Memory_wrapped_free(ptr);
+    }
 }
 
 size_t
@@ -109,3 +260,814 @@ Memory_oversize(size_t minimum, size_t width) {
 }
 
 
+
+/************************* Object slab allocator ***************************/
+
+/* Objects of up to SLAB_MAX_SIZE bytes are carved out of slabs, rounded up
+ * to a multiple of SLAB_GRANULARITY.  Every thread keeps a free list per
+ * size class, so allocating and freeing usually touch no shared state.
+ *
+ * Blocks may be freed by a different thread than the one which allocated
+ * them.  A free list which grows beyond CACHE_MAX_BLOCKS, and the free lists
+ * of exiting threads, are handed to a shared depot, which threads draw from
+ * before carving a new slab.  Slabs are never returned to the system.
+ */
+
+#define SLAB_GRANULARITY  16
+#define SLAB_MAX_SIZE     256
+#define NUM_SIZE_CLASSES  (SLAB_MAX_SIZE / SLAB_GRANULARITY)
+#define SLAB_SIZE         16384
+#define CACHE_MAX_BLOCKS  1024
+
+/* Arenas hand out memory from chunks which grow from ARENA_MIN_CHUNK to
+ * ARENA_MAX_CHUNK bytes.  Buffers carry a header with their size, so that
+ * they can be reallocated.  Objects never are, so they go without.
+ */
+
+#define ARENA_ALIGN       16
+#define ARENA_MIN_CHUNK   8192
+#define ARENA_MAX_CHUNK   (1024 * 1024)
+
+typedef struct ObjFreeBlock {
+    struct ObjFreeBlock *next;
+} ObjFreeBlock;
+
+typedef struct ArenaChunk {
+    struct ArenaChunk *next;  // The previous, now full chunk.
+    char              *top;   // Start of the unused space.
+    char              *limit; // End of the chunk.
+} ArenaChunk;
+
+typedef struct MemoryScope {
+    struct MemoryScope *outer;
+    ArenaChunk         *chunks;  // NULL for heap scopes.
+    size_t              next_chunk_size;
+    bool                is_arena;
+} MemoryScope;
+
+/* Census counters are kept per thread in pages of CENSUS_PAGE_SIZE slots,
+ * so that counting touches no shared state.  Counts of objects destroyed
+ * by another thread than the one which made them wrap around, which sums
+ * up correctly.
+ */
+
+#define CENSUS_PAGE_SIZE  256
+#define CENSUS_MAX_PAGES  256
+
+typedef struct CensusPage {
+    size_t counts[CENSUS_PAGE_SIZE];
+    size_t bytes[CENSUS_PAGE_SIZE];
+} CensusPage;
+
+// State kept per thread: the slab free lists, the stack of scopes, the
+// census counters and the announced epoch.
+typedef struct ThreadCache {
+    ObjFreeBlock *free_lists[NUM_SIZE_CLASSES];
+    size_t        num_free[NUM_SIZE_CLASSES];
+    MemoryScope  *scope;
+    size_t        num_arenas;
+    CensusPage  *volatile *census; // CENSUS_MAX_PAGES pages, or NULL.
+    struct ThreadCache    *census_next;
+    volatile size_t        epoch;  // Epoch the thread entered in, or 0.
+    size_t                 epoch_depth;
+    bool                   epoch_listed;
+    struct ThreadCache    *epoch_next;
+} ThreadCache;
+
+static void
+S_release_census(ThreadCache *cache);
+
+static void
+S_release_epoch(ThreadCache *cache);
+
+static ThreadCache*
+S_get_thread_cache(void);
+
+static void
+S_pop_scope(ThreadCache *cache);
+
+// Where the compiler supports thread-local variables, they cache the
+// pointer to the thread's ThreadCache in front of the slower TLS API, which
+// is still needed to release the cache when the thread exits.
+#if defined(CFISH_NOTHREADS)
+  // The only cache is a global.
+#elif defined(CHY_HAS___THREAD)
+  #define THREAD_CACHE_FAST_TLS __thread
+#elif defined(CHY_HAS___DECLSPEC_THREAD)
+  #define THREAD_CACHE_FAST_TLS __declspec(thread)
+#endif
+
+#ifdef THREAD_CACHE_FAST_TLS
+static THREAD_CACHE_FAST_TLS ThreadCache *thread_cache_fast;
+#endif
+
+static CFISH_INLINE ThreadCache*
+SI_get_thread_cache(void) {
+#ifdef THREAD_CACHE_FAST_TLS
+    ThreadCache *cache = thread_cache_fast;
+    if (cache == NULL) {
+        cache = thread_cache_fast = S_get_thread_cache();
+    }
+    return cache;
+#else
+    return S_get_thread_cache();
+#endif
+}
+
+#ifndef CFISH_NO_OBJ_SLABS
+
+// Lists of free blocks shared by all threads.  Whole lists are pushed and
+// taken, which keeps the lock-free stacks safe from ABA.
+static ObjFreeBlock *volatile obj_depot[NUM_SIZE_CLASSES];
+
+// All slabs, linked through their first block, so that they stay reachable.
+static ObjFreeBlock *volatile obj_slabs;
+
+static void
+S_depot_push(size_t size_class, ObjFreeBlock *head, ObjFreeBlock *tail) {
+    while (1) {
+        ObjFreeBlock *old_head = (ObjFreeBlock*)Atomic_load_acquire_ptr(
+                                     (void*volatile*)&obj_depot[size_class]);
+        tail->next = old_head;
+        if (Atomic_cas_ptr((void*volatile*)&obj_depot[size_class], old_head,
+                           head)) {
+            return;
+        }
+    }
+}
+
+static ObjFreeBlock*
+S_depot_take(size_t size_class) {
+    while (1) {
+        ObjFreeBlock *head = (ObjFreeBlock*)Atomic_load_acquire_ptr(
+                                 (void*volatile*)&obj_depot[size_class]);
+        if (head == NULL) { return NULL; }
+        if (Atomic_cas_ptr((void*volatile*)&obj_depot[size_class], head,
+                           NULL)) {
+            return head;
+        }
+    }
+}
+
+// Move a thread's free list for a size class to the depot.
+static void
+S_flush_free_list(ThreadCache *cache, size_t size_class) {
+    ObjFreeBlock *head = cache->free_lists[size_class];
+    if (head == NULL) { return; }
+    ObjFreeBlock *tail = head;
+    while (tail->next) { tail = tail->next; }
+    S_depot_push(size_class, head, tail);
+    cache->free_lists[size_class] = NULL;
+    cache->num_free[size_class]   = 0;
+}
+
+// Return a list of free blocks for a size class, either from the depot or
+// from a fresh slab.  The first block of a slab links it into `obj_slabs`.
+static ObjFreeBlock*
+S_refill(size_t size_class) {
+    ObjFreeBlock *list = S_depot_take(size_class);
+    if (list) { return list; }
+
+    size_t  block_size = (size_class + 1) * SLAB_GRANULARITY;
+    char   *slab       = (char*)Memory_wrapped_malloc(SLAB_SIZE);
+    ObjFreeBlock *slab_link = (ObjFreeBlock*)slab;
+    do {
+        slab_link->next = (ObjFreeBlock*)Atomic_load_acquire_ptr(
+                              (void*volatile*)&obj_slabs);
+    } while (!Atomic_cas_ptr((void*volatile*)&obj_slabs, slab_link->next,
+                             slab_link));
+
+    size_t  num_blocks = (SLAB_SIZE - SLAB_GRANULARITY) / block_size;
+    char   *block      = slab + SLAB_GRANULARITY;
+    list = (ObjFreeBlock*)block;
+    for (size_t i = 1; i < num_blocks; i++) {
+        ((ObjFreeBlock*)block)->next = (ObjFreeBlock*)(block + block_size);
+        block += block_size;
+    }
+    ((ObjFreeBlock*)block)->next = NULL;
+    return list;
+}
+
+#endif /* CFISH_NO_OBJ_SLABS */
+
+#ifndef CFISH_NOTHREADS
+
+// Called on the exiting thread.  Any object freed later on the thread
+// gets a fresh cache, which is released in turn.
+static void
+S_release_thread_cache(ThreadCache *cache) {
+#ifdef THREAD_CACHE_FAST_TLS
+    thread_cache_fast = NULL;
+#endif
+    while (cache->scope) {
+        S_pop_scope(cache);
+    }
+    if (cache->census) {
+        S_release_census(cache);
+    }
+    if (cache->epoch_listed) {
+        S_release_epoch(cache);
+    }
+#ifndef CFISH_NO_OBJ_SLABS
+    for (size_t i = 0; i < NUM_SIZE_CLASSES; i++) {
+        S_flush_free_list(cache, i);
+    }
+#endif
+    Memory_wrapped_free(cache);
+}
+
+#endif /* CFISH_NOTHREADS */
+
+/**************************** No thread support ****************************/
+#ifdef CFISH_NOTHREADS
+
+static ThreadCache thread_cache;
+
+static ThreadCache*
+S_get_thread_cache(void) {
+    return &thread_cache;
+}
+
+/********************************** Windows ********************************/
+#elif defined(CHY_HAS_WINDOWS_H)
+
+#include <windows.h>
+
+static DWORD     thread_cache_fls_index;
+static INIT_ONCE thread_cache_init_once = INIT_ONCE_STATIC_INIT;
+
+static void WINAPI
+S_destroy_thread_cache(void *cache) {
+    if (cache) { S_release_thread_cache((ThreadCache*)cache); }
+}
+
+static BOOL CALLBACK
+S_init_thread_cache_index(INIT_ONCE *init_once, void *param,
+                          void **context) {
+    UNUSED_VAR(init_once);
+    UNUSED_VAR(param);
+    UNUSED_VAR(context);
+    thread_cache_fls_index = FlsAlloc(S_destroy_thread_cache);
+    if (thread_cache_fls_index == FLS_OUT_OF_INDEXES) {
+        fprintf(stderr, "FlsAlloc failed (FLS_OUT_OF_INDEXES)\n");
+        abort();
+    }
+    return TRUE;
+}
+
+static ThreadCache*
+S_get_thread_cache(void) {
+    InitOnceExecuteOnce(&thread_cache_init_once, S_init_thread_cache_index,
+                        NULL, NULL);
+    ThreadCache *cache = (ThreadCache*)FlsGetValue(thread_cache_fls_index);
+
+    if (!cache) {
+        cache = (ThreadCache*)Memory_wrapped_calloc(1, sizeof(ThreadCache));
+        if (!FlsSetValue(thread_cache_fls_index, cache)) {
+            fprintf(stderr, "FlsSetValue failed: %d\n", GetLastError());
+            abort();
+        }
+    }
+
+    return cache;
+}
+
+/******************************** pthreads *********************************/
+#elif defined(CHY_HAS_PTHREAD_H)
+
+#include <pthread.h>
+
+static pthread_key_t  thread_cache_key;
+static pthread_once_t thread_cache_once = PTHREAD_ONCE_INIT;
+
+static void
+S_destroy_thread_cache(void *cache) {
+    S_release_thread_cache((ThreadCache*)cache);
+}
+
+static void
+S_init_thread_cache_key(void) {
+    int error = pthread_key_create(&thread_cache_key, S_destroy_thread_cache);
+    if (error) {
+        fprintf(stderr, "pthread_key_create failed: %d\n", error);
+        abort();
+    }
+}
+
+static ThreadCache*
+S_get_thread_cache(void) {
+    pthread_once(&thread_cache_once, S_init_thread_cache_key);
+    ThreadCache *cache = (ThreadCache*)pthread_getspecific(thread_cache_key);
+
+    if (!cache) {
+        cache = (ThreadCache*)Memory_wrapped_calloc(1, sizeof(ThreadCache));
+        int error = pthread_setspecific(thread_cache_key, cache);
+        if (error) {
+            fprintf(stderr, "pthread_setspecific failed: %d\n", error);
+            abort();
+        }
+    }
+
+    return cache;
+}
+
+/****************** No support for thread-local storage ********************/
+#else
+
+#error "No support for thread-local storage."
+
+#endif
+
+/********************************* Arenas **********************************/
+
+// Number of arenas open on any thread.  Most programs never open one, so
+// checking this first spares them the thread cache lookup.
+static volatile size_t num_active_arenas;
+
+static void
+S_push_scope(ThreadCache *cache, bool is_arena) {
+    MemoryScope *scope
+        = (MemoryScope*)Memory_wrapped_malloc(sizeof(MemoryScope));
+    scope->outer           = cache->scope;
+    scope->chunks          = NULL;
+    scope->next_chunk_size = ARENA_MIN_CHUNK;
+    scope->is_arena        = is_arena;
+    cache->scope = scope;
+    if (is_arena) {
+        cache->num_arenas++;
+        Atomic_fetch_add_size(&num_active_arenas, 1);
+    }
+}
+
+static void
+S_pop_scope(ThreadCache *cache) {
+    MemoryScope *scope = cache->scope;
+    ArenaChunk  *chunk = scope->chunks;
+    while (chunk) {
+        ArenaChunk *next = chunk->next;
+        Memory_tagged_free(MEMORY_ARENA, chunk,
+                           (size_t)(chunk->limit - (char*)chunk));
+        chunk = next;
+    }
+    if (scope->is_arena) {
+        cache->num_arenas--;
+        Atomic_fetch_add_size(&num_active_arenas, (size_t)-1);
+    }
+    cache->scope = scope->outer;
+    Memory_wrapped_free(scope);
+}
+
+// Return the arena which holds `ptr`, or NULL if it's heap memory.
+static MemoryScope*
+S_find_arena(ThreadCache *cache, const void *ptr) {
+    if (cache->num_arenas == 0 || ptr == NULL) { return NULL; }
+    for (MemoryScope *scope = cache->scope; scope; scope = scope->outer) {
+        for (ArenaChunk *chunk = scope->chunks; chunk; chunk = chunk->next) {
+            if ((const char*)ptr >= (char*)chunk
+                && (const char*)ptr < chunk->limit
+               ) {
+                return scope;
+            }
+        }
+    }
+    return NULL;
+}
+
+// Like S_find_arena for the calling thread.  A thread always sees its own
+// arenas counted, so a zero count means that `ptr` is heap memory.
+static CFISH_INLINE MemoryScope*
+SI_find_arena(const void *ptr) {
+    if (Atomic_load_acquire_size(&num_active_arenas) == 0) { return NULL; }
+    return S_find_arena(SI_get_thread_cache(), ptr);
+}
+
+static CFISH_INLINE size_t
+SI_arena_round(size_t size) {
+    return (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+}
+
+// The chunk header is padded, so that allocations stay aligned.
+#define ARENA_CHUNK_HEADER SI_arena_round(sizeof(ArenaChunk))
+
+// Bump-allocate `size` bytes of zeroed memory.
+static void*
+S_arena_alloc(MemoryScope *arena, size_t size) {
+    size_t      amount = SI_arena_round(size);
+    ArenaChunk *chunk  = arena->chunks;
+
+    if (chunk == NULL || (size_t)(chunk->limit - chunk->top) < amount) {
+        size_t chunk_size = arena->next_chunk_size;
+        if (chunk_size < amount + ARENA_CHUNK_HEADER) {
+            chunk_size = amount + ARENA_CHUNK_HEADER;
+        }
+        if (arena->next_chunk_size < ARENA_MAX_CHUNK) {
+            arena->next_chunk_size *= 2;
+        }
+        chunk = (ArenaChunk*)Memory_tagged_malloc(MEMORY_ARENA, chunk_size);
+        chunk->next  = arena->chunks;
+        chunk->top   = (char*)chunk + ARENA_CHUNK_HEADER;
+        chunk->limit = (char*)chunk + chunk_size;
+        arena->chunks = chunk;
+    }
+
+    void *result = chunk->top;
+    chunk->top += amount;
+    memset(result, 0, amount);
+    return result;
+}
+
+// Buffers are preceded by their size, padded to ARENA_ALIGN.
+static void*
+S_arena_alloc_buf(MemoryScope *arena, size_t size) {
+    char *block = (char*)S_arena_alloc(arena, size + ARENA_ALIGN);
+    *(size_t*)block = size;
+    return block + ARENA_ALIGN;
+}
+
+static CFISH_INLINE size_t
+SI_arena_buf_size(const void *ptr) {
+    return *(const size_t*)((const char*)ptr - ARENA_ALIGN);
+}
+
+static void*
+S_arena_realloc_buf(MemoryScope *arena, void *ptr, size_t size) {
+    if (ptr == NULL) { return S_arena_alloc_buf(arena, size); }
+
+    size_t      old_size = SI_arena_buf_size(ptr);
+    size_t      old_end  = SI_arena_round(old_size);
+    size_t      new_end  = SI_arena_round(size);
+    ArenaChunk *chunk    = arena->chunks;
+
+    // Grow or shrink the most recent allocation in place.
+    if ((char*)ptr + old_end == chunk->top
+        && (new_end <= old_end
+            || (size_t)(chunk->limit - chunk->top) >= new_end - old_end)
+       ) {
+        if (new_end > old_end) {
+            memset(chunk->top, 0, new_end - old_end);
+        }
+        chunk->top = (char*)ptr + new_end;
+        *(size_t*)((char*)ptr - ARENA_ALIGN) = size;
+        return ptr;
+    }
+
+    void *result = S_arena_alloc_buf(arena, size);
+    memcpy(result, ptr, old_size < size ? old_size : size);
+    return result;
+}
+
+void
+Memory_push_arena() {
+    S_push_scope(SI_get_thread_cache(), true);
+}
+
+void
+Memory_push_heap() {
+    S_push_scope(SI_get_thread_cache(), false);
+}
+
+void
+Memory_pop_scope() {
+    ThreadCache *cache = SI_get_thread_cache();
+    if (cache->scope == NULL) {
+        fprintf(stderr, "Memory_pop_scope called without a scope\n");
+        abort();
+    }
+    S_pop_scope(cache);
+}
+
+bool
+Memory_in_arena() {
+    MemoryScope *scope = SI_get_thread_cache()->scope;
+    return scope != NULL && scope->is_arena;
+}
+
+void*
+Memory_owned_malloc(void *owner, int32_t tag, size_t size) {
+    MemoryScope *arena = SI_find_arena(owner);
+    if (arena) { return S_arena_alloc_buf(arena, size); }
+    return Memory_tagged_malloc(tag, size);
+}
+
+void*
+Memory_owned_calloc(void *owner, int32_t tag, size_t count, size_t size) {
+    MemoryScope *arena = SI_find_arena(owner);
+    if (arena) { return S_arena_alloc_buf(arena, count * size); }
+    return Memory_tagged_calloc(tag, count, size);
+}
+
+void*
+Memory_owned_realloc(void *owner, int32_t tag, void *ptr, size_t old_size,
+                     size_t size) {
+    MemoryScope *arena = SI_find_arena(owner);
+    if (arena) { return S_arena_realloc_buf(arena, ptr, size); }
+    return Memory_tagged_realloc(tag, ptr, old_size, size);
+}
+
+void
+Memory_owned_free(void *owner, int32_t tag, void *ptr, size_t size) {
+    if (SI_find_arena(owner) == NULL) {
+        Memory_tagged_free(tag, ptr, size);
+    }
+}
+
+void*
+Memory_owned_adopt(void *owner, int32_t tag, void *ptr, size_t size,
+                   size_t capacity) {
+    MemoryScope *owner_arena = SI_find_arena(owner);
+    MemoryScope *ptr_arena   = SI_find_arena(ptr);
+
+    if (owner_arena == ptr_arena) {
+        if (owner_arena == NULL) { SI_count_alloc(tag, capacity); }
+        return ptr;
+    }
+
+    char *copy = owner_arena
+                 ? (char*)S_arena_alloc_buf(owner_arena, capacity)
+                 : (char*)Memory_tagged_malloc(tag, capacity);
+    memcpy(copy, ptr, size);
+    memset(copy + size, 0, capacity - size);
+    if (ptr_arena == NULL) { Memory_wrapped_free(ptr); }
+    return copy;
+}
+
+void
+Memory_owned_disown(void *owner, int32_t tag, void *ptr, size_t size) {
+    if (ptr && SI_find_arena(owner) == NULL) {
+        SI_count_free(tag, size);
+    }
+}
+
+/******************************** Objects **********************************/
+
+void*
+Memory_obj_alloc(size_t size) {
+    ThreadCache *cache = SI_get_thread_cache();
+    MemoryScope *scope = cache->scope;
+    if (scope && scope->is_arena) {
+        return S_arena_alloc(scope, size);
+    }
+    SI_count_alloc(MEMORY_OBJECT, size);
+#ifndef CFISH_NO_OBJ_SLABS
+    if (size != 0 && size <= SLAB_MAX_SIZE) {
+        size_t        size_class = (size - 1) / SLAB_GRANULARITY;
+        ObjFreeBlock *block      = cache->free_lists[size_class];
+        if (block == NULL) {
+            block = S_refill(size_class);
+        }
+        // Lists taken from the depot aren't counted, so the count is only
+        // a lower bound.
+        if (cache->num_free[size_class]) {
+            cache->num_free[size_class]--;
+        }
+        cache->free_lists[size_class] = block->next;
+        memset(block, 0, (size_class + 1) * SLAB_GRANULARITY);
+        return block;
+    }
+#endif
+    return Memory_wrapped_calloc(size, 1);
+}
+
+void
+Memory_obj_free(void *ptr, size_t size) {
+    if (SI_find_arena(ptr)) {
+        // Released along with the arena.
+        return;
+    }
+    SI_count_free(MEMORY_OBJECT, size);
+#ifndef CFISH_NO_OBJ_SLABS
+    if (size != 0 && size <= SLAB_MAX_SIZE) {
+        ThreadCache  *cache      = SI_get_thread_cache();
+        size_t        size_class = (size - 1) / SLAB_GRANULARITY;
+        ObjFreeBlock *block      = (ObjFreeBlock*)ptr;
+        block->next = cache->free_lists[size_class];
+        cache->free_lists[size_class] = block;
+        if (++cache->num_free[size_class] > CACHE_MAX_BLOCKS) {
+            S_flush_free_list(cache, size_class);
+        }
+        return;
+    }
+#endif
+    Memory_wrapped_free(ptr);
+}
+
+/********************************* Census **********************************/
+
+// Threads which keep census counters, and the counters of exited threads.
+// Both are guarded by `census_lock`.
+static ThreadCache *census_threads;
+static CensusPage  *census_retired[CENSUS_MAX_PAGES];
+static void *volatile census_lock;
+
+// The lock is only taken to attach or release a thread's counters and to
+// read them, so spinning is fine.
+static void
+S_census_lock(void) {
+    while (!Atomic_cas_ptr(&census_lock, NULL, (void*)&census_lock)) {
+        // Spin.
+    }
+}
+
+static void
+S_census_unlock(void) {
+    Atomic_store_release_ptr(&census_lock, NULL);
+}
+
+static void
+S_release_census(ThreadCache *cache) {
+    S_census_lock();
+    for (size_t i = 0; i < CENSUS_MAX_PAGES; i++) {
+        CensusPage *page = cache->census[i];
+        if (page == NULL) { continue; }
+        CensusPage *retired = census_retired[i];
+        if (retired == NULL) {
+            retired = (CensusPage*)Memory_wrapped_calloc(1,
+                                                         sizeof(CensusPage));
+            census_retired[i] = retired;
+        }
+        for (size_t j = 0; j < CENSUS_PAGE_SIZE; j++) {
+            retired->counts[j] += page->counts[j];
+            retired->bytes[j]  += page->bytes[j];
+        }
+        Memory_wrapped_free(page);
+    }
+    for (ThreadCache **link = &census_threads; *link;
+         link = &(*link)->census_next
+        ) {
+        if (*link == cache) {
+            *link = cache->census_next;
+            break;
+        }
+    }
+    S_census_unlock();
+
+    Memory_wrapped_free((void*)cache->census);
+    cache->census = NULL;
+}
+
+// Return the page of the thread's counters which holds `slot`.
+static CensusPage*
+S_census_page(ThreadCache *cache, uint32_t slot) {
+    size_t page_num = slot / CENSUS_PAGE_SIZE;
+
+    if (cache->census == NULL) {
+        CensusPage *volatile *pages
+            = (CensusPage*volatile*)Memory_wrapped_calloc(
+                  CENSUS_MAX_PAGES, sizeof(CensusPage*));
+        S_census_lock();
+        cache->census      = pages;
+        cache->census_next = census_threads;
+        census_threads     = cache;
+        S_census_unlock();
+    }
+
+    CensusPage *page = cache->census[page_num];
+    if (page == NULL) {
+        page = (CensusPage*)Memory_wrapped_calloc(1, sizeof(CensusPage));
+        Atomic_store_release_ptr((void*volatile*)&cache->census[page_num],
+                                 page);
+    }
+    return page;
+}
+
+static CFISH_INLINE void
+SI_census_update(void *obj, uint32_t slot, size_t count, size_t size) {
+    if (slot >= CENSUS_PAGE_SIZE * CENSUS_MAX_PAGES
+        || SI_find_arena(obj) != NULL
+       ) {
+        return;
+    }
+    CensusPage *page = S_census_page(SI_get_thread_cache(), slot);
+    page->counts[slot % CENSUS_PAGE_SIZE] += count;
+    page->bytes[slot % CENSUS_PAGE_SIZE]  += size;
+}
+
+void
+Memory_census_add(void *obj, uint32_t slot, size_t size) {
+    SI_census_update(obj, slot, 1, size);
+}
+
+void
+Memory_census_remove(void *obj, uint32_t slot, size_t size) {
+    SI_census_update(obj, slot, (size_t)-1, (size_t)0 - size);
+}
+
+void
+Memory_census_read(uint32_t slot, int64_t *count, int64_t *bytes) {
+    size_t total_count = 0;
+    size_t total_bytes = 0;
+
+    if (slot < CENSUS_PAGE_SIZE * CENSUS_MAX_PAGES) {
+        size_t page_num = slot / CENSUS_PAGE_SIZE;
+        size_t tick     = slot % CENSUS_PAGE_SIZE;
+
+        S_census_lock();
+        if (census_retired[page_num]) {
+            total_count += census_retired[page_num]->counts[tick];
+            total_bytes += census_retired[page_num]->bytes[tick];
+        }
+        for (ThreadCache *cache = census_threads; cache;
+             cache = cache->census_next
+            ) {
+            CensusPage *page = (CensusPage*)Atomic_load_acquire_ptr(
+                                   (void*volatile*)&cache->census[page_num]);
+            if (page) {
+                total_count += page->counts[tick];
+                total_bytes += page->bytes[tick];
+            }
+        }
+        S_census_unlock();
+    }
+
+    *count = (int64_t)total_count;
+    *bytes = (int64_t)total_bytes;
+}
+
+/********************************** Epochs *********************************/
+
+// Threads which have announced an epoch, guarded by `epoch_lock`.  Epochs
+// start at 1, so that 0 means that a thread isn't in a section.
+static ThreadCache     *epoch_threads;
+static void *volatile   epoch_lock;
+static volatile size_t  memory_epoch = 1;
+
+// The lock is only taken to attach or release a thread and by reclaiming
+// threads, never by readers.
+static void
+S_epoch_lock(void) {
+    while (!Atomic_cas_ptr(&epoch_lock, NULL, (void*)&epoch_lock)) {
+        // Spin.
+    }
+}
+
+static void
+S_epoch_unlock(void) {
+    Atomic_store_release_ptr(&epoch_lock, NULL);
+}
+
+static void
+S_release_epoch(ThreadCache *cache) {
+    S_epoch_lock();
+    for (ThreadCache **link = &epoch_threads; *link;
+         link = &(*link)->epoch_next
+        ) {
+        if (*link == cache) {
+            *link = cache->epoch_next;
+            break;
+        }
+    }
+    S_epoch_unlock();
+    cache->epoch_listed = false;
+}
+
+void
+Memory_epoch_enter() {
+    ThreadCache *cache = SI_get_thread_cache();
+    if (cache->epoch_depth++ > 0) { return; }
+
+    if (!cache->epoch_listed) {
+        S_epoch_lock();
+        cache->epoch_next = epoch_threads;
+        epoch_threads     = cache;
+        S_epoch_unlock();
+        cache->epoch_listed = true;
+    }
+
+    // The fence pairs with the one in Memory_epoch_advance: either the
+    // reclaiming thread sees the announcement, or this thread sees
+    // everything which was unlinked before the epoch advanced.
+    Atomic_store_release_size(&cache->epoch,
+                              Atomic_load_acquire_size(&memory_epoch));
+    Atomic_fence();
+}
+
+void
+Memory_epoch_exit() {
+    ThreadCache *cache = SI_get_thread_cache();
+    if (--cache->epoch_depth > 0) { return; }
+    Atomic_store_release_size(&cache->epoch, 0);
+}
+
+size_t
+Memory_epoch_advance() {
+    size_t epoch = Atomic_fetch_add_size(&memory_epoch, 1) + 1;
+    Atomic_fence();
+    return epoch;
+}
+
+bool
+Memory_epoch_quiescent(size_t epoch) {
+    bool quiescent = true;
+    S_epoch_lock();
+    for (ThreadCache *cache = epoch_threads; cache;
+         cache = cache->epoch_next
+        ) {
+        size_t announced = Atomic_load_acquire_size(&cache->epoch);
+        if (announced != 0 && announced < epoch) {
+            quiescent = false;
+            break;
+        }
+    }
+    S_epoch_unlock();
+    return quiescent;
+}
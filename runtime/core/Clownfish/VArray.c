@@ -45,7 +45,8 @@ VA_init(VArray *self, uint32_t capacity) {
     self->cap = capacity;
 
     // Derive.
-    self->elems = (Obj**)CALLOCATE(capacity, sizeof(Obj*));
+    self->elems = (Obj**)Memory_owned_calloc(self, MEMORY_VARRAY, capacity,
+                                             sizeof(Obj*));
 
     return self;
 }
@@ -58,7 +59,8 @@ VA_Destroy_IMP(VArray *self) {
         for (; elems < limit; elems++) {
             DECREF(*elems);
         }
-        FREEMEM(self->elems);
+        Memory_owned_free(self, MEMORY_VARRAY, self->elems,
+                          self->cap * sizeof(Obj*));
     }
     SUPER_DESTROY(self, VARRAY);
 }
@@ -180,7 +182,10 @@ VA_Store_IMP(VArray *self, uint32_t tick, Obj *elem) {
 void
 VA_Grow_IMP(VArray *self, uint32_t capacity) {
     if (capacity > self->cap) {
-        self->elems = (Obj**)REALLOCATE(self->elems, capacity * sizeof(Obj*));
+        self->elems = (Obj**)Memory_owned_realloc(self, MEMORY_VARRAY,
+                                                  self->elems,
+                                                  self->cap * sizeof(Obj*),
+                                                  capacity * sizeof(Obj*));
         self->cap   = capacity;
         memset(self->elems + self->size, 0,
                (capacity - self->size) * sizeof(Obj*));
@@ -286,6 +291,13 @@ VA_Gather_IMP(VArray *self, VA_Gather_Test_t test, void *data) {
     return gathered;
 }
 
+void
+VA_Each_IMP(VArray *self, VA_Visitor_t visit, void *context) {
+    for (uint32_t i = 0; i < self->size; i++) {
+        if (!visit(context, i, self->elems[i])) { break; }
+    }
+}
+
 VArray*
 VA_Slice_IMP(VArray *self, uint32_t offset, uint32_t length) {
     // Adjust ranges if necessary.
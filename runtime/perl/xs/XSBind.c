@@ -668,6 +668,26 @@ S_lazy_init_host_obj(pTHX_ cfish_Obj *self) {
     }
 }
 
+// Only the thread which drops the last reference sees an old refcount of
+// 1, so it may destroy the object without further synchronization.
+static uint32_t
+S_dec_refcount_atomic(cfish_Obj *self) {
+    size_t old_count
+        = cfish_Atomic_fetch_add_size(&self->ref.count,
+                                      (size_t)-(1 << XSBIND_REFCOUNT_SHIFT));
+    size_t old_refcount = old_count >> XSBIND_REFCOUNT_SHIFT;
+    if (old_refcount == 0) {
+        cfish_Atomic_fetch_add_size(&self->ref.count,
+                                    1 << XSBIND_REFCOUNT_SHIFT);
+        CFISH_THROW(CFISH_ERR, "Illegal refcount of 0");
+    }
+    else if (old_refcount == 1) {
+        cfish_Atomic_fence();
+        CFISH_Obj_Destroy(self);
+    }
+    return (uint32_t)(old_refcount - 1);
+}
+
 uint32_t
 cfish_get_refcount(void *vself) {
     cfish_Obj *self = (cfish_Obj*)vself;
@@ -696,8 +716,13 @@ cfish_inc_refcount(void *vself) {
         else if (SI_immortal(klass)) {
             return self;
         }
-        else if (SI_threadsafe_but_not_immortal(klass)) {
-            // TODO: use atomic operation
+        else if (SI_threadsafe_but_not_immortal(klass)
+                 && (self->ref.count & XSBIND_REFCOUNT_FLAG)
+                ) {
+            // Once there's a host object, its refcount belongs to Perl.
+            cfish_Atomic_fetch_add_size(&self->ref.count,
+                                        1 << XSBIND_REFCOUNT_SHIFT);
+            return self;
         }
     }
 
@@ -722,8 +747,10 @@ cfish_dec_refcount(void *vself) {
         if (SI_immortal(klass)) {
             return 1;
         }
-        else if (SI_threadsafe_but_not_immortal(klass)) {
-            // TODO: use atomic operation
+        else if (SI_threadsafe_but_not_immortal(klass)
+                 && (self->ref.count & XSBIND_REFCOUNT_FLAG)
+                ) {
+            return S_dec_refcount_atomic(self);
         }
     }
 
@@ -766,9 +793,10 @@ CFISH_Obj_To_Host_IMP(cfish_Obj *self) {
 cfish_Obj*
 CFISH_Class_Make_Obj_IMP(cfish_Class *self) {
     cfish_Obj *obj
-        = (cfish_Obj*)cfish_Memory_wrapped_calloc(self->obj_alloc_size, 1);
+        = (cfish_Obj*)cfish_Memory_obj_alloc(self->obj_alloc_size);
     obj->klass = self;
     obj->ref.count = (1 << XSBIND_REFCOUNT_SHIFT) | XSBIND_REFCOUNT_FLAG;
+    if (cfish_Class_census_enabled) { cfish_Class_census_add(obj); }
     return obj;
 }
 
@@ -784,11 +812,12 @@ cfish_Obj*
 CFISH_Class_Foster_Obj_IMP(cfish_Class *self, void *host_obj) {
     dTHX;
     cfish_Obj *obj
-        = (cfish_Obj*)cfish_Memory_wrapped_calloc(self->obj_alloc_size, 1);
+        = (cfish_Obj*)cfish_Memory_obj_alloc(self->obj_alloc_size);
     SV *inner_obj = SvRV((SV*)host_obj);
     obj->klass = self;
     sv_setiv(inner_obj, PTR2IV(obj));
     obj->ref.host_obj = inner_obj;
+    if (cfish_Class_census_enabled) { cfish_Class_census_add(obj); }
     return obj;
 }
 